@@ -0,0 +1,210 @@
+// Blake3.cpp — переносимая реализация BLAKE3 (режим hash, 32-байтный результат)
+#include "ChecksumAlgorithms.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t kIv[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+constexpr uint8_t kMessagePermutation[16] = {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8};
+
+constexpr uint32_t kChunkStart = 1 << 0;
+constexpr uint32_t kChunkEnd = 1 << 1;
+constexpr uint32_t kParent = 1 << 2;
+constexpr uint32_t kRoot = 1 << 3;
+
+constexpr size_t kBlockLength = 64;
+constexpr size_t kChunkLength = 1024;
+
+inline uint32_t rotateRight(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+inline void mix(uint32_t* state, int a, int b, int c, int d, uint32_t x, uint32_t y) {
+    state[a] = state[a] + state[b] + x;
+    state[d] = rotateRight(state[d] ^ state[a], 16);
+    state[c] = state[c] + state[d];
+    state[b] = rotateRight(state[b] ^ state[c], 12);
+    state[a] = state[a] + state[b] + y;
+    state[d] = rotateRight(state[d] ^ state[a], 8);
+    state[c] = state[c] + state[d];
+    state[b] = rotateRight(state[b] ^ state[c], 7);
+}
+
+void compress(const uint32_t chainingValue[8], const uint32_t blockWords[16],
+              uint64_t counter, uint32_t blockLength, uint32_t flags, uint32_t out[16]) {
+    uint32_t state[16] = {
+        chainingValue[0], chainingValue[1], chainingValue[2], chainingValue[3],
+        chainingValue[4], chainingValue[5], chainingValue[6], chainingValue[7],
+        kIv[0], kIv[1], kIv[2], kIv[3],
+        static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), blockLength, flags
+    };
+    uint32_t message[16];
+    std::memcpy(message, blockWords, sizeof(message));
+
+    for (int round = 0; round < 7; ++round) {
+        mix(state, 0, 4, 8, 12, message[0], message[1]);
+        mix(state, 1, 5, 9, 13, message[2], message[3]);
+        mix(state, 2, 6, 10, 14, message[4], message[5]);
+        mix(state, 3, 7, 11, 15, message[6], message[7]);
+        mix(state, 0, 5, 10, 15, message[8], message[9]);
+        mix(state, 1, 6, 11, 12, message[10], message[11]);
+        mix(state, 2, 7, 8, 13, message[12], message[13]);
+        mix(state, 3, 4, 9, 14, message[14], message[15]);
+
+        uint32_t permuted[16];
+        for (int i = 0; i < 16; ++i) {
+            permuted[i] = message[kMessagePermutation[i]];
+        }
+        std::memcpy(message, permuted, sizeof(message));
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        out[i] = state[i] ^ state[i + 8];
+        out[i + 8] = state[i + 8] ^ chainingValue[i];
+    }
+}
+
+void loadWords(const uint8_t block[kBlockLength], uint32_t words[16]) {
+    for (int i = 0; i < 16; ++i) {
+        words[i] = static_cast<uint32_t>(block[4 * i]) |
+                   static_cast<uint32_t>(block[4 * i + 1]) << 8 |
+                   static_cast<uint32_t>(block[4 * i + 2]) << 16 |
+                   static_cast<uint32_t>(block[4 * i + 3]) << 24;
+    }
+}
+
+// Вход последней компрессии узла: из него получают либо цепное значение, либо корневой вывод.
+struct Output {
+    uint32_t inputChainingValue[8];
+    uint32_t blockWords[16];
+    uint64_t counter;
+    uint32_t blockLength;
+    uint32_t flags;
+
+    void chainingValue(uint32_t out[8]) const {
+        uint32_t words[16];
+        compress(inputChainingValue, blockWords, counter, blockLength, flags, words);
+        std::memcpy(out, words, 8 * sizeof(uint32_t));
+    }
+
+    void rootBytes(unsigned char out[32]) const {
+        uint32_t words[16];
+        compress(inputChainingValue, blockWords, 0, blockLength, flags | kRoot, words);
+        for (int i = 0; i < 8; ++i) {
+            out[4 * i] = static_cast<unsigned char>(words[i]);
+            out[4 * i + 1] = static_cast<unsigned char>(words[i] >> 8);
+            out[4 * i + 2] = static_cast<unsigned char>(words[i] >> 16);
+            out[4 * i + 3] = static_cast<unsigned char>(words[i] >> 24);
+        }
+    }
+};
+
+Output parentOutput(const uint32_t left[8], const uint32_t right[8]) {
+    Output output;
+    std::memcpy(output.inputChainingValue, kIv, sizeof(kIv));
+    std::memcpy(output.blockWords, left, 8 * sizeof(uint32_t));
+    std::memcpy(output.blockWords + 8, right, 8 * sizeof(uint32_t));
+    output.counter = 0;
+    output.blockLength = kBlockLength;
+    output.flags = kParent;
+    return output;
+}
+
+uint32_t chunkStartFlag(const Blake3Policy::Context& context) {
+    return context.blocksCompressed == 0 ? kChunkStart : 0;
+}
+
+size_t chunkLength(const Blake3Policy::Context& context) {
+    return kBlockLength * context.blocksCompressed + context.blockLength;
+}
+
+Output chunkOutput(const Blake3Policy::Context& context) {
+    Output output;
+    std::memcpy(output.inputChainingValue, context.chunkChainingValue, sizeof(output.inputChainingValue));
+    loadWords(context.block, output.blockWords);
+    output.counter = context.chunkCounter;
+    output.blockLength = context.blockLength;
+    output.flags = chunkStartFlag(context) | kChunkEnd;
+    return output;
+}
+
+void resetChunk(Blake3Policy::Context& context, uint64_t chunkCounter) {
+    std::memcpy(context.chunkChainingValue, kIv, sizeof(kIv));
+    context.chunkCounter = chunkCounter;
+    std::memset(context.block, 0, sizeof(context.block));
+    context.blockLength = 0;
+    context.blocksCompressed = 0;
+}
+
+void updateChunk(Blake3Policy::Context& context, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        if (context.blockLength == kBlockLength) {
+            uint32_t blockWords[16];
+            uint32_t out[16];
+            loadWords(context.block, blockWords);
+            compress(context.chunkChainingValue, blockWords, context.chunkCounter,
+                     kBlockLength, chunkStartFlag(context), out);
+            std::memcpy(context.chunkChainingValue, out, sizeof(context.chunkChainingValue));
+            context.blocksCompressed++;
+            std::memset(context.block, 0, sizeof(context.block));
+            context.blockLength = 0;
+        }
+
+        size_t take = std::min(kBlockLength - context.blockLength, size);
+        std::memcpy(context.block + context.blockLength, data, take);
+        context.blockLength += static_cast<uint8_t>(take);
+        data += take;
+        size -= take;
+    }
+}
+
+// Слияние завершённых чанков: число нулевых младших битов totalChunks равно числу слияний.
+void addChunkChainingValue(Blake3Policy::Context& context, uint32_t chainingValue[8], uint64_t totalChunks) {
+    while ((totalChunks & 1) == 0) {
+        context.chainingValueStackLength--;
+        parentOutput(context.chainingValueStack[context.chainingValueStackLength], chainingValue)
+            .chainingValue(chainingValue);
+        totalChunks >>= 1;
+    }
+    std::memcpy(context.chainingValueStack[context.chainingValueStackLength], chainingValue, 8 * sizeof(uint32_t));
+    context.chainingValueStackLength++;
+}
+
+} // namespace
+
+void Blake3Policy::init(Context& context) {
+    resetChunk(context, 0);
+    context.chainingValueStackLength = 0;
+}
+
+void Blake3Policy::update(Context& context, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        if (chunkLength(context) == kChunkLength) {
+            uint32_t chainingValue[8];
+            chunkOutput(context).chainingValue(chainingValue);
+            uint64_t totalChunks = context.chunkCounter + 1;
+            addChunkChainingValue(context, chainingValue, totalChunks);
+            resetChunk(context, totalChunks);
+        }
+
+        size_t take = std::min(kChunkLength - chunkLength(context), size);
+        updateChunk(context, data, take);
+        data += take;
+        size -= take;
+    }
+}
+
+void Blake3Policy::final(Context& context, unsigned char* digest) {
+    Output output = chunkOutput(context);
+    for (size_t remaining = context.chainingValueStackLength; remaining > 0; --remaining) {
+        uint32_t chainingValue[8];
+        output.chainingValue(chainingValue);
+        output = parentOutput(context.chainingValueStack[remaining - 1], chainingValue);
+    }
+    output.rootBytes(digest);
+}
@@ -0,0 +1,129 @@
+// ChecksumAlgorithms.cpp
+#include "ChecksumAlgorithms.hpp"
+#include <cstring>
+
+ChecksumAlgorithm parseChecksumAlgorithm(const std::string& name) {
+    if (name.empty() || name == "sha256") return ChecksumAlgorithm::Sha256;
+    if (name == "blake3") return ChecksumAlgorithm::Blake3;
+    if (name == "xxh3") return ChecksumAlgorithm::Xxh3;
+    if (name == "crc32c") return ChecksumAlgorithm::Crc32c;
+    throw std::invalid_argument("Неизвестный алгоритм контрольной суммы: " + name);
+}
+
+const char* checksumAlgorithmName(ChecksumAlgorithm algorithm) {
+    switch (algorithm) {
+        case ChecksumAlgorithm::Sha256: return "sha256";
+        case ChecksumAlgorithm::Blake3: return "blake3";
+        case ChecksumAlgorithm::Xxh3:   return "xxh3";
+        case ChecksumAlgorithm::Crc32c: return "crc32c";
+    }
+    return "unknown";
+}
+
+// SHA-256 (OpenSSL)
+
+void Sha256Policy::init(Context& context) {
+    SHA256_Init(&context);
+}
+
+void Sha256Policy::update(Context& context, const unsigned char* data, size_t size) {
+    SHA256_Update(&context, data, size);
+}
+
+void Sha256Policy::final(Context& context, unsigned char* digest) {
+    SHA256_Final(digest, &context);
+}
+
+// CRC32C (полином Кастаньоли): SSE4.2 при наличии, иначе табличный вариант
+
+namespace {
+
+struct Crc32cTable {
+    uint32_t values[8][256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+            }
+            values[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int slice = 1; slice < 8; ++slice) {
+                uint32_t previous = values[slice - 1][i];
+                values[slice][i] = (previous >> 8) ^ values[0][previous & 0xFF];
+            }
+        }
+    }
+};
+
+uint32_t crc32cSoftware(uint32_t crc, const unsigned char* data, size_t size) {
+    static const Crc32cTable table;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        word ^= crc;
+        crc = table.values[7][word & 0xFF] ^
+              table.values[6][(word >> 8) & 0xFF] ^
+              table.values[5][(word >> 16) & 0xFF] ^
+              table.values[4][(word >> 24) & 0xFF] ^
+              table.values[3][(word >> 32) & 0xFF] ^
+              table.values[2][(word >> 40) & 0xFF] ^
+              table.values[1][(word >> 48) & 0xFF] ^
+              table.values[0][word >> 56];
+        data += 8;
+        size -= 8;
+    }
+    while (size--) {
+        crc = (crc >> 8) ^ table.values[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(uint32_t crc, const unsigned char* data, size_t size) {
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+    uint32_t crc32 = static_cast<uint32_t>(crc64);
+    while (size--) {
+        crc32 = __builtin_ia32_crc32qi(crc32, *data++);
+    }
+    return crc32;
+}
+#endif
+
+uint32_t crc32cUpdate(uint32_t crc, const unsigned char* data, size_t size) {
+#if defined(__x86_64__)
+    static const bool hasSse42 = __builtin_cpu_supports("sse4.2");
+    if (hasSse42) {
+        return crc32cHardware(crc, data, size);
+    }
+#endif
+    return crc32cSoftware(crc, data, size);
+}
+
+} // namespace
+
+void Crc32cPolicy::init(Context& context) {
+    context = 0xFFFFFFFFu;
+}
+
+void Crc32cPolicy::update(Context& context, const unsigned char* data, size_t size) {
+    context = crc32cUpdate(context, data, size);
+}
+
+void Crc32cPolicy::final(Context& context, unsigned char* digest) {
+    uint32_t crc = context ^ 0xFFFFFFFFu;
+    digest[0] = static_cast<unsigned char>(crc >> 24);
+    digest[1] = static_cast<unsigned char>(crc >> 16);
+    digest[2] = static_cast<unsigned char>(crc >> 8);
+    digest[3] = static_cast<unsigned char>(crc);
+}
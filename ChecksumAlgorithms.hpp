@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <openssl/sha.h>
+
+// Поддерживаемые алгоритмы контрольных сумм (значение задаётся в config.json как checksum.algorithm).
+enum class ChecksumAlgorithm : uint8_t {
+    Sha256 = 1,
+    Blake3 = 2,
+    Xxh3 = 3,
+    Crc32c = 4
+};
+
+ChecksumAlgorithm parseChecksumAlgorithm(const std::string& name);
+const char* checksumAlgorithmName(ChecksumAlgorithm algorithm);
+
+// Политики алгоритмов: каждая задаёт тип контекста и статические init/update/final,
+// поэтому цикл хеширования специализируется на этапе компиляции без виртуальных вызовов.
+// Контексты — тривиально копируемые структуры.
+
+struct Sha256Policy {
+    using Context = SHA256_CTX;
+    static constexpr ChecksumAlgorithm algorithm = ChecksumAlgorithm::Sha256;
+    static constexpr size_t digestSize = SHA256_DIGEST_LENGTH;
+
+    static void init(Context& context);
+    static void update(Context& context, const unsigned char* data, size_t size);
+    static void final(Context& context, unsigned char* digest);
+};
+
+struct Blake3Policy {
+    struct Context {
+        uint32_t chunkChainingValue[8];
+        uint64_t chunkCounter;
+        uint8_t block[64];
+        uint8_t blockLength;
+        uint8_t blocksCompressed;
+        uint32_t chainingValueStack[54][8];
+        uint8_t chainingValueStackLength;
+    };
+    static constexpr ChecksumAlgorithm algorithm = ChecksumAlgorithm::Blake3;
+    static constexpr size_t digestSize = 32;
+
+    static void init(Context& context);
+    static void update(Context& context, const unsigned char* data, size_t size);
+    static void final(Context& context, unsigned char* digest);
+};
+
+struct Xxh3Policy {
+    struct Context {
+        uint64_t accumulators[8];
+        uint8_t buffer[256];
+        uint32_t bufferedSize;
+        uint64_t stripesSoFar;
+        uint64_t totalLength;
+    };
+    static constexpr ChecksumAlgorithm algorithm = ChecksumAlgorithm::Xxh3;
+    static constexpr size_t digestSize = 8;
+
+    static void init(Context& context);
+    static void update(Context& context, const unsigned char* data, size_t size);
+    static void final(Context& context, unsigned char* digest);
+};
+
+struct Crc32cPolicy {
+    using Context = uint32_t;
+    static constexpr ChecksumAlgorithm algorithm = ChecksumAlgorithm::Crc32c;
+    static constexpr size_t digestSize = 4;
+
+    static void init(Context& context);
+    static void update(Context& context, const unsigned char* data, size_t size);
+    static void final(Context& context, unsigned char* digest);
+};
+
+// Пакетный SHA-256 для множества маленьких независимых буферов (многобуферный SIMD).
+struct HashInput {
+    const unsigned char* data;
+    size_t size;
+};
+
+enum class Sha256BatchKernel {
+    Auto,   // лучший из доступных на этом процессоре
+    Scalar, // по одному буферу через OpenSSL
+    Avx2,   // 8 буферов одновременно
+    Avx512  // 16 буферов одновременно
+};
+
+// Хеширует count буферов; digests — count * 32 байт подряд, в порядке inputs.
+// Буферы в одном пакете лучше подбирать близкого размера: пакет идёт столько блоков, сколько самый длинный.
+void sha256Batch(const HashInput* inputs, size_t count, unsigned char* digests,
+                 Sha256BatchKernel kernel = Sha256BatchKernel::Auto);
+const char* sha256BatchKernelName();
+
+// Вызывает visitor с экземпляром политики, соответствующей алгоритму.
+// Единственная точка выбора алгоритма во время выполнения — дальше код шаблонный.
+template <typename Visitor>
+decltype(auto) visitChecksumAlgorithm(ChecksumAlgorithm algorithm, Visitor&& visitor) {
+    switch (algorithm) {
+        case ChecksumAlgorithm::Sha256: return visitor(Sha256Policy{});
+        case ChecksumAlgorithm::Blake3: return visitor(Blake3Policy{});
+        case ChecksumAlgorithm::Xxh3:   return visitor(Xxh3Policy{});
+        case ChecksumAlgorithm::Crc32c: return visitor(Crc32cPolicy{});
+    }
+    throw std::invalid_argument("Неизвестный алгоритм контрольной суммы");
+}
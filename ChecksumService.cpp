@@ -1,32 +1,424 @@
 // ChecksumService.cpp
 #include "ChecksumService.hpp"
-#include <openssl/sha.h>
-#include <fstream>
-#include <sstream>
-#include <iomanip>
+#include "FileReader.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <vector>
 
-std::string ChecksumService::compute(const std::filesystem::path& filePath) {
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Не удалось открыть файл для вычисления контрольной суммы");
+namespace {
+
+// Отдельный пул для листьев дерева: задачи других пулов могут синхронно ждать его.
+ThreadPool& treePool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Пул, которому принадлежит текущий поток (задачи из него не должны ждать места в очереди)
+thread_local const ChecksumService* currentService = nullptr;
+
+// Итог xxh3 как 64-битное число
+uint64_t finalValue(Xxh3Policy::Context& context) {
+    unsigned char digest[Xxh3Policy::digestSize];
+    Xxh3Policy::final(context, digest);
+    uint64_t value = 0;
+    for (unsigned char byte : digest) {
+        value = value << 8 | byte;
+    }
+    return value;
+}
+
+// xxh3 начального и конечного окон префикса [0, length) вместе с его длиной
+uint64_t prefixAnchor(const std::filesystem::path& filePath, uint64_t length) {
+    Xxh3Policy::Context context;
+    Xxh3Policy::init(context);
+    auto update = [&](const unsigned char* data, size_t size) {
+        Xxh3Policy::update(context, data, size);
+    };
+
+    uint64_t head = std::min(length, HashMidstate::kAnchorWindow);
+    FileReader::readRange(filePath, 0, head, update);
+    uint64_t tailStart = std::max(head, length > HashMidstate::kAnchorWindow ? length - HashMidstate::kAnchorWindow : 0);
+    FileReader::readRange(filePath, tailStart, length - tailStart, update);
+
+    unsigned char lengthBytes[8];
+    for (int i = 0; i < 8; ++i) {
+        lengthBytes[i] = static_cast<unsigned char>(length >> (8 * i));
+    }
+    Xxh3Policy::update(context, lengthBytes, sizeof(lengthBytes));
+    return finalValue(context);
+}
+
+} // namespace
+
+ChecksumService::ChecksumService(size_t threadCount, size_t queueLimit, uint64_t queuedBytesLimit)
+    : queueLimit(std::max<size_t>(queueLimit, 1)), queuedBytesLimit(queuedBytesLimit) {
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ChecksumService::~ChecksumService() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    spaceAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ChecksumService::submit(ChecksumRequest request, Callback callback) {
+    enqueue(std::move(request), std::move(callback), true);
+}
+
+bool ChecksumService::trySubmit(const ChecksumRequest& request, const Callback& callback) {
+    ChecksumRequest requestCopy = request;
+    Callback callbackCopy = callback;
+    return enqueue(std::move(requestCopy), std::move(callbackCopy), false);
+}
+
+std::future<ChecksumResult> ChecksumService::submit(ChecksumRequest request) {
+    auto promise = std::make_shared<std::promise<ChecksumResult>>();
+    std::future<ChecksumResult> future = promise->get_future();
+    submit(std::move(request), [promise](ChecksumResult result) {
+        if (result.error) {
+            promise->set_exception(result.error);
+        } else {
+            promise->set_value(std::move(result));
+        }
+    });
+    return future;
+}
+
+ChecksumQueueStats ChecksumService::queueStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+bool ChecksumService::enqueue(ChecksumRequest&& request, Callback&& callback, bool wait) {
+    if (request.size == 0) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(request.path, error);
+        request.size = error ? 0 : size;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // Пустая очередь принимает задачу любого размера, иначе один большой файл не прошёл бы никогда
+    auto full = [this]() {
+        return stats.queuedTotal() > 0 &&
+               (stats.queuedTotal() >= queueLimit || stats.queuedBytes >= queuedBytesLimit);
+    };
+    if (full() && currentService != this) {
+        if (!wait) {
+            return false;
+        }
+        ++stats.waits;
+        spaceAvailable.wait(lock, [&]() { return stopping || !full(); });
+    }
+    if (stopping) {
+        throw std::runtime_error("Пул хеширования остановлен");
+    }
+
+    size_t priority = static_cast<size_t>(request.priority);
+    stats.queued[priority] += 1;
+    stats.queuedBytes += request.size;
+    stats.inFlightBytes += request.size;
+    queues[priority].push_back(Job{std::move(request), std::move(callback)});
+    lock.unlock();
+    workAvailable.notify_one();
+    return true;
+}
+
+void ChecksumService::workerLoop() {
+    currentService = this;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this]() { return stopping || stats.queuedTotal() > 0; });
+            if (stats.queuedTotal() == 0) {
+                return;
+            }
+            size_t priority = 0;
+            while (queues[priority].empty()) {
+                ++priority;
+            }
+            job = std::move(queues[priority].front());
+            queues[priority].pop_front();
+            stats.queued[priority] -= 1;
+            stats.queuedBytes -= job.request.size;
+            stats.running += 1;
+        }
+        spaceAvailable.notify_one();
+
+        uint64_t size = job.request.size;
+        ChecksumResult result = run(job.request);
+        try {
+            job.callback(std::move(result));
+        } catch (...) {
+            // Обработчик результата отвечает за свои ошибки сам; поток пула продолжает работу
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.running -= 1;
+        stats.inFlightBytes -= size;
+        stats.completed += 1;
+    }
+}
+
+ChecksumResult ChecksumService::run(ChecksumRequest& request) {
+    ChecksumResult result;
+    try {
+        if (request.appending) {
+            result.digest = computeAppending(request.path, request.algorithmName, request.midstate, result.resumed,
+                                             request.tee);
+            result.midstate = std::move(request.midstate);
+        } else {
+            result.digest = compute(request.path, request.algorithmName, request.tee);
+        }
+    } catch (...) {
+        result.error = std::current_exception();
+    }
+    return result;
+}
+
+Digest ChecksumService::compute(const std::filesystem::path& filePath) {
+    return computeWith<Sha256Policy>(filePath, ChecksumTee{});
+}
+
+Digest ChecksumService::compute(const std::filesystem::path& filePath, ChecksumAlgorithm algorithm) {
+    return visitChecksumAlgorithm(algorithm, [&](auto policy) {
+        return computeWith<decltype(policy)>(filePath, ChecksumTee{});
+    });
+}
+
+Digest ChecksumService::compute(const std::filesystem::path& filePath, const std::string& algorithmName) {
+    return compute(filePath, algorithmName, ChecksumTee{});
+}
+
+Digest ChecksumService::compute(const std::filesystem::path& filePath, const std::string& algorithmName,
+                                const ChecksumTee& tee) {
+    ChecksumAlgorithm algorithm;
+    bool tree;
+    parseDigestAlgorithmName(algorithmName, algorithm, tree);
+    return visitChecksumAlgorithm(algorithm, [&](auto policy) {
+        return tree ? computeTreeWith<decltype(policy)>(filePath, tee)
+                    : computeWith<decltype(policy)>(filePath, tee);
+    });
+}
+
+Digest ChecksumService::computeAppending(const std::filesystem::path& filePath, const std::string& algorithmName,
+                                         HashMidstate& midstate, bool& resumed, const ChecksumTee& tee) {
+    ChecksumAlgorithm algorithm;
+    bool tree;
+    parseDigestAlgorithmName(algorithmName, algorithm, tree);
+    if (tree) {
+        midstate = HashMidstate{};
+        resumed = false;
+        return compute(filePath, algorithmName, tee);
+    }
+    if (tee) {
+        // Копии нужен весь файл, а не только дописанный хвост
+        midstate = HashMidstate{};
+    }
+
+    return visitChecksumAlgorithm(algorithm, [&](auto policy) {
+        return computeAppendingWith<decltype(policy)>(filePath, midstate, resumed, tee);
+    });
+}
+
+QuickFingerprint ChecksumService::computeQuick(const std::filesystem::path& filePath, uint64_t fileSize) {
+    Xxh3Policy::Context context;
+    Xxh3Policy::init(context);
+    auto update = [&](const unsigned char* data, size_t size) {
+        Xxh3Policy::update(context, data, size);
+    };
+
+    const uint64_t block = QuickFingerprint::kSampleSize;
+    if (fileSize <= 3 * block) {
+        FileReader::readRange(filePath, 0, fileSize, update);
+    } else {
+        FileReader::readRange(filePath, 0, block, update);
+        FileReader::readRange(filePath, fileSize / 2 - block / 2, block, update);
+        FileReader::readRange(filePath, fileSize - block, block, update);
+    }
+
+    unsigned char sizeBytes[8];
+    for (int i = 0; i < 8; ++i) {
+        sizeBytes[i] = static_cast<unsigned char>(fileSize >> (8 * i));
+    }
+    Xxh3Policy::update(context, sizeBytes, sizeof(sizeBytes));
+
+    QuickFingerprint quick;
+    quick.size = fileSize;
+    quick.sample = finalValue(context);
+    return quick;
+}
+
+std::string ChecksumService::algorithmFor(const ChecksumConfig& config, uint64_t fileSize) {
+    if (config.treeThreshold > 0 && fileSize >= config.treeThreshold) {
+        return config.algorithm + "-tree";
     }
+    return config.algorithm;
+}
+
+template <typename Algorithm>
+Digest ChecksumService::computeWith(const std::filesystem::path& filePath, const ChecksumTee& tee) {
+    static_assert(Algorithm::digestSize <= Digest::kMaxSize, "Дайджест не помещается в Digest");
 
-    SHA256_CTX sha256Context;
-    SHA256_Init(&sha256Context);
+    typename Algorithm::Context context;
+    Algorithm::init(context);
 
-    char buffer[1024];
-    while (file.read(buffer, sizeof(buffer))) {
-        SHA256_Update(&sha256Context, buffer, file.gcount());
+    // Стратегия чтения (read / pread / mmap) выбирается по размеру файла
+    if (tee) {
+        uint64_t offset = 0;
+        FileReader::read(filePath, [&](const unsigned char* data, size_t size) {
+            Algorithm::update(context, data, size);
+            tee(offset, data, size);
+            offset += size;
+        });
+    } else {
+        FileReader::read(filePath, [&](const unsigned char* data, size_t size) {
+            Algorithm::update(context, data, size);
+        });
     }
-    SHA256_Update(&sha256Context, buffer, file.gcount());  // Для последней части
 
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256_Final(hash, &sha256Context);
+    Digest digest(Algorithm::algorithm, Algorithm::digestSize);
+    Algorithm::final(context, digest.data());
+    return digest;
+}
+
+template <typename Algorithm>
+Digest ChecksumService::computeAppendingWith(const std::filesystem::path& filePath, HashMidstate& midstate, bool& resumed,
+                                             const ChecksumTee& tee) {
+    using Context = typename Algorithm::Context;
+    static_assert(std::is_trivially_copyable<Context>::value, "Контекст должен копироваться побайтно");
+
+    auto update = [&](Context& context) {
+        return [&context, &tee, offset = uint64_t(0)](const unsigned char* data, size_t size) mutable {
+            Algorithm::update(context, data, size);
+            if (tee) {
+                tee(offset, data, size);
+                offset += size;
+            }
+        };
+    };
+
+    Context context;
+    uint64_t fileSize = std::filesystem::file_size(filePath);
+    resumed = midstate.context.size() == 1 + sizeof(Context) &&
+              midstate.context[0] == static_cast<uint8_t>(Algorithm::algorithm) &&
+              fileSize >= midstate.offset &&
+              prefixAnchor(filePath, midstate.offset) == midstate.anchor;
+
+    if (resumed) {
+        std::memcpy(&context, midstate.context.data() + 1, sizeof(Context));
+        FileReader::readRange(filePath, midstate.offset, fileSize - midstate.offset, update(context));
+    } else {
+        Algorithm::init(context);
+        fileSize = FileReader::read(filePath, update(context));
+    }
+
+    midstate.context.resize(1 + sizeof(Context));
+    midstate.context[0] = static_cast<uint8_t>(Algorithm::algorithm);
+    std::memcpy(midstate.context.data() + 1, &context, sizeof(Context));
+    midstate.offset = fileSize;
+    midstate.anchor = prefixAnchor(filePath, fileSize);
+
+    // final портит контекст, поэтому завершаем копию
+    Context finalContext = context;
+    Digest digest(Algorithm::algorithm, Algorithm::digestSize);
+    Algorithm::final(finalContext, digest.data());
+    return digest;
+}
+
+// Дерево Меркла над листами по kTreeChunkSize байт:
+//   лист     = H(0x00 || данные листа)
+//   родитель = H(0x01 || левый || правый), непарный узел поднимается на уровень выше
+//   корень   = H(0x02 || вершина || размер файла, 8 байт little-endian)
+// Листья считаются параллельно, свёртка выполняется в фиксированном порядке.
+template <typename Algorithm>
+Digest ChecksumService::computeTreeWith(const std::filesystem::path& filePath, const ChecksumTee& tee) {
+    using Node = std::array<unsigned char, Algorithm::digestSize>;
+
+    uint64_t fileSize = std::filesystem::file_size(filePath);
+    uint64_t leafCount = fileSize == 0 ? 1 : (fileSize + kTreeChunkSize - 1) / kTreeChunkSize;
+
+    std::vector<std::future<Node>> leaves;
+    leaves.reserve(leafCount);
+    for (uint64_t leaf = 0; leaf < leafCount; ++leaf) {
+        uint64_t offset = leaf * kTreeChunkSize;
+        uint64_t length = std::min(kTreeChunkSize, fileSize - offset);
+        leaves.push_back(treePool().submit([filePath, offset, length, &tee]() {
+            typename Algorithm::Context context;
+            Algorithm::init(context);
+            const unsigned char prefix = 0x00;
+            Algorithm::update(context, &prefix, 1);
+            uint64_t position = offset;
+            FileReader::readRange(filePath, offset, length, [&](const unsigned char* data, size_t size) {
+                Algorithm::update(context, data, size);
+                if (tee) {
+                    tee(position, data, size);
+                    position += size;
+                }
+            });
+            Node node;
+            Algorithm::final(context, node.data());
+            return node;
+        }));
+    }
+
+    for (auto& leaf : leaves) {
+        leaf.wait();
+    }
+    std::vector<Node> level;
+    level.reserve(leafCount);
+    for (auto& leaf : leaves) {
+        level.push_back(leaf.get());
+    }
+
+    while (level.size() > 1) {
+        std::vector<Node> parents;
+        parents.reserve((level.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < level.size(); i += 2) {
+            typename Algorithm::Context context;
+            Algorithm::init(context);
+            const unsigned char prefix = 0x01;
+            Algorithm::update(context, &prefix, 1);
+            Algorithm::update(context, level[i].data(), level[i].size());
+            Algorithm::update(context, level[i + 1].data(), level[i + 1].size());
+            Node parent;
+            Algorithm::final(context, parent.data());
+            parents.push_back(parent);
+        }
+        if (level.size() % 2 == 1) {
+            parents.push_back(level.back());
+        }
+        level.swap(parents);
+    }
 
-    std::ostringstream result;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        result << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    typename Algorithm::Context context;
+    Algorithm::init(context);
+    const unsigned char prefix = 0x02;
+    Algorithm::update(context, &prefix, 1);
+    Algorithm::update(context, level.front().data(), level.front().size());
+    unsigned char sizeBytes[8];
+    for (int i = 0; i < 8; ++i) {
+        sizeBytes[i] = static_cast<unsigned char>(fileSize >> (8 * i));
     }
+    Algorithm::update(context, sizeBytes, sizeof(sizeBytes));
 
-    return result.str();
+    Digest digest(Algorithm::algorithm, Algorithm::digestSize, true);
+    Algorithm::final(context, digest.data());
+    return digest;
 }
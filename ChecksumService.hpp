@@ -1,9 +1,140 @@
 #pragma once
 
-#include <string>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ChecksumAlgorithms.hpp"
+#include "ConfigLoader.hpp"
+#include "Digest.hpp"
+#include "HashMidstate.hpp"
+#include "QuickFingerprint.hpp"
+
+// Очереди пула хеширования: задачи с более высоким приоритетом выбираются первыми
+enum class ChecksumPriority {
+    High,   // события inotify
+    Normal, // первичный обход и инициализация
+    Low     // фоновые перепроверки
+};
+
+// Получает каждый прочитанный при хешировании блок вместе с его смещением в файле.
+// В режиме дерева вызывается из нескольких потоков и не по порядку смещений.
+using ChecksumTee = std::function<void(uint64_t offset, const unsigned char* data, size_t size)>;
+
+struct ChecksumRequest {
+    std::filesystem::path path;
+    std::string algorithmName;
+    ChecksumPriority priority = ChecksumPriority::Normal;
+    bool appending = false;   // computeAppending с midstate вместо полного хеша
+    HashMidstate midstate;
+    uint64_t size = 0;        // байт для учёта очереди; 0 — размер определяется по stat
+    ChecksumTee tee;          // непусто — файл читается целиком (midstate не используется)
+};
 
+struct ChecksumResult {
+    Digest digest;
+    HashMidstate midstate;    // для appending — состояние на конец файла
+    bool resumed = false;
+    std::exception_ptr error; // непусто — хеш вычислить не удалось
+};
+
+struct ChecksumQueueStats {
+    size_t queued[3] = {};    // задач в очереди по приоритетам
+    size_t running = 0;       // задач в работе
+    uint64_t queuedBytes = 0;
+    uint64_t inFlightBytes = 0; // в очереди и в работе
+    uint64_t completed = 0;
+    uint64_t waits = 0;       // сколько раз отправитель ждал места в очереди
+
+    size_t queuedTotal() const {
+        return queued[0] + queued[1] + queued[2];
+    }
+};
+
+// Статические методы считают хеш синхронно в вызывающем потоке.
+// Экземпляр дополнительно владеет пулом потоков с ограниченной очередью: submit ждёт,
+// пока в очереди не освободится место (по числу задач или байтам), trySubmit в этом случае
+// сразу возвращает false. Задачи, отправленные из потоков самого пула, не ждут.
 class ChecksumService {
 public:
-    static std::string compute(const std::filesystem::path& filePath);
+    using Callback = std::function<void(ChecksumResult)>;
+
+    static constexpr size_t kDefaultQueueLimit = 64;
+    static constexpr uint64_t kDefaultQueuedBytesLimit = 512ull * 1024 * 1024;
+
+    // Размер листа дерева фиксирован: дайджест не зависит от числа потоков и настроек группы
+    static constexpr uint64_t kTreeChunkSize = 4 * 1024 * 1024;
+
+    // Не меньше двух потоков: один большой файл не должен занимать весь пул
+    explicit ChecksumService(size_t threadCount = std::max(2u, std::thread::hardware_concurrency()),
+                             size_t queueLimit = kDefaultQueueLimit,
+                             uint64_t queuedBytesLimit = kDefaultQueuedBytesLimit);
+    ~ChecksumService();
+
+    ChecksumService(const ChecksumService&) = delete;
+    ChecksumService& operator=(const ChecksumService&) = delete;
+
+    // callback вызывается в потоке пула, ошибка передаётся в ChecksumResult::error
+    void submit(ChecksumRequest request, Callback callback);
+    bool trySubmit(const ChecksumRequest& request, const Callback& callback);
+    // Ошибка хеширования пробрасывается из future::get
+    std::future<ChecksumResult> submit(ChecksumRequest request);
+
+    ChecksumQueueStats queueStats() const;
+
+    static Digest compute(const std::filesystem::path& filePath);
+    static Digest compute(const std::filesystem::path& filePath, ChecksumAlgorithm algorithm);
+    // Имя может содержать суффикс "-tree" (например, "sha256-tree") — тогда считается дерево Меркла
+    static Digest compute(const std::filesystem::path& filePath, const std::string& algorithmName);
+    // То же, но каждый прочитанный блок дополнительно передаётся в tee (например, в копию файла)
+    static Digest compute(const std::filesystem::path& filePath, const std::string& algorithmName,
+                          const ChecksumTee& tee);
+
+    // Считает сумму, продолжая с midstate, если файл с тех пор только дописывался
+    // (размер не уменьшился и окна префикса совпадают); иначе читает файл целиком.
+    // Обновляет midstate до текущего конца файла. Для режима дерева состояние не хранится.
+    static Digest computeAppending(const std::filesystem::path& filePath, const std::string& algorithmName,
+                                   HashMidstate& midstate, bool& resumed, const ChecksumTee& tee = {});
+
+    // Быстрый слепок файла размера fileSize (читает не более трёх блоков kSampleSize)
+    static QuickFingerprint computeQuick(const std::filesystem::path& filePath, uint64_t fileSize);
+
+    // Имя алгоритма, которым группа хеширует файл данного размера
+    static std::string algorithmFor(const ChecksumConfig& config, uint64_t fileSize);
+
+private:
+    struct Job {
+        ChecksumRequest request;
+        Callback callback;
+    };
+
+    bool enqueue(ChecksumRequest&& request, Callback&& callback, bool wait);
+    void workerLoop();
+    static ChecksumResult run(ChecksumRequest& request);
+
+    std::vector<std::thread> workers;
+    std::deque<Job> queues[3];
+    mutable std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable spaceAvailable;
+    bool stopping = false;
+    size_t queueLimit;
+    uint64_t queuedBytesLimit;
+    ChecksumQueueStats stats;
+
+    template <typename Algorithm>
+    static Digest computeWith(const std::filesystem::path& filePath, const ChecksumTee& tee);
+    template <typename Algorithm>
+    static Digest computeTreeWith(const std::filesystem::path& filePath, const ChecksumTee& tee);
+    template <typename Algorithm>
+    static Digest computeAppendingWith(const std::filesystem::path& filePath, HashMidstate& midstate, bool& resumed,
+                                       const ChecksumTee& tee);
 };
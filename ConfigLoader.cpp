@@ -1,6 +1,10 @@
 #include "ConfigLoader.hpp"
 #include <fstream>
+#include <stdexcept>
 #include "nlohmann/json.hpp"
+#include "ChecksumAlgorithms.hpp"
+#include "VaultCompression.hpp"
+#include "VaultPack.hpp"
 
 ConfigLoader::ConfigLoader(const std::string& configPath)
     : m_configPath(configPath) {}
@@ -18,6 +22,9 @@ bool ConfigLoader::load() {
     } catch (const nlohmann::json::exception& ex) {
         // Можно логировать ошибку
         return false;
+    } catch (const std::invalid_argument& ex) {
+        // Неизвестный алгоритм контрольной суммы или некорректные параметры группы
+        return false;
     }
 
     return true;
@@ -45,12 +52,110 @@ void ConfigLoader::parse(const nlohmann::json& root) {
         mg.checksum.enabled = checksumObj.at("enabled").get<bool>();
         if (mg.checksum.enabled) {
             mg.checksum.algorithm = checksumObj.at("algorithm").get<std::string>();
+            parseChecksumAlgorithm(mg.checksum.algorithm); // проверка имени алгоритма
+            mg.checksum.treeThreshold = checksumObj.value("tree_threshold_mb", 0ull) * 1024 * 1024;
+            mg.checksum.trustStat = checksumObj.value("trust_stat", true);
+            mg.checksum.paranoidRounds = checksumObj.value("paranoid_rounds", 0u);
+            mg.checksum.appendOnly = checksumObj.value("append_only", false);
+            mg.checksum.quickCheck = checksumObj.value("quick_check", false);
+            mg.checksum.quickCheckFullInterval = checksumObj.value("quick_check_full_interval_s", 3600u);
+        }
+
+        if (group.contains("vault")) {
+            auto vaultObj = group.at("vault");
+            mg.vault.chunking = vaultObj.value("chunking", mg.vault.chunking);
+            mg.vault.chunkingMinFileSize = vaultObj.value("chunking_min_file_mb", 4ull) * 1024 * 1024;
+            mg.vault.chunkMinSize = vaultObj.value("chunk_min_kb", 16u) * 1024;
+            mg.vault.chunkAvgSize = vaultObj.value("chunk_avg_kb", 64u) * 1024;
+            mg.vault.chunkMaxSize = vaultObj.value("chunk_max_kb", 256u) * 1024;
+            mg.vault.delta = vaultObj.value("delta", mg.vault.delta);
+            mg.vault.deltaKeyframeInterval = vaultObj.value("delta_keyframe_interval", 16u);
+            mg.vault.deltaMaxChainBytes = vaultObj.value("delta_max_chain_mb", 64ull) * 1024 * 1024;
+            mg.vault.compression = vaultObj.value("compression", mg.vault.compression);
+            parseVaultCompression(mg.vault.compression); // проверка имени
+            mg.vault.compressionLevel = vaultObj.value("compression_level", mg.vault.compressionLevel);
+            if (mg.vault.compressionLevel < 1 || mg.vault.compressionLevel > 9) {
+                throw std::invalid_argument("compression_level должен быть от 1 до 9 в группе " + mg.id);
+            }
+            mg.vault.packing = vaultObj.value("packing", mg.vault.packing);
+            mg.vault.packMaxObjectSize = vaultObj.value("pack_max_kb", 64ull) * 1024;
+            if (mg.vault.packMaxObjectSize == 0 || mg.vault.packMaxObjectSize > VaultPack::kMaxObjectSize) {
+                throw std::invalid_argument("pack_max_kb должен быть от 1 до " +
+                                            std::to_string(VaultPack::kMaxObjectSize / 1024) + " в группе " + mg.id);
+            }
+            mg.vault.hotVersions = vaultObj.value("hot_versions", mg.vault.hotVersions);
+            if (mg.vault.hotVersions > 0) {
+                if (mg.vault.compression != "none") {
+                    mg.vault.coldCompression = mg.vault.compression;
+                }
+                mg.vault.compression = "none";
+                mg.vault.delta = false;
+            }
+            if (mg.vault.deltaKeyframeInterval == 0) {
+                throw std::invalid_argument("delta_keyframe_interval должен быть больше нуля в группе " + mg.id);
+            }
+            if (mg.vault.chunkMinSize == 0 || mg.vault.chunkMinSize > mg.vault.chunkAvgSize ||
+                mg.vault.chunkAvgSize > mg.vault.chunkMaxSize) {
+                throw std::invalid_argument("Некорректные размеры фрагментов в группе " + mg.id);
+            }
+        }
+
+        if (group.contains("retention")) {
+            auto retentionObj = group.at("retention");
+            mg.retention.keepLast = retentionObj.value("keep_last", 0u);
+            mg.retention.keepHourly = retentionObj.value("keep_hourly", 0u);
+            mg.retention.keepDaily = retentionObj.value("keep_daily", 0u);
+            mg.retention.keepWeekly = retentionObj.value("keep_weekly", 0u);
+            mg.retention.maxAgeDays = retentionObj.value("max_age_days", 0u);
+            mg.retention.maxBytes = retentionObj.value("max_bytes_mb", 0ull) * 1024 * 1024;
         }
 
         m_monitoringGroups.push_back(mg);
     }
+
+    m_scanConfig = ScanConfig();
+    if (root.contains("scan")) {
+        auto scanObj = root.at("scan");
+        m_scanConfig.queueDepth = scanObj.value("queue_depth", m_scanConfig.queueDepth);
+        m_scanConfig.ioUring = scanObj.value("io_uring", m_scanConfig.ioUring);
+        m_scanConfig.batchSmallFiles = scanObj.value("batch_small_files", m_scanConfig.batchSmallFiles);
+    }
+
+    m_gcConfig = GcConfig();
+    if (root.contains("gc")) {
+        auto gcObj = root.at("gc");
+        m_gcConfig.enabled = gcObj.value("enabled", m_gcConfig.enabled);
+        m_gcConfig.intervalMinutes = gcObj.value("interval_min", m_gcConfig.intervalMinutes);
+        m_gcConfig.batchSize = gcObj.value("batch", m_gcConfig.batchSize);
+        if (m_gcConfig.intervalMinutes == 0 || m_gcConfig.batchSize == 0) {
+            throw std::invalid_argument("interval_min и batch в разделе gc должны быть больше нуля");
+        }
+    }
+
+    m_scrubConfig = ScrubConfig();
+    if (root.contains("scrub")) {
+        auto scrubObj = root.at("scrub");
+        m_scrubConfig.enabled = scrubObj.value("enabled", m_scrubConfig.enabled);
+        m_scrubConfig.bytesPerSecond = scrubObj.value("rate_mb_s", 8ull) * 1024 * 1024;
+        m_scrubConfig.roundIntervalHours = scrubObj.value("round_interval_hours", m_scrubConfig.roundIntervalHours);
+        if (m_scrubConfig.bytesPerSecond == 0) {
+            throw std::invalid_argument("rate_mb_s в разделе scrub должен быть больше нуля");
+        }
+    }
 }
 
 const std::vector<MonitoringGroup>& ConfigLoader::getMonitoringGroups() const {
     return m_monitoringGroups;
 }
+
+const ScanConfig& ConfigLoader::getScanConfig() const {
+    return m_scanConfig;
+}
+
+const GcConfig& ConfigLoader::getGcConfig() const {
+    return m_gcConfig;
+}
+
+const ScrubConfig& ConfigLoader::getScrubConfig() const {
+    return m_scrubConfig;
+}
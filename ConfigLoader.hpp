@@ -1,6 +1,7 @@
 // ConfigLoader.h
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -13,7 +14,71 @@ struct PathConfig {
 
 struct ChecksumConfig {
     bool enabled;
-    std::string algorithm;
+    std::string algorithm = "sha256"; // sha256 | blake3 | xxh3 | crc32c
+    uint64_t treeThreshold = 0;       // байт; файлы не меньше порога хешируются деревом (0 — выключено)
+    bool trustStat = true;            // не перечитывать файл при совпадении inode/размера/mtime/ctime
+    uint32_t paranoidRounds = 0;      // раз в N запусков каждый файл перепроверяется полностью (0 — никогда)
+    bool appendOnly = false;          // файлы только дописываются: хеш продолжается с сохранённого состояния
+    bool quickCheck = false;          // при IN_MODIFY сначала сравнивается быстрый слепок (размер + выборочные блоки)
+    uint32_t quickCheckFullInterval = 3600; // с; полный хеш не реже этого интервала, даже без новых IN_MODIFY (0 — только по слепку)
+};
+
+// Первичный обход (раздел "scan" в config.json)
+struct ScanConfig {
+    unsigned queueDepth = 32; // одновременных операций ввода-вывода
+    bool ioUring = true;      // false — только pread в пуле потоков
+    bool batchSmallFiles = true; // маленькие файлы SHA-256 хешируются пакетами (многобуферный SIMD)
+};
+
+// Сборка мусора в хранилище (раздел "gc" в config.json). Выключена, пока её не включат явно:
+// она удаляет историю и версии по правилам хранения групп и переносит версии в холодный слой
+struct GcConfig {
+    bool enabled = false;
+    uint32_t intervalMinutes = 60;   // между проходами; первый — через интервал после запуска
+    uint32_t batchSize = 256;        // записей истории или объектов хранилища за шаг, между шагами — пауза
+};
+
+// Фоновая проверка целостности хранилища (раздел "scrub" в config.json)
+struct ScrubConfig {
+    bool enabled = true;
+    uint64_t bytesPerSecond = 8 * 1024 * 1024;   // прочитанных из хранилища байт в секунду
+    uint32_t roundIntervalHours = 24;            // полный проход начинается не чаще
+};
+
+// Хранение версий группы (раздел "vault" группы)
+struct VaultConfig {
+    bool chunking = false;                         // большие файлы хранятся фрагментами по содержимому (FastCDC)
+    uint64_t chunkingMinFileSize = 4 * 1024 * 1024; // байт; файлы меньше порога хранятся целиком
+    uint32_t chunkMinSize = 16 * 1024;             // байт
+    uint32_t chunkAvgSize = 64 * 1024;             // байт; округляется вниз до степени двойки
+    uint32_t chunkMaxSize = 256 * 1024;            // байт
+    bool delta = false;                            // версия при изменении хранится дельтой к предыдущей
+    uint32_t deltaKeyframeInterval = 16;           // полная версия (ключевой кадр) не реже чем через N версий
+    uint64_t deltaMaxChainBytes = 64 * 1024 * 1024; // байт; ключевой кадр и когда дельты после него превысят порог
+    std::string compression = "none";              // none | lz4 | zlib — сжатие версий и фрагментов
+    int compressionLevel = 6;                      // уровень zlib (1–9)
+    bool packing = false;                          // мелкие версии дописываются в сегменты-пакеты (VaultPack)
+    uint64_t packMaxObjectSize = 64 * 1024;        // байт в хранилище; версии крупнее хранятся отдельными файлами
+    // Горячий слой: последние N версий файла хранятся целиком без сжатия, более старые сборка
+    // мусора (gc.enabled) переносит в холодный слой <vault>/cold со сжатием coldCompression (0 — выключено).
+    // При N > 0 версии сохраняются без сжатия и без дельт, compression задаёт сжатие холодного слоя
+    uint32_t hotVersions = 0;
+    std::string coldCompression = "zlib";          // lz4 | zlib
+};
+
+// Сколько версий файла хранить (раздел "retention" группы). Правила keep_* объединяются: версия
+// остаётся, если её оставляет хотя бы одно; без keep_* остаются все. Затем max_age и max_bytes
+// убирают самые старые. Последняя версия каждого файла хранится всегда
+struct RetentionConfig {
+    uint32_t keepLast = 0;           // последние N версий
+    uint32_t keepHourly = 0;         // последняя версия в каждом из N последних часов, где были версии
+    uint32_t keepDaily = 0;          // то же по суткам (UTC)
+    uint32_t keepWeekly = 0;         // то же по неделям (с понедельника)
+    uint32_t maxAgeDays = 0;         // версии старше удаляются (0 — без ограничения)
+    uint64_t maxBytes = 0;           // байт в хранилище на группу, приблизительно (0 — без ограничения)
+
+    bool keepRules() const { return keepLast || keepHourly || keepDaily || keepWeekly; }
+    bool enabled() const { return keepRules() || maxAgeDays || maxBytes; }
 };
 
 struct MonitoringGroup {
@@ -22,6 +87,8 @@ struct MonitoringGroup {
     std::vector<PathConfig> paths;
     std::vector<std::string> events;
     ChecksumConfig checksum;
+    VaultConfig vault;
+    RetentionConfig retention;
 };
 
 class ConfigLoader {
@@ -30,10 +97,16 @@ public:
 
     bool load(); // Загрузка конфига
     const std::vector<MonitoringGroup>& getMonitoringGroups() const;
+    const ScanConfig& getScanConfig() const;
+    const GcConfig& getGcConfig() const;
+    const ScrubConfig& getScrubConfig() const;
 
 private:
     std::string m_configPath;
     std::vector<MonitoringGroup> m_monitoringGroups;
+    ScanConfig m_scanConfig;
+    GcConfig m_gcConfig;
+    ScrubConfig m_scrubConfig;
 
     void parse(const nlohmann::json& root); // Разбор JSON
 };
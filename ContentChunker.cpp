@@ -0,0 +1,86 @@
+// ContentChunker.cpp
+#include "ContentChunker.hpp"
+#include <array>
+#include <stdexcept>
+
+namespace {
+
+// Таблица gear: 256 псевдослучайных 64-битных значений (splitmix64 с постоянным зерном)
+std::array<uint64_t, 256> makeGearTable() {
+    std::array<uint64_t, 256> table {};
+    uint64_t state = 0x6a09e667f3bcc908ull;
+    for (auto& value : table) {
+        state += 0x9e3779b97f4a7c15ull;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}
+
+const std::array<uint64_t, 256> kGear = makeGearTable();
+
+// Маска из старших бит: они зависят от последних 64 байт, младшие — только от последних
+uint64_t topBits(unsigned bits) {
+    return bits == 0 ? 0 : ~0ull << (64 - bits);
+}
+
+unsigned log2Floor(uint32_t value) {
+    unsigned bits = 0;
+    while (value >>= 1) {
+        ++bits;
+    }
+    return bits;
+}
+
+} // namespace
+
+ContentChunker::ContentChunker(uint32_t minSize, uint32_t avgSize, uint32_t maxSize, ChunkSink sink)
+    : minSize(minSize), maxSize(maxSize), sink(std::move(sink)) {
+    if (minSize == 0 || minSize > avgSize || avgSize > maxSize) {
+        throw std::invalid_argument("Некорректные размеры фрагментов");
+    }
+    unsigned bits = log2Floor(avgSize);
+    normalSize = 1u << bits;
+    maskSmall = topBits(bits + 2);
+    maskLarge = topBits(bits > 2 ? bits - 2 : 0);
+    pending.reserve(maxSize);
+}
+
+void ContentChunker::update(const unsigned char* data, size_t size) {
+    size_t start = 0;
+    for (size_t i = 0; i < size; ++i) {
+        ++length;
+        if (length <= minSize) {
+            // Граница раньше minSize невозможна, хеш этих байт не нужен
+            continue;
+        }
+        hash = (hash << 1) + kGear[data[i]];
+        uint64_t mask = length < normalSize ? maskSmall : maskLarge;
+        if ((hash & mask) == 0 || length >= maxSize) {
+            emit(data + start, i + 1 - start);
+            start = i + 1;
+        }
+    }
+    pending.insert(pending.end(), data + start, data + size);
+}
+
+void ContentChunker::finish() {
+    if (length > 0) {
+        emit(nullptr, 0);
+    }
+}
+
+void ContentChunker::emit(const unsigned char* data, size_t size) {
+    if (pending.empty()) {
+        // Фрагмент целиком внутри текущего блока — без копирования
+        sink(data, size);
+    } else {
+        pending.insert(pending.end(), data, data + size);
+        sink(pending.data(), pending.size());
+        pending.clear();
+    }
+    length = 0;
+    hash = 0;
+}
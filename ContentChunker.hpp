@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Разбиение потока байт на фрагменты по содержимому (FastCDC с нормализацией размеров).
+// Граница ставится там, где скользящий gear-хеш последних байт попадает под маску,
+// поэтому правка в середине файла меняет один-два фрагмента, а не все последующие.
+// До minSize граница не ищется, после maxSize ставится принудительно; до avgSize
+// используется более строгая маска, после — более мягкая, и размеры собираются около avgSize.
+// Таблица gear и маски определяют границы: при их изменении новые версии перестанут
+// разделять фрагменты с уже сохранёнными.
+class ContentChunker {
+public:
+    using ChunkSink = std::function<void(const unsigned char* data, size_t size)>;
+
+    // avgSize округляется вниз до степени двойки; minSize <= avgSize <= maxSize
+    ContentChunker(uint32_t minSize, uint32_t avgSize, uint32_t maxSize, ChunkSink sink);
+
+    // Данные подаются по порядку; готовые фрагменты сразу передаются в sink
+    void update(const unsigned char* data, size_t size);
+    // Отдаёт последний (неполный) фрагмент
+    void finish();
+
+private:
+    void emit(const unsigned char* data, size_t size);
+
+    uint32_t minSize;
+    uint32_t normalSize;
+    uint32_t maxSize;
+    uint64_t maskSmall;           // до normalSize: больше бит — граница реже
+    uint64_t maskLarge;           // после normalSize: меньше бит — граница чаще
+    ChunkSink sink;
+
+    std::vector<unsigned char> pending; // начало текущего фрагмента из прошлых update
+    uint32_t length = 0;          // длина текущего фрагмента
+    uint64_t hash = 0;
+};
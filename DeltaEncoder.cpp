@@ -0,0 +1,254 @@
+// DeltaEncoder.cpp
+#include "DeltaEncoder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kMaxLiteral = 1024 * 1024;   // длинная вставка выдаётся частями, pending не растёт
+constexpr unsigned kFilterBits = 20;
+constexpr size_t kCompareStep = 4096;         // совпадение продлевается сначала целыми участками
+
+size_t filterIndex(uint32_t weak) {
+    return (weak * 0x9e3779b1u) >> (32 - kFilterBits);
+}
+
+uint32_t weakSum(uint32_t a, uint32_t b) {
+    return (a & 0xffff) | (b << 16);
+}
+
+void putU64(unsigned char* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+uint64_t readU64(std::istream& input) {
+    unsigned char bytes[8];
+    if (!input.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+        throw std::runtime_error("Дельта версии обрывается");
+    }
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+} // namespace
+
+uint32_t DeltaEncoder::blockSizeFor(uint64_t baseSize) {
+    uint32_t blockSize = kMinBlockSize;
+    uint64_t root = static_cast<uint64_t>(std::sqrt(static_cast<double>(baseSize)));
+    while (blockSize < kMaxBlockSize && blockSize < root) {
+        blockSize <<= 1;
+    }
+    return blockSize;
+}
+
+DeltaEncoder::DeltaEncoder(const unsigned char* base, size_t baseSize, Sink sink)
+    : base(base), baseSize(baseSize), blockSize(blockSizeFor(baseSize)), sink(std::move(sink)),
+      filter(size_t(1) << kFilterBits) {
+    size_t count = baseSize / blockSize;
+    blocks.reserve(count);
+    for (size_t index = 0; index < count; ++index) {
+        const unsigned char* block = base + index * blockSize;
+        uint32_t a = 0;
+        uint32_t b = 0;
+        for (uint32_t i = 0; i < blockSize; ++i) {
+            a += block[i];
+            b += (blockSize - i) * block[i];
+        }
+        uint32_t weak = weakSum(a, b);
+        blocks.emplace(weak, static_cast<uint32_t>(index));
+        filter[filterIndex(weak)] = true;
+    }
+}
+
+void DeltaEncoder::update(const unsigned char* data, size_t size) {
+    if (head > 0) {
+        pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(head));
+        position -= std::min(position, head);
+        head = 0;
+    }
+    pending.insert(pending.end(), data, data + size);
+    process(false);
+}
+
+void DeltaEncoder::finish() {
+    process(true);
+}
+
+void DeltaEncoder::process(bool final) {
+    while (true) {
+        if (matching) {
+            // Продление совпадения за пределы найденного блока
+            size_t available = pending.size() - head;
+            uint64_t baseOffset = copyOffset + copyLength;
+            size_t limit = static_cast<size_t>(std::min<uint64_t>(available, baseSize - baseOffset));
+            const unsigned char* data = pending.data() + head;
+            const unsigned char* reference = base + baseOffset;
+            size_t length = 0;
+            while (length + kCompareStep <= limit && std::memcmp(data + length, reference + length, kCompareStep) == 0) {
+                length += kCompareStep;
+            }
+            while (length < limit && data[length] == reference[length]) {
+                ++length;
+            }
+            copyLength += length;
+            head += length;
+            if (length == available && baseOffset + length < baseSize && !final) {
+                break;
+            }
+            matching = false;
+            position = head;
+            windowValid = false;
+            continue;
+        }
+
+        if (pending.size() - position < blockSize) {
+            if (final) {
+                emitLiteral(head, pending.size());
+                head = pending.size();
+                flushCopy();
+            }
+            break;
+        }
+
+        if (!windowValid) {
+            const unsigned char* window = pending.data() + position;
+            sumA = 0;
+            sumB = 0;
+            for (uint32_t i = 0; i < blockSize; ++i) {
+                sumA += window[i];
+                sumB += (blockSize - i) * window[i];
+            }
+            windowValid = true;
+        }
+
+        // Сдвиг окна до первой суммы, которая может быть в базе (состояние в локальных переменных)
+        const unsigned char* data = pending.data();
+        size_t last = pending.size() - blockSize;     // последнее возможное начало окна
+        size_t limit = std::min(last, head + kMaxLiteral);
+        size_t start = position;
+        uint32_t a = sumA;
+        uint32_t b = sumB;
+        while (start < limit && !filter[filterIndex(weakSum(a, b))]) {
+            uint32_t out = data[start];
+            uint32_t in = data[start + blockSize];
+            a = a - out + in;
+            b = b - blockSize * out + a;
+            ++start;
+        }
+        position = start;
+        sumA = a;
+        sumB = b;
+
+        uint32_t weak = weakSum(sumA, sumB);
+        if (filter[filterIndex(weak)]) {
+            auto found = blocks.find(weak);
+            if (found != blocks.end()) {
+                uint64_t offset = static_cast<uint64_t>(found->second) * blockSize;
+                if (std::memcmp(data + position, base + offset, blockSize) == 0) {
+                    emitLiteral(head, position);
+                    emitCopy(offset, blockSize);
+                    head = position + blockSize;
+                    matching = true;
+                    continue;
+                }
+            }
+        }
+
+        if (position - head >= kMaxLiteral) {
+            emitLiteral(head, position);
+            head = position;
+        }
+        if (position == last) {
+            // Для сдвига окна нужен следующий байт
+            if (final) {
+                emitLiteral(head, pending.size());
+                head = pending.size();
+                flushCopy();
+            }
+            break;
+        }
+        uint32_t out = data[position];
+        uint32_t in = data[position + blockSize];
+        sumA = sumA - out + in;
+        sumB = sumB - blockSize * out + sumA;
+        ++position;
+    }
+}
+
+void DeltaEncoder::emitLiteral(size_t begin, size_t end) {
+    if (begin == end) {
+        return;
+    }
+    flushCopy();
+    unsigned char header[9];
+    header[0] = 'L';
+    putU64(header + 1, end - begin);
+    output(header, sizeof(header));
+    output(pending.data() + begin, end - begin);
+}
+
+void DeltaEncoder::emitCopy(uint64_t offset, uint64_t length) {
+    if (copyLength > 0 && copyOffset + copyLength == offset) {
+        copyLength += length;
+        return;
+    }
+    flushCopy();
+    copyOffset = offset;
+    copyLength = length;
+}
+
+void DeltaEncoder::flushCopy() {
+    if (copyLength == 0) {
+        return;
+    }
+    unsigned char operation[17];
+    operation[0] = 'C';
+    putU64(operation + 1, copyOffset);
+    putU64(operation + 9, copyLength);
+    output(operation, sizeof(operation));
+    copyLength = 0;
+}
+
+void DeltaEncoder::output(const unsigned char* data, size_t size) {
+    sink(data, size);
+    encoded += size;
+}
+
+uint64_t DeltaEncoder::apply(const unsigned char* base, size_t baseSize, std::istream& delta, const Sink& sink) {
+    std::vector<unsigned char> buffer;
+    uint64_t total = 0;
+    char operation;
+    while (delta.get(operation)) {
+        if (operation == 'C') {
+            uint64_t offset = readU64(delta);
+            uint64_t length = readU64(delta);
+            if (offset > baseSize || length > baseSize - offset) {
+                throw std::runtime_error("Дельта ссылается за пределы базовой версии");
+            }
+            sink(base + offset, static_cast<size_t>(length));
+            total += length;
+        } else if (operation == 'L') {
+            uint64_t length = readU64(delta);
+            buffer.resize(static_cast<size_t>(std::min<uint64_t>(length, kMaxLiteral)));
+            for (uint64_t left = length; left > 0;) {
+                size_t part = static_cast<size_t>(std::min<uint64_t>(left, buffer.size()));
+                if (!delta.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(part))) {
+                    throw std::runtime_error("Дельта версии обрывается");
+                }
+                sink(buffer.data(), part);
+                left -= part;
+            }
+            total += length;
+        } else {
+            throw std::runtime_error("Неизвестная операция в дельте версии");
+        }
+    }
+    return total;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <unordered_map>
+#include <vector>
+
+// Двоичная дельта новой версии относительно базовой (сопоставление блоков, как в rsync).
+// База делится на блоки blockSize байт и индексируется слабой скользящей суммой;
+// по новым данным окно сдвигается на байт, кандидат проверяется сравнением с базой,
+// совпадение продлевается побайтно. Результат — последовательность операций:
+//   'C' <u64 смещение в базе> <u64 длина>   — скопировать из базы
+//   'L' <u64 длина> <байты>                 — вставить данные
+// Новые данные подаются потоком (файл читается один раз), база должна быть в памяти целиком.
+class DeltaEncoder {
+public:
+    using Sink = std::function<void(const unsigned char* data, size_t size)>;
+
+    static constexpr uint32_t kMinBlockSize = 1024;
+    static constexpr uint32_t kMaxBlockSize = 64 * 1024;
+
+    DeltaEncoder(const unsigned char* base, size_t baseSize, Sink sink);
+
+    void update(const unsigned char* data, size_t size);
+    void finish();
+
+    // Байт операций, переданных в sink
+    uint64_t encodedSize() const { return encoded; }
+
+    // Около корня из размера базы, степень двойки в [kMinBlockSize, kMaxBlockSize]
+    static uint32_t blockSizeFor(uint64_t baseSize);
+
+    // Восстанавливает версию по базе и операциям; возвращает её размер
+    static uint64_t apply(const unsigned char* base, size_t baseSize, std::istream& delta, const Sink& sink);
+
+private:
+    void process(bool final);
+    void emitLiteral(size_t begin, size_t end);
+    void emitCopy(uint64_t offset, uint64_t length);
+    void flushCopy();
+    void output(const unsigned char* data, size_t size);
+
+    const unsigned char* base;
+    size_t baseSize;
+    uint32_t blockSize;
+    Sink sink;
+    uint64_t encoded = 0;
+
+    std::unordered_map<uint32_t, uint32_t> blocks; // слабая сумма -> номер первого блока с ней
+    std::vector<uint8_t> filter;                   // быстрый отсев сумм, которых нет в базе
+
+    std::vector<unsigned char> pending;            // ещё не закодированные данные
+    size_t head = 0;                               // начало невыданных данных в pending
+    size_t position = 0;                           // начало окна в pending
+    bool windowValid = false;
+    uint32_t sumA = 0;
+    uint32_t sumB = 0;
+
+    bool matching = false;                         // совпадение продлевается на новые данные
+    uint64_t copyOffset = 0;                       // накопленная операция копирования
+    uint64_t copyLength = 0;
+};
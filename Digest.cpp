@@ -0,0 +1,66 @@
+// Digest.cpp
+#include "Digest.hpp"
+#include <stdexcept>
+
+namespace {
+
+const std::string kTreeSuffix = "-tree";
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+void parseDigestAlgorithmName(const std::string& name, ChecksumAlgorithm& algorithm, bool& tree) {
+    tree = name.size() > kTreeSuffix.size() &&
+           name.compare(name.size() - kTreeSuffix.size(), kTreeSuffix.size(), kTreeSuffix) == 0;
+    algorithm = parseChecksumAlgorithm(tree ? name.substr(0, name.size() - kTreeSuffix.size()) : name);
+}
+
+std::string Digest::algorithmName() const {
+    std::string name = checksumAlgorithmName(algorithm);
+    return tree ? name + kTreeSuffix : name;
+}
+
+std::string Digest::toHex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0x0F];
+    }
+    return hex;
+}
+
+Digest Digest::fromBytes(const std::string& algorithmName, const void* data, size_t size) {
+    if (size > kMaxSize) {
+        throw std::invalid_argument("Слишком длинная контрольная сумма");
+    }
+    Digest digest;
+    parseDigestAlgorithmName(algorithmName, digest.algorithm, digest.tree);
+    digest.size = static_cast<uint8_t>(size);
+    if (size > 0) {
+        std::memcpy(digest.bytes.data(), data, size);
+    }
+    return digest;
+}
+
+Digest Digest::fromHex(const std::string& algorithmName, const std::string& hex) {
+    if (hex.size() % 2 != 0 || hex.size() / 2 > kMaxSize) {
+        throw std::invalid_argument("Некорректная контрольная сумма: " + hex);
+    }
+    uint8_t raw[kMaxSize];
+    for (size_t i = 0; i < hex.size() / 2; ++i) {
+        int high = hexValue(hex[2 * i]);
+        int low = hexValue(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            throw std::invalid_argument("Некорректная контрольная сумма: " + hex);
+        }
+        raw[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return fromBytes(algorithmName, raw, hex.size() / 2);
+}
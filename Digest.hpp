@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "ChecksumAlgorithms.hpp"
+
+// Контрольная сумма фиксированного размера с тегом алгоритма.
+// Хранится без аллокаций; в шестнадцатеричный вид переводится только для журнала и CLI.
+struct Digest {
+    static constexpr size_t kMaxSize = 32;
+
+    ChecksumAlgorithm algorithm = ChecksumAlgorithm::Sha256;
+    bool tree = false;   // дерево Меркла (суффикс "-tree" в имени алгоритма)
+    uint8_t size = 0;    // 0 — сумма отсутствует
+    std::array<uint8_t, kMaxSize> bytes{};
+
+    Digest() = default;
+    Digest(ChecksumAlgorithm algorithm, size_t size, bool tree = false)
+        : algorithm(algorithm), tree(tree), size(static_cast<uint8_t>(size)) {}
+
+    bool empty() const { return size == 0; }
+    const uint8_t* data() const { return bytes.data(); }
+    uint8_t* data() { return bytes.data(); }
+
+    // "sha256", "blake3-tree" и т.п. — то же имя, что хранится в checksum_algorithm
+    std::string algorithmName() const;
+    std::string toHex() const;
+
+    static Digest fromBytes(const std::string& algorithmName, const void* data, size_t size);
+    static Digest fromHex(const std::string& algorithmName, const std::string& hex);
+
+    bool operator==(const Digest& other) const {
+        return algorithm == other.algorithm && tree == other.tree && size == other.size &&
+               std::memcmp(bytes.data(), other.bytes.data(), size) == 0;
+    }
+    bool operator!=(const Digest& other) const { return !(*this == other); }
+};
+
+// Разбирает имя вида "<алгоритм>[-tree]"
+void parseDigestAlgorithmName(const std::string& name, ChecksumAlgorithm& algorithm, bool& tree);
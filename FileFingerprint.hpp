@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+
+// Слепок метаданных файла на момент вычисления контрольной суммы.
+// Совпадение слепка позволяет не перечитывать файл при запуске.
+struct FileFingerprint {
+    // Файл, изменённый менее чем kRacyWindow назад, может измениться ещё раз с той же
+    // меткой времени (грубая точность mtime на ряде ФС) — такой слепок не сохраняется.
+    static constexpr int64_t kRacyWindowNs = 2'000'000'000;
+
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;
+    int64_t ctimeNs = 0;
+
+    bool empty() const {
+        return inode == 0 && mtimeNs == 0 && ctimeNs == 0;
+    }
+
+    static FileFingerprint capture(const std::filesystem::path& filePath) {
+        struct stat info {};
+        if (stat(filePath.c_str(), &info) != 0) {
+            throw std::runtime_error("Не удалось получить атрибуты файла " + filePath.string() + ": " + std::strerror(errno));
+        }
+        FileFingerprint fingerprint;
+        fingerprint.device = static_cast<uint64_t>(info.st_dev);
+        fingerprint.inode = static_cast<uint64_t>(info.st_ino);
+        fingerprint.size = static_cast<uint64_t>(info.st_size);
+        fingerprint.mtimeNs = static_cast<int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec;
+        fingerprint.ctimeNs = static_cast<int64_t>(info.st_ctim.tv_sec) * 1'000'000'000 + info.st_ctim.tv_nsec;
+        return fingerprint;
+    }
+
+    // Слепок, пригодный для сохранения: пустой, если файл изменён слишком недавно
+    FileFingerprint cacheable() const {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        if (now - mtimeNs < kRacyWindowNs || now - ctimeNs < kRacyWindowNs) {
+            return FileFingerprint{};
+        }
+        return *this;
+    }
+
+    bool operator==(const FileFingerprint& other) const {
+        return !empty() && device == other.device && inode == other.inode && size == other.size &&
+               mtimeNs == other.mtimeNs && ctimeNs == other.ctimeNs;
+    }
+    bool operator!=(const FileFingerprint& other) const { return !(*this == other); }
+};
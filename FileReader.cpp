@@ -0,0 +1,210 @@
+// FileReader.cpp
+#include "FileReader.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csetjmp>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct FileDescriptor {
+    int fd;
+    explicit FileDescriptor(int fd) : fd(fd) {}
+    ~FileDescriptor() { if (fd >= 0) close(fd); }
+};
+
+struct Mapping {
+    void* address;
+    size_t length;
+    ~Mapping() { munmap(address, length); }
+};
+
+// Выровненный буфер, один на поток: без аллокаций на каждый файл.
+// Sink не должен вызывать FileReader повторно в том же потоке.
+unsigned char* threadBuffer() {
+    struct AlignedBuffer {
+        unsigned char* data = nullptr;
+        AlignedBuffer() {
+            void* memory = nullptr;
+            if (posix_memalign(&memory, 4096, FileReader::kBufferSize) != 0) {
+                throw std::bad_alloc();
+            }
+            data = static_cast<unsigned char*>(memory);
+        }
+        ~AlignedBuffer() { free(data); }
+    };
+    thread_local AlignedBuffer buffer;
+    return buffer.data;
+}
+
+std::runtime_error readError(const std::filesystem::path& filePath) {
+    return std::runtime_error("Ошибка чтения файла " + filePath.string() + ": " + std::strerror(errno));
+}
+
+uint64_t readBuffered(int fd, uint64_t offset, const std::filesystem::path& filePath, const FileReader::Sink& sink) {
+    unsigned char* buffer = threadBuffer();
+    uint64_t start = offset;
+    while (true) {
+        ssize_t count = pread(fd, buffer, FileReader::kBufferSize, static_cast<off_t>(offset));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw readError(filePath);
+        }
+        if (count == 0) break;
+        sink(buffer, static_cast<size_t>(count));
+        offset += static_cast<uint64_t>(count);
+    }
+    return offset - start;
+}
+
+uint64_t readSingle(int fd, uint64_t fileSize, const std::filesystem::path& filePath, const FileReader::Sink& sink) {
+    unsigned char* buffer = threadBuffer();
+    // Запрашиваем на байт больше размера: короткий результат означает EOF без второго вызова
+    size_t request = static_cast<size_t>(std::min<uint64_t>(fileSize + 1, FileReader::kBufferSize));
+    ssize_t count;
+    do {
+        count = read(fd, buffer, request);
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+        throw readError(filePath);
+    }
+    if (count > 0) {
+        sink(buffer, static_cast<size_t>(count));
+    }
+    if (static_cast<size_t>(count) < request) {
+        return static_cast<uint64_t>(count);
+    }
+    // Файл вырос после fstat — дочитываем обычным способом
+    return static_cast<uint64_t>(count) + readBuffered(fd, static_cast<uint64_t>(count), filePath, sink);
+}
+
+// Усечение файла во время чтения через mmap даёт SIGBUS при любом обращении к отображению,
+// в том числе из sink. Поэтому отображение читается только здесь: окно копируется в буфер
+// под защитой sigsetjmp (в этом кадре нет объектов C++ с деструкторами), а sink получает копию.
+thread_local sigjmp_buf* volatile guardJump = nullptr;
+
+void onSigbus(int signal, siginfo_t*, void*) {
+    if (guardJump) {
+        siglongjmp(*guardJump, 1);
+    }
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+void installSigbusHandler() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        struct sigaction action {};
+        action.sa_sigaction = onSigbus;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, nullptr);
+    });
+}
+
+bool copyGuarded(unsigned char* target, const unsigned char* source, size_t length) {
+    sigjmp_buf jump;
+    if (sigsetjmp(jump, 1) != 0) {
+        guardJump = nullptr;
+        return false;
+    }
+    guardJump = &jump;
+    std::memcpy(target, source, length);
+    guardJump = nullptr;
+    return true;
+}
+
+uint64_t readMapped(int fd, uint64_t fileSize, const std::filesystem::path& filePath, const FileReader::Sink& sink) {
+    void* address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+        return readBuffered(fd, 0, filePath, sink);
+    }
+    Mapping mapping{address, static_cast<size_t>(fileSize)};
+    madvise(address, mapping.length, MADV_SEQUENTIAL);
+    installSigbusHandler();
+
+    const unsigned char* data = static_cast<const unsigned char*>(address);
+    unsigned char* buffer = threadBuffer();
+    for (size_t offset = 0; offset < mapping.length; offset += FileReader::kBufferSize) {
+        size_t length = std::min(FileReader::kBufferSize, mapping.length - offset);
+        if (!copyGuarded(buffer, data + offset, length)) {
+            throw std::runtime_error("Файл был усечён во время чтения: " + filePath.string());
+        }
+        sink(buffer, length);
+    }
+    return fileSize;
+}
+
+} // namespace
+
+ReadStrategy FileReader::choose(uint64_t fileSize) {
+    if (fileSize < kSingleReadLimit) return ReadStrategy::SingleRead;
+    if (fileSize < kMmapThreshold) return ReadStrategy::Pread;
+    return ReadStrategy::Mmap;
+}
+
+uint64_t FileReader::read(const std::filesystem::path& filePath, const Sink& sink, ReadStrategy strategy) {
+    FileDescriptor file(open(filePath.c_str(), O_RDONLY | O_CLOEXEC));
+    if (file.fd < 0) {
+        throw std::runtime_error("Не удалось открыть файл " + filePath.string() + ": " + std::strerror(errno));
+    }
+
+    struct stat info {};
+    if (fstat(file.fd, &info) != 0) {
+        throw readError(filePath);
+    }
+    uint64_t fileSize = static_cast<uint64_t>(info.st_size);
+
+    if (strategy == ReadStrategy::Auto) {
+        strategy = choose(fileSize);
+    }
+
+    switch (strategy) {
+        case ReadStrategy::SingleRead:
+            if (fileSize < kBufferSize) {
+                return readSingle(file.fd, fileSize, filePath, sink);
+            }
+            break;
+        case ReadStrategy::Mmap:
+            if (fileSize > 0) {
+                return readMapped(file.fd, fileSize, filePath, sink);
+            }
+            break;
+        default:
+            break;
+    }
+
+    posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return readBuffered(file.fd, 0, filePath, sink);
+}
+
+void FileReader::readRange(const std::filesystem::path& filePath, uint64_t offset, uint64_t length, const Sink& sink) {
+    FileDescriptor file(open(filePath.c_str(), O_RDONLY | O_CLOEXEC));
+    if (file.fd < 0) {
+        throw std::runtime_error("Не удалось открыть файл " + filePath.string() + ": " + std::strerror(errno));
+    }
+
+    unsigned char* buffer = threadBuffer();
+    while (length > 0) {
+        size_t request = static_cast<size_t>(std::min<uint64_t>(length, kBufferSize));
+        ssize_t count = pread(file.fd, buffer, request, static_cast<off_t>(offset));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw readError(filePath);
+        }
+        if (count == 0) {
+            throw std::runtime_error("Файл был усечён во время чтения: " + filePath.string());
+        }
+        sink(buffer, static_cast<size_t>(count));
+        offset += static_cast<uint64_t>(count);
+        length -= static_cast<uint64_t>(count);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+
+// Способ чтения файла; Auto выбирает его по размеру файла.
+enum class ReadStrategy {
+    Auto,
+    SingleRead, // один read() в буфер потока — для маленьких файлов
+    Pread,      // выровненный буфер и последовательные pread() — для средних
+    Mmap        // mmap + MADV_SEQUENTIAL — для больших; окна копируются в буфер потока
+};
+
+class FileReader {
+public:
+    using Sink = std::function<void(const unsigned char* data, size_t size)>;
+
+    static constexpr uint64_t kSingleReadLimit = 256 * 1024;
+    static constexpr uint64_t kMmapThreshold = 64ull * 1024 * 1024;
+    static constexpr size_t kBufferSize = 1024 * 1024;
+
+    static ReadStrategy choose(uint64_t fileSize);
+
+    // Передаёт содержимое файла в sink последовательными блоками, возвращает число прочитанных байт.
+    static uint64_t read(const std::filesystem::path& filePath, const Sink& sink,
+                         ReadStrategy strategy = ReadStrategy::Auto);
+
+    // Читает ровно length байт начиная с offset; бросает исключение, если файл короче.
+    static void readRange(const std::filesystem::path& filePath, uint64_t offset, uint64_t length, const Sink& sink);
+};
@@ -0,0 +1,394 @@
+// GarbageCollector.cpp
+#include "GarbageCollector.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+namespace {
+
+constexpr auto kBatchPause = std::chrono::milliseconds(50);
+constexpr uint32_t kVacuumPages = 1024;       // страниц базы за один incremental_vacuum
+
+int64_t secondsOf(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+
+// Оставляет в каждом из limit последних интервалов (по bucketOf) самую новую версию.
+// rows упорядочены по времени
+template <typename BucketOf>
+void keepPerBucket(const std::vector<const StoredChange*>& rows, uint32_t limit, BucketOf bucketOf,
+                   std::vector<bool>& keep) {
+    int64_t last = std::numeric_limits<int64_t>::min();
+    uint32_t taken = 0;
+    for (size_t i = rows.size(); i-- > 0 && limit > 0;) {
+        int64_t bucket = bucketOf(secondsOf(rows[i]->timestamp));
+        if (bucket == last) {
+            continue;
+        }
+        last = bucket;
+        if (taken == limit) {
+            break;
+        }
+        keep[i] = true;
+        ++taken;
+    }
+}
+
+// Какие записи истории одного файла остаются по правилам keep_* и max_age
+std::vector<bool> retainedRows(const std::vector<const StoredChange*>& rows, const RetentionConfig& retention,
+                               std::chrono::system_clock::time_point now) {
+    std::vector<bool> keep(rows.size(), !retention.keepRules());
+    for (size_t i = 0; i < retention.keepLast && i < rows.size(); ++i) {
+        keep[rows.size() - 1 - i] = true;
+    }
+    keepPerBucket(rows, retention.keepHourly, [](int64_t seconds) { return seconds / 3600; }, keep);
+    keepPerBucket(rows, retention.keepDaily, [](int64_t seconds) { return seconds / 86400; }, keep);
+    // 1 января 1970 года — четверг: сдвиг на три дня начинает недели с понедельника
+    keepPerBucket(rows, retention.keepWeekly, [](int64_t seconds) { return (seconds / 86400 + 3) / 7; }, keep);
+    if (retention.maxAgeDays > 0) {
+        auto cutoff = now - std::chrono::hours(24) * retention.maxAgeDays;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i]->timestamp < cutoff) {
+                keep[i] = false;
+            }
+        }
+    }
+    if (!keep.empty()) {
+        keep.back() = true;
+    }
+    return keep;
+}
+
+} // namespace
+
+GarbageCollector::GarbageCollector(VaultService& vault, std::string dbPath)
+    : vault(vault), dbPath(std::move(dbPath)) {
+    worker = std::thread([this]() { run(); });
+}
+
+GarbageCollector::~GarbageCollector() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void GarbageCollector::configure(const std::vector<MonitoringGroup>& newGroups, const GcConfig& newConfig) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        groups = newGroups;
+        config = newConfig;
+        configured = true;
+    }
+    wake.notify_all();
+}
+
+void GarbageCollector::pause() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++pauses;
+    }
+    wake.notify_all();
+}
+
+void GarbageCollector::resume() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --pauses;
+    }
+    wake.notify_all();
+}
+
+bool GarbageCollector::interrupted() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stopping || pauses > 0;
+}
+
+bool GarbageCollector::throttle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait_for(lock, kBatchPause, [this]() { return stopping || pauses > 0; });
+    return !stopping && pauses == 0;
+}
+
+void GarbageCollector::run() {
+    lowerThreadPriority();
+    std::unique_ptr<StatePersistenceService> db;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait(lock, [this]() { return stopping || (configured && config.enabled && pauses == 0); });
+        if (stopping) {
+            break;
+        }
+        // Первый проход — через интервал после запуска или после первичного обхода
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(config.intervalMinutes);
+        if (wake.wait_until(lock, deadline, [this]() { return stopping || pauses > 0; })) {
+            continue;
+        }
+        if (!config.enabled) {
+            continue;
+        }
+        cycleGroups = groups;
+        cycleConfig = config;
+        lock.unlock();
+
+        auto started = std::chrono::steady_clock::now();
+        GcStats stats;
+        bool completed = false;
+        vault.beginCollection();
+        try {
+            if (!db) {
+                db = std::make_unique<StatePersistenceService>(dbPath);
+            }
+            completed = collect(*db, stats);
+        } catch (const std::exception& e) {
+            std::cerr << "  ⚠ Ошибка сборки мусора: " << e.what() << std::endl;
+        }
+        vault.endCollection();
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        if (stats.changes || stats.versions || stats.chunks || stats.demoted || stats.freedPages || !completed) {
+            std::cout << "🧹 Сборка мусора" << (completed ? "" : " (прервана)") << ": записей истории "
+                      << stats.changes << ", версий " << stats.versions << ", фрагментов " << stats.chunks
+                      << ", освобождено " << std::fixed << std::setprecision(1)
+                      << stats.freedBytes / (1024.0 * 1024.0) << " МБ, в холодный слой " << stats.demoted
+                      << " версий (" << stats.demotedBytes / (1024.0 * 1024.0) << " МБ), страниц базы "
+                      << stats.freedPages << " за " << stats.seconds << " с" << std::defaultfloat << std::endl;
+        }
+        lock.lock();
+    }
+}
+
+bool GarbageCollector::collect(StatePersistenceService& db, GcStats& stats) {
+    if (!applyRetention(db, stats)) {
+        return false;
+    }
+    // Ссылки читаются после beginCollection: всё сохранённое позже защищено отметками
+    std::unordered_set<std::string> referenced = db.referencedVersions();
+    if (interrupted() || !sweep(referenced, stats)) {
+        return false;
+    }
+    if (interrupted() || !demote(db, stats)) {
+        return false;
+    }
+    while (uint64_t pages = db.compact(kVacuumPages)) {
+        stats.freedPages += pages;
+        if (!throttle()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GarbageCollector::applyRetention(StatePersistenceService& db, GcStats& stats) {
+    std::unordered_map<std::string, const RetentionConfig*> rules;
+    for (const auto& group : cycleGroups) {
+        if (group.retention.enabled()) {
+            rules[group.id] = &group.retention;
+        }
+    }
+    if (rules.empty()) {
+        return true;
+    }
+
+    std::vector<StoredChange> changes = db.loadChangesForRetention();
+    auto now = std::chrono::system_clock::now();
+    std::vector<int64_t> expired;
+    // Оставшиеся записи групп с max_bytes; newest — последняя запись файла, она не удаляется
+    struct Kept {
+        const StoredChange* change;
+        bool newest;
+    };
+    std::unordered_map<std::string, std::vector<Kept>> keptByGroup;
+
+    std::vector<const StoredChange*> rows;
+    for (size_t begin = 0, end = 0; begin < changes.size(); begin = end) {
+        while (end < changes.size() && changes[end].fileId == changes[begin].fileId) {
+            ++end;
+        }
+        auto rule = rules.find(changes[begin].groupId);
+        if (rule == rules.end()) {
+            continue;
+        }
+        rows.clear();
+        for (size_t i = begin; i < end; ++i) {
+            rows.push_back(&changes[i]);
+        }
+        std::vector<bool> keep = retainedRows(rows, *rule->second, now);
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (!keep[i]) {
+                expired.push_back(rows[i]->id);
+            } else if (rule->second->maxBytes > 0) {
+                keptByGroup[rows[i]->groupId].push_back({rows[i], i + 1 == rows.size()});
+            }
+        }
+    }
+
+    // max_bytes: самые старые записи уходят, пока версии группы не поместятся. Размер версии
+    // считается один раз, сколько бы записей на неё ни ссылалось
+    for (auto& [groupId, kept] : keptByGroup) {
+        uint64_t limit = rules.at(groupId)->maxBytes;
+        std::unordered_map<std::string, std::pair<uint64_t, size_t>> versions; // размер, записей
+        uint64_t total = 0;
+        for (const auto& row : kept) {
+            auto [it, inserted] = versions.try_emplace(row.change->versionId, 0, 0);
+            if (inserted) {
+                it->second.first = vault.storedSize(row.change->versionId);
+                total += it->second.first;
+            }
+            ++it->second.second;
+        }
+        std::sort(kept.begin(), kept.end(), [](const Kept& left, const Kept& right) {
+            return left.change->timestamp < right.change->timestamp;
+        });
+        for (const auto& row : kept) {
+            if (total <= limit) {
+                break;
+            }
+            if (row.newest) {
+                continue;
+            }
+            expired.push_back(row.change->id);
+            auto& version = versions.at(row.change->versionId);
+            if (--version.second == 0) {
+                total -= version.first;
+            }
+        }
+    }
+
+    size_t batch = cycleConfig.batchSize;
+    for (size_t i = 0; i < expired.size(); i += batch) {
+        std::vector<int64_t> ids(expired.begin() + i, expired.begin() + std::min(expired.size(), i + batch));
+        db.deleteFileChanges(ids);
+        stats.changes += ids.size();
+        if (!throttle()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GarbageCollector::sweep(const std::unordered_set<std::string>& referenced, GcStats& stats) {
+    size_t batch = cycleConfig.batchSize;
+    size_t steps = 0;
+    auto step = [&]() { return ++steps % batch != 0 || throttle(); };
+
+    // Пометка: версии из истории, их базы дельт и фрагменты манифестов
+    std::unordered_set<std::string> liveVersions;
+    std::unordered_set<std::string> liveChunks;
+    if (!vault.mark(referenced, liveVersions, liveChunks, step)) {
+        return false;
+    }
+
+    // Удаление: сначала версии с более длинной цепочкой дельт — база удаляется после зависимых.
+    // Версию, которую демон тем временем сохранил (removeVersion вернул false), и её ссылки оставляем
+    struct Candidate {
+        std::string versionId;
+        VaultReferences references;
+    };
+    std::vector<Candidate> candidates;
+    for (auto& versionId : vault.listVersions()) {
+        if (liveVersions.count(versionId)) {
+            continue;
+        }
+        try {
+            VaultReferences references = vault.references(versionId);
+            candidates.push_back({std::move(versionId), std::move(references)});
+        } catch (const std::exception& e) {
+            // Неизвестно, на что ссылается повреждённая версия, — не трогаем ни её, ни остальное
+            std::cerr << "  ⚠ Сборка мусора: " << e.what() << std::endl;
+            return false;
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& left, const Candidate& right) {
+        return left.references.depth > right.references.depth;
+    });
+    for (const auto& candidate : candidates) {
+        if (!liveVersions.count(candidate.versionId) && vault.removeVersion(candidate.versionId, stats.freedBytes)) {
+            ++stats.versions;
+        } else {
+            if (!candidate.references.base.empty()) {
+                liveVersions.insert(candidate.references.base);
+            }
+            liveChunks.insert(candidate.references.chunks.begin(), candidate.references.chunks.end());
+        }
+        if (!step()) {
+            return false;
+        }
+    }
+
+    for (const auto& chunkId : vault.listChunks()) {
+        if (!liveChunks.count(chunkId) && vault.removeChunk(chunkId, stats.freedBytes)) {
+            ++stats.chunks;
+            if (!step()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool GarbageCollector::demote(StatePersistenceService& db, GcStats& stats) {
+    std::unordered_map<std::string, const VaultConfig*> tiered;
+    for (const auto& group : cycleGroups) {
+        if (group.vault.hotVersions > 0) {
+            tiered[group.id] = &group.vault;
+        }
+    }
+    if (tiered.empty()) {
+        return true;
+    }
+
+    // Версия остаётся в горячем слое, если она среди последних hotVersions версий хотя бы одного
+    // файла или на неё ссылается группа без холодного слоя
+    std::vector<StoredChange> changes = db.loadChangesForRetention();
+    std::unordered_set<std::string> hot;
+    std::unordered_map<std::string, const VaultConfig*> cold;   // версия → настройки её группы
+    std::unordered_set<std::string> latest;
+    for (size_t begin = 0, end = 0; begin < changes.size(); begin = end) {
+        while (end < changes.size() && changes[end].fileId == changes[begin].fileId) {
+            ++end;
+        }
+        auto rule = tiered.find(changes[begin].groupId);
+        latest.clear();
+        for (size_t i = end; i-- > begin;) {
+            const std::string& versionId = changes[i].versionId;
+            if (versionId.empty()) {
+                continue;
+            }
+            if (rule == tiered.end() || latest.size() < rule->second->hotVersions || latest.count(versionId)) {
+                latest.insert(versionId);
+                hot.insert(versionId);
+            } else {
+                cold.emplace(versionId, rule->second);
+            }
+        }
+    }
+
+    size_t batch = cycleConfig.batchSize;
+    size_t steps = 0;
+    for (const auto& [versionId, vaultConfig] : cold) {
+        if (hot.count(versionId)) {
+            continue;
+        }
+        try {
+            if (vault.demote(versionId, parseVaultCompression(vaultConfig->coldCompression),
+                             vaultConfig->compressionLevel, stats.demotedBytes)) {
+                ++stats.demoted;
+            }
+        } catch (const std::exception& e) {
+            // Горячая копия остаётся; следующий проход попробует снова
+            std::cerr << "  ⚠ Перенос в холодный слой: " << e.what() << std::endl;
+        }
+        if (++steps % batch == 0 && !throttle()) {
+            return false;
+        }
+    }
+    return true;
+}
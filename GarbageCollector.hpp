@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "ConfigLoader.hpp"
+#include "StatePersistenceService.hpp"
+#include "VaultService.hpp"
+
+// Итог прохода сборки мусора
+struct GcStats {
+    uint64_t changes = 0;         // удалено записей истории
+    uint64_t versions = 0;        // удалено версий из хранилища
+    uint64_t chunks = 0;          // удалено фрагментов
+    uint64_t freedBytes = 0;
+    uint64_t demoted = 0;         // версий перенесено в холодный слой
+    uint64_t demotedBytes = 0;    // освобождено ими в горячем слое
+    uint64_t freedPages = 0;      // страниц базы возвращено файловой системе
+    double seconds = 0;
+};
+
+// Фоновая сборка мусора. Раз в GcConfig::intervalMinutes:
+//   1. прореживает file_changes по правилам хранения групп (RetentionConfig);
+//   2. помечает версии, на которые остались ссылки, с их базами дельт и фрагментами;
+//   3. удаляет из хранилища непомеченные версии и фрагменты (сначала зависимые версии,
+//      затем их базы, фрагменты последними);
+//   4. переносит в холодный слой версии групп с VaultConfig::hotVersions, не входящие
+//      в последние hotVersions версий ни одного файла (VaultService::demote);
+//   5. возвращает освободившиеся страницы базы (incremental_vacuum).
+// Поток работает с наименьшим приоритетом CPU и ввода-вывода и пишет в базу через своё
+// соединение короткими транзакциями по GcConfig::batchSize записей, между пакетами — пауза.
+// Версии, которые демон тем временем сохраняет, защищает RecentObjects.
+// pause прерывает текущий проход и откладывает следующий до resume (первичный обход).
+class GarbageCollector {
+public:
+    GarbageCollector(VaultService& vault, std::string dbPath);
+    ~GarbageCollector();
+
+    GarbageCollector(const GarbageCollector&) = delete;
+    GarbageCollector& operator=(const GarbageCollector&) = delete;
+
+    // Новые группы и параметры; действуют со следующего прохода
+    void configure(const std::vector<MonitoringGroup>& groups, const GcConfig& config);
+    void pause();
+    void resume();
+
+private:
+    void run();
+    // false — проход прерван
+    bool collect(StatePersistenceService& db, GcStats& stats);
+    bool applyRetention(StatePersistenceService& db, GcStats& stats);
+    bool sweep(const std::unordered_set<std::string>& referenced, GcStats& stats);
+    bool demote(StatePersistenceService& db, GcStats& stats);
+    // Пауза между пакетами; false — пора остановиться
+    bool throttle();
+    bool interrupted();
+
+    VaultService& vault;
+    std::string dbPath;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<MonitoringGroup> groups;
+    GcConfig config;
+    bool configured = false;
+    int pauses = 0;
+    bool stopping = false;
+    // Снимок настроек на время прохода (только поток сборки)
+    std::vector<MonitoringGroup> cycleGroups;
+    GcConfig cycleConfig;
+    std::thread worker;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Промежуточное состояние потокового хеша файла (до вызова final).
+// Если файл только дописывался, хеширование продолжается с offset вместо чтения с начала.
+struct HashMidstate {
+    // Размер начального и конечного окон префикса, по которым проверяется, что он не менялся
+    static constexpr uint64_t kAnchorWindow = 64 * 1024;
+
+    std::vector<uint8_t> context; // байт алгоритма + копия контекста политики; пусто — состояния нет
+    uint64_t offset = 0;          // сколько байт файла уже поглощено контекстом
+    uint64_t anchor = 0;          // xxh3 окон префикса [0, offset)
+
+    bool empty() const {
+        return context.empty();
+    }
+};
@@ -5,19 +5,41 @@
 InitializationService::InitializationService(VaultService& vault, ChecksumService& checksum)
     : vault(vault), checksum(checksum) {}
 
-TrackingFile InitializationService::initialize(const std::string& filePath) {
+TrackingFile InitializationService::initialize(const std::string& filePath, const MonitoringGroup& group,
+                                               const ScanResult* prehashed) {
+    const ChecksumConfig& checksumConfig = group.checksum;
     if (!std::filesystem::exists(filePath)) {
         throw std::runtime_error("Файл не найден: " + filePath);
     }
 
-    // Создание версии и вычисление контрольной суммы
-    std::string checksumValue = checksum.compute(filePath);
-    std::string versionId = vault.save(filePath);
+    // Создание версии и вычисление контрольной суммы; слепок снимается до чтения,
+    // чтобы изменение во время хеширования не осталось незамеченным
+    FileFingerprint fingerprint;
+    HashMidstate midstate;
+    Digest checksumValue;
+    std::string versionId;
+    if (prehashed) {
+        fingerprint = prehashed->fingerprint;
+        checksumValue = prehashed->digest;
+        versionId = vault.save(filePath, checksumValue, group.vault, std::string(), fingerprint);
+    } else {
+        fingerprint = FileFingerprint::capture(filePath);
+        ChecksumRequest request;
+        request.algorithmName = ChecksumService::algorithmFor(checksumConfig, fingerprint.size);
+        request.size = fingerprint.size;
+        request.appending = checksumConfig.appendOnly;
+        SavedVersion saved = saveWithChecksum(filePath, std::move(request), group.vault);
+        checksumValue = saved.checksum;
+        midstate = std::move(saved.midstate);
+        versionId = saved.versionId;
+    }
 
     // Создание и возвращение TrackingFile
     TrackingFile file;
     file.filePath = filePath;
     file.lastChecksum = checksumValue;
+    file.fingerprint = fingerprint.cacheable();
+    file.midstate = std::move(midstate);
 
     // Создаем FileChange для первого сохранения
     FileChange initialChange;
@@ -30,3 +52,52 @@ TrackingFile InitializationService::initialize(const std::string& filePath) {
 
     return file;
 }
+
+SavedVersion InitializationService::saveWithChecksum(const std::filesystem::path& filePath, ChecksumRequest request,
+                                                     const VaultConfig& vaultConfig) {
+    // Обычный SHA-256 по тем же блокам и есть адрес версии — второй раз его не считаем
+    ChecksumAlgorithm algorithm;
+    bool tree;
+    parseDigestAlgorithmName(request.algorithmName, algorithm, tree);
+    bool contentDigest = algorithm == ChecksumAlgorithm::Sha256 && !tree;
+
+    VaultSaveOptions options;
+    options.config = vaultConfig;
+    options.size = request.size;
+    if (options.size == 0) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(filePath, error);
+        options.size = error ? 0 : size;
+    }
+    options.hashContent = !contentDigest;
+    options.ordered = !tree;
+    std::unique_ptr<VaultWriter> writer = vault.beginSave(options);
+    request.path = filePath;
+
+    // Копия средствами ядра (reflink/copy_file_range) не проходит через буферы процесса,
+    // файл читается только для хеширования
+    VaultCopyMethod method = VaultCopyMethod::Userspace;
+    FileFingerprint before;
+    if (writer->canCopyDirectly()) {
+        before = FileFingerprint::capture(filePath);
+        method = writer->copyFrom(filePath);
+    }
+    if (method == VaultCopyMethod::Userspace) {
+        request.tee = [&writer](uint64_t offset, const unsigned char* data, size_t size) {
+            writer->write(offset, data, size);
+        };
+    }
+    ChecksumResult result = checksum.submit(std::move(request)).get();
+
+    // Сумма описывает копию, если файл не менялся между копированием и хешированием
+    bool trusted = contentDigest;
+    if (method != VaultCopyMethod::Userspace) {
+        trusted = trusted && FileFingerprint::capture(filePath) == before && !before.cacheable().empty();
+    }
+    SavedVersion saved;
+    saved.versionId = writer->commit(filePath, trusted ? result.digest : Digest());
+    vault.recordCopy(method, options.size);
+    saved.checksum = result.digest;
+    saved.midstate = std::move(result.midstate);
+    return saved;
+}
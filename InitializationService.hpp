@@ -3,13 +3,32 @@
 #include "VaultService.hpp"
 #include "ChecksumService.hpp"
 #include "TrackingFile.hpp"
+#include "ConfigLoader.hpp"
+#include "ScanEngine.hpp"
 #include <string>
 
+struct SavedVersion {
+    std::string versionId;
+    Digest checksum;
+    HashMidstate midstate; // для request.appending
+};
+
 class InitializationService {
 public:
+    // Новые файлы меньше порога хешируются пакетно при обходе и копируются отдельно:
+    // повторное чтение маленького файла попадает в страничный кэш
+    static constexpr uint64_t kFusedSaveMinSize = 1024 * 1024;
+
     InitializationService(VaultService& vault, ChecksumService& checksum);
 
-    TrackingFile initialize(const std::string& filePath);
+    // prehashed — результат пакетного хеширования при первичном обходе (файл повторно не читается)
+    TrackingFile initialize(const std::string& filePath, const MonitoringGroup& group,
+                            const ScanResult* prehashed = nullptr);
+
+    // Сохраняет версию файла в хранилище и считает его сумму за одно чтение:
+    // блоки, прочитанные для хеширования, сразу записываются в копию
+    SavedVersion saveWithChecksum(const std::filesystem::path& filePath, ChecksumRequest request,
+                                  const VaultConfig& vaultConfig);
 
 private:
     VaultService& vault;
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
+#include <poll.h>
 #include <unistd.h>
 #include <thread>
+#include <chrono>
 #include <unordered_map>
 #include <atomic>
 #include <functional>
+#include <mutex>
+#include <vector>
 #include <stdexcept>
 #include <string>
 #include <iostream>
@@ -17,12 +22,18 @@ public:
         if (inotifyFd < 0) {
             throw std::runtime_error("Не удалось инициализировать inotify");
         }
+        wakeFd = eventfd(0, EFD_NONBLOCK);
+        if (wakeFd < 0) {
+            close(inotifyFd);
+            throw std::runtime_error("Не удалось создать eventfd для InotifyWatcher");
+        }
     }
 
     ~InotifyWatcher() {
         stop();
         clearWatches();
         close(inotifyFd);
+        close(wakeFd);
     }
 
     void addWatch(const std::string& path, std::function<void(uint32_t)> callback) {
@@ -43,16 +54,50 @@ public:
         wdToPath.clear();
     }
 
+    // Выполняет task в потоке наблюдения (между обработкой событий); можно вызывать из любого потока
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(postedMutex);
+            posted.push_back(std::move(task));
+        }
+        wake();
+    }
+
+    // Периодическая задача в потоке наблюдения; задаётся до start()
+    void setTimer(std::chrono::milliseconds period, std::function<void()> task) {
+        timerPeriod = period;
+        timerTask = std::move(task);
+    }
+
     void start() {
         running = true;
+        nextTimer = std::chrono::steady_clock::now() + timerPeriod;
         watchThread = std::thread([this]() {
             char buffer[4096]
                 __attribute__((aligned(__alignof__(struct inotify_event))));
+            pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
             while (running) {
+                if (poll(fds, 2, pollTimeout()) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    perror("poll");
+                    break;
+                }
+                runTimer();
+                if (fds[1].revents & POLLIN) {
+                    uint64_t counter;
+                    ssize_t ignored = read(wakeFd, &counter, sizeof(counter));
+                    (void)ignored;
+                    runPosted();
+                }
+                if (!(fds[0].revents & POLLIN)) {
+                    continue;
+                }
+
                 ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
                 if (length < 0) {
                     if (errno == EAGAIN) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
                         continue;
                     }
                     perror("read");
@@ -73,13 +118,53 @@ public:
 
     void stop() {
         running = false;
+        wake();
         if (watchThread.joinable()) {
             watchThread.join();
         }
     }
 
 private:
+    void wake() {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    int pollTimeout() const {
+        if (!timerTask) {
+            return -1;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(nextTimer - std::chrono::steady_clock::now());
+        return left.count() > 0 ? static_cast<int>(left.count()) : 0;
+    }
+
+    void runTimer() {
+        if (!timerTask || std::chrono::steady_clock::now() < nextTimer) {
+            return;
+        }
+        nextTimer = std::chrono::steady_clock::now() + timerPeriod;
+        timerTask();
+    }
+
+    void runPosted() {
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(postedMutex);
+            tasks.swap(posted);
+        }
+        for (auto& task : tasks) {
+            task();
+        }
+    }
+
     int inotifyFd;
+    int wakeFd;
+    std::mutex postedMutex;
+    std::vector<std::function<void()>> posted;
+    std::chrono::milliseconds timerPeriod{0};
+    std::chrono::steady_clock::time_point nextTimer;
+    std::function<void()> timerTask;
     std::atomic<bool> running;
     std::unordered_map<int, std::function<void(uint32_t)>> watchMap;
     std::unordered_map<int, std::string> wdToPath;
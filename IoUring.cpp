@@ -0,0 +1,154 @@
+// IoUring.cpp
+#include "IoUring.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+unsigned* field(void* base, uint32_t offset) {
+    return reinterpret_cast<unsigned*>(static_cast<char*>(base) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring(unsigned entries) {
+    io_uring_params params {};
+    ringFd = ioUringSetup(entries, &params);
+    if (ringFd < 0) {
+        throw std::runtime_error(std::string("io_uring недоступен: ") + std::strerror(errno));
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        close(ringFd);
+        throw std::runtime_error(std::string("Не удалось отобразить кольцо io_uring: ") + std::strerror(errno));
+    }
+    if (singleMmap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            munmap(sqRing, sqRingSize);
+            close(ringFd);
+            throw std::runtime_error(std::string("Не удалось отобразить кольцо io_uring: ") + std::strerror(errno));
+        }
+    }
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqesMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqesMemory == MAP_FAILED) {
+        if (!singleMmap) munmap(cqRing, cqRingSize);
+        munmap(sqRing, sqRingSize);
+        close(ringFd);
+        throw std::runtime_error(std::string("Не удалось отобразить очередь io_uring: ") + std::strerror(errno));
+    }
+    sqes = static_cast<io_uring_sqe*>(sqesMemory);
+
+    sqHead = field(sqRing, params.sq_off.head);
+    sqTail = field(sqRing, params.sq_off.tail);
+    sqMask = field(sqRing, params.sq_off.ring_mask);
+    sqArray = field(sqRing, params.sq_off.array);
+    sqEntries = params.sq_entries;
+    sqLocalTail = *sqTail;
+
+    cqHead = field(cqRing, params.cq_off.head);
+    cqTail = field(cqRing, params.cq_off.tail);
+    cqMask = field(cqRing, params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cqRing) + params.cq_off.cqes);
+    probe();
+}
+
+void IoUring::probe() {
+    constexpr unsigned kProbeOps = 256;
+    std::vector<unsigned char> memory(sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op));
+    auto* result = reinterpret_cast<io_uring_probe*>(memory.data());
+    if (ioUringRegister(ringFd, IORING_REGISTER_PROBE, result, kProbeOps) < 0) {
+        return;
+    }
+    for (unsigned i = 0; i < result->ops_len && i < kProbeOps; ++i) {
+        if (result->ops[i].flags & IO_URING_OP_SUPPORTED) {
+            supportedOps.set(result->ops[i].op);
+        }
+    }
+}
+
+IoUring::~IoUring() {
+    munmap(sqes, sqesSize);
+    if (cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    munmap(sqRing, sqRingSize);
+    close(ringFd);
+}
+
+io_uring_sqe* IoUring::acquire() {
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqLocalTail - head >= sqEntries) {
+        return nullptr;
+    }
+    unsigned index = sqLocalTail & *sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    ++sqLocalTail;
+    ++pendingSubmit;
+    return sqe;
+}
+
+void IoUring::submit(unsigned waitCount) {
+    // Ядро должно увидеть заполненные элементы раньше нового хвоста
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    if (pendingSubmit == 0 && waitCount == 0) {
+        return;
+    }
+
+    unsigned flags = waitCount > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (true) {
+        int submitted = ioUringEnter(ringFd, pendingSubmit, waitCount, flags);
+        if (submitted >= 0) {
+            pendingSubmit -= std::min<unsigned>(pendingSubmit, static_cast<unsigned>(submitted));
+            return;
+        }
+        if (errno != EINTR) {
+            throw std::runtime_error(std::string("Ошибка io_uring_enter: ") + std::strerror(errno));
+        }
+    }
+}
+
+bool IoUring::pop(io_uring_cqe& completion) {
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    completion = cqes[head & *cqMask];
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
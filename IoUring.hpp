@@ -0,0 +1,59 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+// Минимальная обёртка над io_uring через системные вызовы (без liburing).
+// Не потокобезопасна: кольцом пользуется один поток.
+class IoUring {
+public:
+    // Бросает std::runtime_error, если ядро не поддерживает io_uring или он запрещён
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Свободный элемент очереди отправки (обнулённый) или nullptr, если очередь заполнена
+    io_uring_sqe* acquire();
+
+    // Отправляет подготовленные элементы и ждёт хотя бы waitCount завершений
+    void submit(unsigned waitCount = 0);
+
+    // Забирает одно завершение, если оно есть
+    bool pop(io_uring_cqe& completion);
+
+    unsigned capacity() const { return sqEntries; }
+
+    // Ядро выполняет операцию opcode (по IORING_REGISTER_PROBE). Ядра до 5.6 запроса не знают —
+    // для них false по всем операциям
+    bool supports(uint8_t opcode) const { return supportedOps.test(opcode); }
+
+private:
+    void probe();
+
+    int ringFd = -1;
+    std::bitset<256> supportedOps;
+
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqEntries = 0;
+    unsigned sqLocalTail = 0;
+    unsigned pendingSubmit = 0;
+
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// Быстрый слепок содержимого: размер файла и xxh3 начального, среднего и конечного блоков.
+// Совпадение не доказывает, что файл не менялся, — только позволяет отложить полный хеш.
+struct QuickFingerprint {
+    static constexpr uint64_t kSampleSize = 64 * 1024;
+
+    uint64_t size = 0;
+    uint64_t sample = 0; // 0 — слепок не снят
+
+    bool empty() const {
+        return sample == 0;
+    }
+
+    bool operator==(const QuickFingerprint& other) const {
+        return !empty() && size == other.size && sample == other.sample;
+    }
+    bool operator!=(const QuickFingerprint& other) const { return !(*this == other); }
+};
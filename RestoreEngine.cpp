@@ -0,0 +1,213 @@
+// RestoreEngine.cpp
+#include "RestoreEngine.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <ctime>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kProgressStep = 256;   // файлов между вызовами progress
+
+// Путь в виде, пригодном для сравнения по компонентам
+std::filesystem::path normalPath(const std::filesystem::path& path) {
+    std::filesystem::path normal = std::filesystem::absolute(path).lexically_normal();
+    if (normal.filename().empty() && normal.has_parent_path() && normal != normal.root_path()) {
+        normal = normal.parent_path();   // "/a/b/" → "/a/b"
+    }
+    return normal;
+}
+
+bool within(const std::filesystem::path& path, const std::filesystem::path& subtree) {
+    auto mismatch = std::mismatch(subtree.begin(), subtree.end(), path.begin(), path.end());
+    return mismatch.first == subtree.end();
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+struct FileResult {
+    bool restored = false;
+    std::string error;
+    RestoreStats stats;
+};
+
+} // namespace
+
+size_t RestorePlan::count(RestoreAction action) const {
+    return static_cast<size_t>(std::count_if(items.begin(), items.end(),
+                                             [action](const RestoreItem& item) { return item.action == action; }));
+}
+
+RestoreEngine::RestoreEngine(const VaultService& vault, StatePersistenceService& db) : vault(vault), db(db) {}
+
+RestorePlan RestoreEngine::plan(const std::string& groupId, std::chrono::system_clock::time_point at,
+                                const std::filesystem::path& subtree) {
+    RestorePlan plan;
+    plan.groupId = groupId;
+    plan.at = at;
+    std::filesystem::path root = subtree.empty() ? std::filesystem::path() : normalPath(subtree);
+    for (auto& version : db.loadVersionsAt(groupId, at)) {
+        RestoreItem item;
+        item.path = version.filePath;
+        if (!root.empty() && !within(normalPath(item.path), root)) {
+            continue;
+        }
+        if (!version.found) {
+            item.action = RestoreAction::NotTracked;
+            plan.items.push_back(std::move(item));
+            continue;
+        }
+        item.versionId = version.change.savedVersionId;
+        item.timestamp = version.change.timestamp;
+        if (item.versionId.empty() || !vault.exists(item.versionId)) {
+            item.action = RestoreAction::NoVersion;
+        } else if (!version.isMissing && version.lastChecksum == version.change.checksum &&
+                   !version.fingerprint.empty()) {
+            // Сумма в базе верна, пока слепок файла тот же, что при её вычислении
+            try {
+                if (FileFingerprint::capture(item.path) == version.fingerprint) {
+                    item.action = RestoreAction::Unchanged;
+                }
+            } catch (const std::exception&) {
+                // Файла нет или он недоступен — восстанавливается
+            }
+        }
+        plan.items.push_back(std::move(item));
+    }
+    return plan;
+}
+
+RestoreReport RestoreEngine::run(const RestorePlan& plan, size_t threads, const Progress& progress) {
+    RestoreReport report;
+    auto started = std::chrono::steady_clock::now();
+
+    // Каталоги создаются заранее и по одному разу, а не из каждой задачи
+    std::vector<const RestoreItem*> items;
+    std::set<std::filesystem::path> directories;
+    for (const auto& item : plan.items) {
+        if (item.action == RestoreAction::Restore) {
+            items.push_back(&item);
+            directories.insert(item.path.parent_path());
+        }
+    }
+    for (const auto& directory : directories) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);   // ошибка проявится при восстановлении
+    }
+
+    std::vector<std::future<FileResult>> results;
+    results.reserve(items.size());
+    {
+        ThreadPool pool(threads);
+        for (const RestoreItem* item : items) {
+            results.push_back(pool.submit([this, item]() {
+                FileResult result;
+                try {
+                    result.restored = vault.restore(item->versionId, item->path, result.stats);
+                    if (!result.restored) {
+                        result.error = "версии " + item->versionId + " нет в хранилище";
+                    }
+                } catch (const std::exception& e) {
+                    result.error = e.what();
+                }
+                return result;
+            }));
+        }
+
+        std::vector<double> latencies;
+        latencies.reserve(items.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            FileResult result = results[i].get();
+            if (result.restored) {
+                ++report.restored;
+                report.bytes += result.stats.bytes;
+                ++report.methods[static_cast<size_t>(result.stats.method)];
+                latencies.push_back(result.stats.seconds * 1000);
+            } else {
+                ++report.failed;
+                std::cerr << "  ⚠ Не удалось восстановить " << items[i]->path.string() << ": " << result.error
+                          << std::endl;
+            }
+            if (progress && ((i + 1) % kProgressStep == 0 || i + 1 == results.size())) {
+                progress(i + 1, results.size());
+            }
+        }
+        std::sort(latencies.begin(), latencies.end());
+        report.p50Ms = percentile(latencies, 0.5);
+        report.p99Ms = percentile(latencies, 0.99);
+        report.maxMs = latencies.empty() ? 0 : latencies.back();
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
+
+std::chrono::system_clock::time_point RestoreEngine::parseTime(const std::string& text) {
+    if (text.size() > 2 && text[0] == '-') {
+        size_t digits = 0;
+        long long amount = 0;
+        try {
+            amount = std::stoll(text.substr(1), &digits);
+        } catch (const std::exception&) {
+            digits = 0;
+        }
+        if (digits > 0 && digits + 2 == text.size() && amount >= 0) {
+            static const std::string units = "smhd";
+            static const long long seconds[] = {1, 60, 3600, 86400};
+            size_t unit = units.find(text.back());
+            if (unit != std::string::npos) {
+                return std::chrono::system_clock::now() - std::chrono::seconds(amount * seconds[unit]);
+            }
+        }
+        throw std::invalid_argument("Неверный интервал: " + text + " (ожидается, например, -30m, -2h, -1d)");
+    }
+
+    std::string value = text;
+    bool utc = !value.empty() && (value.back() == 'Z' || value.back() == 'z');
+    if (utc) {
+        value.pop_back();
+    }
+    std::replace(value.begin(), value.end(), ' ', 'T');
+    for (const char* format : {"%Y-%m-%dT%H:%M:%S", "%Y-%m-%dT%H:%M"}) {
+        std::tm tm{};
+        std::istringstream input(value);
+        input >> std::get_time(&tm, format);
+        if (input.fail() || input.peek() != std::char_traits<char>::eof()) {
+            continue;
+        }
+        tm.tm_isdst = -1;
+        std::time_t time = utc ? timegm(&tm) : std::mktime(&tm);
+        if (time == static_cast<std::time_t>(-1)) {
+            break;
+        }
+        return std::chrono::system_clock::from_time_t(time);
+    }
+    throw std::invalid_argument("Неверное время: " + text + " (ожидается ГГГГ-ММ-ДДTЧЧ:ММ[:СС][Z])");
+}
+
+bool rollbackTo(const VaultService& vault, const TrackingFile& file, const FileChange& change) {
+    if (change.savedVersionId.empty()) {
+        return false;
+    }
+    RestoreStats stats;
+    return vault.restore(change.savedVersionId, file.filePath, stats);
+}
+
+bool rollbackToVersion(const VaultService& vault, const TrackingFile& file, const std::string& versionId) {
+    for (auto it = file.history.changes.rbegin(); it != file.history.changes.rend(); ++it) {
+        if (it->savedVersionId == versionId) {
+            return rollbackTo(vault, file, *it);
+        }
+    }
+    return false;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include "StatePersistenceService.hpp"
+#include "VaultService.hpp"
+
+enum class RestoreAction {
+    Restore,        // версия будет скопирована из хранилища поверх файла
+    Unchanged,      // файл уже в состоянии этой версии
+    NotTracked,     // к этому моменту у файла не было истории — файл не трогается
+    NoVersion       // запись истории есть, но версии нет в хранилище (удалена сборкой мусора)
+};
+
+struct RestoreItem {
+    std::filesystem::path path;
+    std::string versionId;
+    std::chrono::system_clock::time_point timestamp; // время записи истории, давшей версию
+    RestoreAction action = RestoreAction::Restore;
+};
+
+struct RestorePlan {
+    std::string groupId;
+    std::chrono::system_clock::time_point at;
+    std::vector<RestoreItem> items;   // по пути
+
+    size_t count(RestoreAction action) const;
+};
+
+// Итог восстановления по плану
+struct RestoreReport {
+    size_t restored = 0;
+    size_t failed = 0;
+    uint64_t bytes = 0;           // записано байт (с промежуточными версиями цепочек дельт)
+    double seconds = 0;
+    // Время восстановления одного файла
+    double p50Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+    size_t methods[4] = {};       // файлов по VaultCopyMethod
+};
+
+// Восстановление группы (или её поддерева) на момент времени. Для каждого файла группы из
+// file_changes берётся последняя запись не позже этого момента, и её версия копируется поверх
+// файла. Файлы восстанавливаются параллельно; версия, хранящаяся целиком, копируется средствами
+// ядра (reflink, copy_file_range, sendfile), остальные собираются потоково (VaultService::restore).
+// Файл, чьи сумма и слепок в базе совпадают с версией, не копируется. Файлы, появившиеся
+// позже момента восстановления, не удаляются.
+// С работающим демоном хранилище делить нельзя: его пакеты открыты на запись.
+class RestoreEngine {
+public:
+    static constexpr size_t kDefaultThreads = 8;
+    using Progress = std::function<void(size_t done, size_t total)>;
+
+    RestoreEngine(const VaultService& vault, StatePersistenceService& db);
+
+    // subtree — каталог или файл внутри группы; пусто — вся группа
+    RestorePlan plan(const std::string& groupId, std::chrono::system_clock::time_point at,
+                     const std::filesystem::path& subtree = std::filesystem::path());
+    RestoreReport run(const RestorePlan& plan, size_t threads = kDefaultThreads,
+                      const Progress& progress = Progress());
+
+    // Момент восстановления: "2024-05-01T12:00[:00]" (местное время), с суффиксом Z — UTC,
+    // или назад от текущего времени: "-30m", "-2h", "-1d", "-45s"
+    static std::chrono::system_clock::time_point parseTime(const std::string& text);
+
+private:
+    const VaultService& vault;
+    StatePersistenceService& db;
+};
@@ -0,0 +1,629 @@
+// ScanEngine.cpp
+#include "ScanEngine.hpp"
+#include "ChecksumService.hpp"
+#include "FileReader.hpp"
+#include "IoUring.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <thread>
+
+namespace {
+
+// Потоковый хешер с выбором политики во время выполнения: виртуальный вызов приходится на блок, а не на байт
+class StreamHasher {
+public:
+    virtual ~StreamHasher() = default;
+    virtual void update(const unsigned char* data, size_t size) = 0;
+    virtual Digest finish() = 0;
+};
+
+template <typename Algorithm>
+class PolicyHasher : public StreamHasher {
+public:
+    PolicyHasher() { Algorithm::init(context); }
+
+    void update(const unsigned char* data, size_t size) override {
+        Algorithm::update(context, data, size);
+    }
+
+    Digest finish() override {
+        Digest digest(Algorithm::algorithm, Algorithm::digestSize);
+        Algorithm::final(context, digest.data());
+        return digest;
+    }
+
+private:
+    typename Algorithm::Context context;
+};
+
+std::unique_ptr<StreamHasher> makeHasher(ChecksumAlgorithm algorithm) {
+    return visitChecksumAlgorithm(algorithm, [](auto policy) -> std::unique_ptr<StreamHasher> {
+        return std::make_unique<PolicyHasher<decltype(policy)>>();
+    });
+}
+
+// Ограниченный набор выровненных буферов: когда хешеры не успевают, поток ввода-вывода ждёт
+class BufferPool {
+public:
+    BufferPool(size_t count, size_t size) {
+        for (size_t i = 0; i < count; ++i) {
+            void* memory = nullptr;
+            if (posix_memalign(&memory, 4096, size) != 0) {
+                throw std::bad_alloc();
+            }
+            owned.emplace_back(static_cast<unsigned char*>(memory));
+            available.push_back(static_cast<unsigned char*>(memory));
+        }
+    }
+
+    unsigned char* acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return !available.empty(); });
+        unsigned char* buffer = available.back();
+        available.pop_back();
+        return buffer;
+    }
+
+    void release(unsigned char* buffer) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            available.push_back(buffer);
+        }
+        condition.notify_one();
+    }
+
+private:
+    struct FreeDeleter {
+        void operator()(unsigned char* buffer) const { free(buffer); }
+    };
+
+    std::vector<std::unique_ptr<unsigned char, FreeDeleter>> owned;
+    std::vector<unsigned char*> available;
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+FileFingerprint fingerprintFrom(const struct statx& info) {
+    FileFingerprint fingerprint;
+    fingerprint.device = static_cast<uint64_t>(makedev(info.stx_dev_major, info.stx_dev_minor));
+    fingerprint.inode = info.stx_ino;
+    fingerprint.size = info.stx_size;
+    fingerprint.mtimeNs = static_cast<int64_t>(info.stx_mtime.tv_sec) * 1'000'000'000 + info.stx_mtime.tv_nsec;
+    fingerprint.ctimeNs = static_cast<int64_t>(info.stx_ctime.tv_sec) * 1'000'000'000 + info.stx_ctime.tv_nsec;
+    return fingerprint;
+}
+
+// Файл в работе: одна операция в кольце и очередь прочитанных блоков на хеширование
+struct FileJob {
+    enum class Stage { Open, Statx, Read, Close };
+
+    Stage stage = Stage::Open;
+    int fd = -1;
+    uint64_t offset = 0;
+    struct statx info {};
+    unsigned char* buffer = nullptr;
+    std::unique_ptr<StreamHasher> hasher;
+    bool finalQueued = false;
+
+    // Маленький файл SHA-256 читается целиком и хешируется пакетом вместе с другими
+    bool batched = false;
+    std::vector<unsigned char> content;
+
+    // Блоки одного файла хешируются строго по порядку: очередь разбирает не более одной задачи пула
+    std::mutex mutex;
+    std::deque<std::pair<unsigned char*, size_t>> chunks; // nullptr — конец файла
+    bool draining = false;
+};
+
+// Пакеты собираются из файлов с близким числом блоков: пакет идёт столько блоков, сколько самый длинный
+size_t batchBucket(uint64_t size) {
+    uint64_t blocks = (size + 9 + 63) / 64;
+    size_t bucket = 0;
+    while ((uint64_t{1} << bucket) < blocks) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+void hashBatch(const std::vector<const std::vector<unsigned char>*>& contents, std::vector<Digest>& digests) {
+    std::vector<HashInput> inputs;
+    inputs.reserve(contents.size());
+    for (const auto* content : contents) {
+        inputs.push_back({content->data(), content->size()});
+    }
+    std::vector<unsigned char> raw(contents.size() * Sha256Policy::digestSize);
+    sha256Batch(inputs.data(), inputs.size(), raw.data());
+
+    digests.resize(contents.size());
+    for (size_t i = 0; i < contents.size(); ++i) {
+        digests[i] = Digest(ChecksumAlgorithm::Sha256, Sha256Policy::digestSize);
+        std::memcpy(digests[i].data(), raw.data() + i * Sha256Policy::digestSize, Sha256Policy::digestSize);
+    }
+}
+
+// Забирает завершения операций, оставшихся в кольце после ошибки, не отправляя новых;
+// false — кольцо перестало отвечать раньше, чем вернуло все
+bool reap(IoUring& ring, unsigned& outstanding) {
+    constexpr int kAttempts = 100;
+    io_uring_cqe completion;
+    for (int failures = 0; failures < kAttempts;) {
+        while (ring.pop(completion)) {
+            --outstanding;
+        }
+        if (outstanding == 0) {
+            return true;
+        }
+        try {
+            ring.submit(1);
+        } catch (const std::runtime_error&) {
+            // EBUSY (переполнена очередь завершений) проходит после pop, ENOMEM — со временем
+            ++failures;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+ScanEngine::ScanEngine(const ScanConfig& config)
+    : queueDepth(config.queueDepth > 0 ? config.queueDepth : kDefaultQueueDepth),
+      useIoUring(config.ioUring),
+      batchSmallFiles(config.batchSmallFiles) {}
+
+bool ScanEngine::batchable(ChecksumAlgorithm algorithm, bool tree, uint64_t size) const {
+    return batchSmallFiles && algorithm == ChecksumAlgorithm::Sha256 && !tree && size <= kBatchFileLimit;
+}
+
+std::vector<ScanResult> ScanEngine::hash(const std::vector<ScanRequest>& requests) {
+    auto started = std::chrono::steady_clock::now();
+    stats = ScanStats{};
+    stats.queueDepth = queueDepth;
+
+    std::vector<ScanResult> results(requests.size());
+    std::vector<size_t> rest;
+    if (useIoUring) {
+        try {
+            rest = hashWithIoUring(requests, results);
+            stats.ioUring = true;
+        } catch (const std::runtime_error&) {
+            // Ядро без io_uring или он запрещён политикой — дальше только pread
+            useIoUring = false;
+        }
+    }
+    if (!stats.ioUring) {
+        results.assign(requests.size(), ScanResult{});
+        stats.files = 0;
+        stats.bytes = 0;
+        rest.resize(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            rest[i] = i;
+        }
+    }
+    hashWithPread(requests, rest, results);
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return results;
+}
+
+std::vector<size_t> ScanEngine::hashWithIoUring(const std::vector<ScanRequest>& requests, std::vector<ScanResult>& results) {
+    // Буферы и задачи объявлены раньше кольца и разрушаются после него
+    std::vector<std::unique_ptr<FileJob>> jobs(requests.size());
+    std::vector<size_t> deferred;
+    std::unique_ptr<BufferPool> bufferPool;
+    IoUring ring(queueDepth);
+    // На ядрах 5.1–5.5 io_uring есть, но без этих операций: каждый файл завершился бы с -EINVAL,
+    // а исключение переводит обход на pread
+    for (uint8_t opcode : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE}) {
+        if (!ring.supports(opcode)) {
+            throw std::runtime_error("io_uring не поддерживает операцию " + std::to_string(opcode));
+        }
+    }
+    bufferPool = std::make_unique<BufferPool>(ring.capacity() * 2, kReadSize);
+    BufferPool& buffers = *bufferPool;
+    unsigned outstanding = 0;   // операций в кольце, чьи завершения ещё не забраны
+
+    auto acquire = [&]() {
+        io_uring_sqe* sqe = ring.acquire();
+        ++outstanding;
+        return sqe;
+    };
+
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    size_t hashing = 0;
+
+    auto drain = [&](size_t index) {
+        FileJob& job = *jobs[index];
+        while (true) {
+            std::pair<unsigned char*, size_t> chunk;
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if (job.chunks.empty()) {
+                    job.draining = false;
+                    return;
+                }
+                chunk = job.chunks.front();
+                job.chunks.pop_front();
+            }
+            if (chunk.first == nullptr) {
+                // Конец файла всегда последний в очереди; после уменьшения счётчика job и сама
+                // функция могут быть уничтожены, поэтому дальше ничего не трогаем
+                results[index].digest = job.hasher->finish();
+                std::lock_guard<std::mutex> lock(doneMutex);
+                --hashing;
+                doneCondition.notify_all();
+                return;
+            }
+            job.hasher->update(chunk.first, chunk.second);
+            buffers.release(chunk.first);
+        }
+    };
+
+    auto enqueue = [&](size_t index, unsigned char* data, size_t size) {
+        FileJob& job = *jobs[index];
+        bool schedule;
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            job.chunks.emplace_back(data, size);
+            schedule = !job.draining;
+            job.draining = true;
+        }
+        if (schedule) {
+            workers.submit([&drain, index]() { drain(index); });
+        }
+    };
+
+    auto finishHashing = [&](size_t index) {
+        jobs[index]->finalQueued = true;
+        enqueue(index, nullptr, 0);
+    };
+
+    auto waitHashing = [&]() {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [&]() { return hashing == 0; });
+    };
+
+    std::vector<std::vector<size_t>> pendingBatches;
+
+    auto flushBatch = [&](size_t bucket) {
+        std::vector<size_t> batch;
+        batch.swap(pendingBatches[bucket]);
+        if (batch.empty()) {
+            return;
+        }
+        workers.submit([&, batch]() {
+            std::vector<const std::vector<unsigned char>*> contents;
+            for (size_t index : batch) {
+                contents.push_back(&jobs[index]->content);
+            }
+            std::vector<Digest> digests;
+            hashBatch(contents, digests);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                results[batch[i]].digest = digests[i];
+            }
+            std::lock_guard<std::mutex> lock(doneMutex);
+            hashing -= batch.size();
+            doneCondition.notify_all();
+        });
+    };
+
+    auto addToBatch = [&](size_t index) {
+        size_t bucket = batchBucket(jobs[index]->content.size());
+        if (pendingBatches.size() <= bucket) {
+            pendingBatches.resize(bucket + 1);
+        }
+        pendingBatches[bucket].push_back(index);
+        if (pendingBatches[bucket].size() == kBatchSize) {
+            flushBatch(bucket);
+        }
+    };
+
+    auto flushAllBatches = [&]() {
+        for (size_t bucket = 0; bucket < pendingBatches.size(); ++bucket) {
+            flushBatch(bucket);
+        }
+    };
+
+    auto submitRead = [&](size_t index) {
+        FileJob& job = *jobs[index];
+        io_uring_sqe* sqe = acquire();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = job.fd;
+        if (job.batched) {
+            // На байт больше размера из statx: прочитанный целиком буфер означает, что файл вырос
+            sqe->addr = reinterpret_cast<uint64_t>(job.content.data() + job.offset);
+            sqe->len = static_cast<uint32_t>(job.content.size() - job.offset);
+        } else {
+            sqe->addr = reinterpret_cast<uint64_t>(job.buffer);
+            sqe->len = static_cast<uint32_t>(kReadSize);
+        }
+        sqe->off = job.offset;
+        sqe->user_data = index;
+        job.stage = FileJob::Stage::Read;
+    };
+
+    auto submitClose = [&](size_t index) {
+        FileJob& job = *jobs[index];
+        io_uring_sqe* sqe = acquire();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = job.fd;
+        sqe->user_data = index;
+        job.stage = FileJob::Stage::Close;
+    };
+
+    auto fail = [&](size_t index, int error) {
+        FileJob& job = *jobs[index];
+        results[index].error = "Ошибка чтения файла " + requests[index].path.string() + ": " + std::strerror(error);
+        if (job.buffer) {
+            buffers.release(job.buffer);
+            job.buffer = nullptr;
+        }
+        if (job.hasher && !job.finalQueued) {
+            finishHashing(index);
+        }
+        if (job.batched) {
+            job.batched = false;
+            std::lock_guard<std::mutex> lock(doneMutex);
+            --hashing;
+        }
+        if (job.fd >= 0) {
+            submitClose(index);
+            return false;
+        }
+        return true; // операций по файлу больше нет
+    };
+
+    // Обрабатывает завершение; возвращает true, когда работа с файлом закончена
+    auto complete = [&](size_t index, int res) {
+        FileJob& job = *jobs[index];
+        const ScanRequest& request = requests[index];
+        ScanResult& result = results[index];
+
+        switch (job.stage) {
+            case FileJob::Stage::Open: {
+                if (res < 0) return fail(index, -res);
+                job.fd = res;
+                io_uring_sqe* sqe = acquire();
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = job.fd;
+                sqe->addr = reinterpret_cast<uint64_t>("");
+                sqe->len = STATX_BASIC_STATS;
+                sqe->off = reinterpret_cast<uint64_t>(&job.info);
+                sqe->statx_flags = AT_EMPTY_PATH;
+                sqe->user_data = index;
+                job.stage = FileJob::Stage::Statx;
+                return false;
+            }
+            case FileJob::Stage::Statx: {
+                if (res < 0) return fail(index, -res);
+                result.fingerprint = fingerprintFrom(job.info);
+                if (result.fingerprint == request.expected) {
+                    result.skipped = true;
+                    submitClose(index);
+                    return false;
+                }
+
+                std::string algorithmName = request.algorithmName.empty()
+                    ? ChecksumService::algorithmFor(request.checksum, result.fingerprint.size)
+                    : request.algorithmName;
+                ChecksumAlgorithm algorithm;
+                bool tree;
+                parseDigestAlgorithmName(algorithmName, algorithm, tree);
+                if (tree) {
+                    // Дерево читает файл параллельно по листам — отдаём его ChecksumService
+                    deferred.push_back(index);
+                    submitClose(index);
+                    return false;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    ++hashing;
+                }
+                if (batchable(algorithm, tree, result.fingerprint.size)) {
+                    job.batched = true;
+                    job.content.resize(static_cast<size_t>(result.fingerprint.size) + 1);
+                } else {
+                    job.hasher = makeHasher(algorithm);
+                    job.buffer = buffers.acquire();
+                }
+                submitRead(index);
+                return false;
+            }
+            case FileJob::Stage::Read: {
+                if (res < 0) return fail(index, -res);
+                size_t count = static_cast<size_t>(res);
+                if (job.batched) {
+                    stats.bytes += count;
+                    job.offset += count;
+                    if (count == 0) {
+                        ++stats.files;
+                        job.content.resize(static_cast<size_t>(job.offset));
+                        addToBatch(index);
+                        submitClose(index);
+                        return false;
+                    }
+                    if (job.offset < job.content.size()) {
+                        submitRead(index);
+                        return false;
+                    }
+                    // Файл вырос после statx — дочитываем его потоково, начало хешируем здесь же
+                    job.batched = false;
+                    job.hasher = makeHasher(ChecksumAlgorithm::Sha256);
+                    job.hasher->update(job.content.data(), job.content.size());
+                    std::vector<unsigned char>().swap(job.content);
+                    job.buffer = buffers.acquire();
+                    submitRead(index);
+                    return false;
+                }
+                if (count > 0) {
+                    enqueue(index, job.buffer, count);
+                    job.offset += count;
+                    stats.bytes += count;
+                } else {
+                    buffers.release(job.buffer);
+                }
+                job.buffer = nullptr;
+
+                // Чтение может вернуть меньше запрошенного и не в конце файла: конец — только пустое чтение
+                if (count == 0) {
+                    ++stats.files;
+                    finishHashing(index);
+                    submitClose(index);
+                    return false;
+                }
+                job.buffer = buffers.acquire();
+                submitRead(index);
+                return false;
+            }
+            case FileJob::Stage::Close:
+                return true;
+        }
+        return true;
+    };
+
+    size_t next = 0;
+    unsigned inFlight = 0;
+    try {
+        while (next < requests.size() || inFlight > 0) {
+            while (inFlight < ring.capacity() && next < requests.size()) {
+                jobs[next] = std::make_unique<FileJob>();
+                io_uring_sqe* sqe = acquire();
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uint64_t>(requests[next].path.c_str());
+                sqe->open_flags = O_RDONLY | O_CLOEXEC;
+                sqe->user_data = next;
+                ++next;
+                ++inFlight;
+            }
+
+            ring.submit(1);
+            io_uring_cqe completion;
+            while (ring.pop(completion)) {
+                --outstanding;
+                if (complete(static_cast<size_t>(completion.user_data), completion.res)) {
+                    --inFlight;
+                }
+            }
+        }
+    } catch (...) {
+        // Ядро ещё может писать в буферы, content и statx задач, чьи операции остались в кольце:
+        // их завершения забираются до освобождения памяти
+        bool reaped = reap(ring, outstanding);
+        // Задачи пула ссылаются на jobs — дожидаемся их до выхода
+        for (size_t index = 0; index < next; ++index) {
+            if (jobs[index] && jobs[index]->hasher && !jobs[index]->finalQueued) {
+                finishHashing(index);
+            }
+            if (jobs[index] && jobs[index]->batched && jobs[index]->stage == FileJob::Stage::Read) {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                --hashing;
+            }
+        }
+        flushAllBatches();
+        waitHashing();
+        if (!reaped) {
+            // Кольцо так и не вернуло все завершения: память задач и буферов оставляется как есть —
+            // утечка вместо записи ядра в освобождённую память
+            for (auto& job : jobs) {
+                job.release();
+            }
+            bufferPool.release();
+        }
+        throw;
+    }
+
+    flushAllBatches();
+    waitHashing();
+    return deferred;
+}
+
+void ScanEngine::hashWithPread(const std::vector<ScanRequest>& requests, const std::vector<size_t>& indices,
+                               std::vector<ScanResult>& results) {
+    // Задача пула обрабатывает группу запросов, чтобы маленькие файлы SHA-256 можно было хешировать пакетом
+    size_t groupSize = batchSmallFiles ? kBatchSize : 1;
+    std::deque<std::pair<std::vector<size_t>, std::future<uint64_t>>> inFlight;
+    auto collect = [&]() {
+        uint64_t bytes = inFlight.front().second.get();
+        for (size_t index : inFlight.front().first) {
+            if (results[index].ok() && !results[index].skipped) {
+                ++stats.files;
+            }
+        }
+        stats.bytes += bytes;
+        inFlight.pop_front();
+    };
+
+    for (size_t first = 0; first < indices.size(); first += groupSize) {
+        std::vector<size_t> group(indices.begin() + first,
+                                  indices.begin() + std::min(indices.size(), first + groupSize));
+        if (inFlight.size() * groupSize >= queueDepth) {
+            collect();
+        }
+        auto future = workers.submit([this, &requests, &results, group]() -> uint64_t {
+            uint64_t bytes = 0;
+            std::vector<size_t> batch;
+            std::vector<std::vector<unsigned char>> contents;
+            for (size_t index : group) {
+                const ScanRequest& request = requests[index];
+                ScanResult& result = results[index];
+                try {
+                    result.fingerprint = FileFingerprint::capture(request.path);
+                    if (result.fingerprint == request.expected) {
+                        result.skipped = true;
+                        continue;
+                    }
+                    std::string algorithmName = request.algorithmName.empty()
+                        ? ChecksumService::algorithmFor(request.checksum, result.fingerprint.size)
+                        : request.algorithmName;
+                    ChecksumAlgorithm algorithm;
+                    bool tree;
+                    parseDigestAlgorithmName(algorithmName, algorithm, tree);
+                    if (batchable(algorithm, tree, result.fingerprint.size)) {
+                        std::vector<unsigned char> content;
+                        FileReader::read(request.path, [&](const unsigned char* data, size_t size) {
+                            content.insert(content.end(), data, data + size);
+                        });
+                        bytes += content.size();
+                        batch.push_back(index);
+                        contents.push_back(std::move(content));
+                        continue;
+                    }
+                    result.digest = ChecksumService::compute(request.path, algorithmName);
+                    bytes += result.fingerprint.size;
+                } catch (const std::exception& ex) {
+                    result.error = ex.what();
+                }
+            }
+
+            if (!batch.empty()) {
+                std::vector<const std::vector<unsigned char>*> pointers;
+                for (const auto& content : contents) {
+                    pointers.push_back(&content);
+                }
+                std::vector<Digest> digests;
+                hashBatch(pointers, digests);
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    results[batch[i]].digest = digests[i];
+                }
+            }
+            return bytes;
+        });
+        inFlight.emplace_back(std::move(group), std::move(future));
+    }
+    while (!inFlight.empty()) {
+        collect();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "ConfigLoader.hpp"
+#include "Digest.hpp"
+#include "FileFingerprint.hpp"
+#include "ThreadPool.hpp"
+
+struct ScanRequest {
+    std::filesystem::path path;
+    ChecksumConfig checksum;
+    std::string algorithmName;    // пусто — выбирается по checksum и размеру файла
+    FileFingerprint expected;     // при совпадении слепка файл не читается (skipped)
+};
+
+struct ScanResult {
+    Digest digest;
+    FileFingerprint fingerprint;  // снят до чтения файла
+    bool skipped = false;
+    std::string error;            // непусто — файл обработать не удалось
+
+    bool ok() const { return error.empty(); }
+};
+
+struct ScanStats {
+    size_t files = 0;             // прочитано файлов
+    uint64_t bytes = 0;           // прочитано байт
+    double seconds = 0;
+    bool ioUring = false;
+    unsigned queueDepth = 0;
+
+    double megabytesPerSecond() const {
+        return seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0;
+    }
+};
+
+// Пакетное хеширование файлов при первичном обходе.
+// Через io_uring одновременно выполняется до queueDepth операций openat/statx/read/close
+// (по одной на файл), прочитанные блоки хешируются в пуле потоков с сохранением порядка
+// внутри файла. Без io_uring файлы читаются pread в queueDepth задачах пула.
+// Маленькие файлы SHA-256 читаются целиком и хешируются пакетами по kBatchSize (sha256Batch).
+// Файлы в режиме дерева всегда считаются через ChecksumService.
+class ScanEngine {
+public:
+    static constexpr unsigned kDefaultQueueDepth = 32;
+    static constexpr size_t kReadSize = 256 * 1024;
+    static constexpr uint64_t kBatchFileLimit = 16 * 1024;
+    static constexpr size_t kBatchSize = 16;
+
+    explicit ScanEngine(const ScanConfig& config);
+
+    // Результаты в порядке запросов
+    std::vector<ScanResult> hash(const std::vector<ScanRequest>& requests);
+
+    const ScanStats& lastStats() const { return stats; }
+
+private:
+    std::vector<size_t> hashWithIoUring(const std::vector<ScanRequest>& requests, std::vector<ScanResult>& results);
+    void hashWithPread(const std::vector<ScanRequest>& requests, const std::vector<size_t>& indices,
+                       std::vector<ScanResult>& results);
+
+    bool batchable(ChecksumAlgorithm algorithm, bool tree, uint64_t size) const;
+
+    unsigned queueDepth;
+    bool useIoUring;
+    bool batchSmallFiles;
+    ThreadPool workers;
+    ScanStats stats;
+};
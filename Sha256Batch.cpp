@@ -0,0 +1,333 @@
+// Sha256Batch.cpp
+// Многобуферный SHA-256: каждая 32-битная дорожка SIMD-регистра считает своё сообщение.
+// AVX-512 — 16 дорожек, AVX2 — 8; без них буферы хешируются по одному через OpenSSL.
+#include "ChecksumAlgorithms.hpp"
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+constexpr uint32_t kInitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+uint64_t paddedBlockCount(size_t size) {
+    return (static_cast<uint64_t>(size) + 9 + 63) / 64;
+}
+
+alignas(64) constexpr unsigned char kZeroBlock[64] = {};
+
+// Указатель на блок blockIndex сообщения: полные блоки читаются прямо из данных,
+// хвост с дополнением (0x80, нули, длина в битах big-endian) собирается в scratch
+const unsigned char* paddedBlock(const HashInput& input, uint64_t blockIndex, uint64_t blockCount,
+                                 unsigned char* scratch) {
+    uint64_t offset = blockIndex * 64;
+    if (offset + 64 <= input.size) {
+        return input.data + offset;
+    }
+    size_t available = offset < input.size ? static_cast<size_t>(input.size - offset) : 0;
+    if (available > 0) {
+        std::memcpy(scratch, input.data + offset, available);
+    }
+    std::memset(scratch + available, 0, 64 - available);
+    if (offset <= input.size) {
+        scratch[available] = 0x80;
+    }
+    if (blockIndex + 1 == blockCount) {
+        uint64_t bitLength = static_cast<uint64_t>(input.size) * 8;
+        for (int i = 0; i < 8; ++i) {
+            scratch[63 - i] = static_cast<unsigned char>(bitLength >> (8 * i));
+        }
+    }
+    return scratch;
+}
+
+void storeDigest(const uint32_t state[8], unsigned char* digest) {
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = static_cast<unsigned char>(state[i] >> 24);
+        digest[4 * i + 1] = static_cast<unsigned char>(state[i] >> 16);
+        digest[4 * i + 2] = static_cast<unsigned char>(state[i] >> 8);
+        digest[4 * i + 3] = static_cast<unsigned char>(state[i]);
+    }
+}
+
+void hashScalar(const HashInput* inputs, size_t count, unsigned char* digests) {
+    for (size_t i = 0; i < count; ++i) {
+        SHA256(inputs[i].data, inputs[i].size, digests + i * Sha256Policy::digestSize);
+    }
+}
+
+#if defined(__x86_64__)
+
+// Адреса очередного блока каждой дорожки относительно kZeroBlock — индексы для инструкций gather.
+// Дорожки без данных на этом шаге читают нулевой блок; возвращает маску активных дорожек.
+template <size_t Lanes>
+uint32_t collectBlocks(const HashInput* inputs, size_t count, const uint64_t* blocks, uint64_t blockIndex,
+                       unsigned char (*scratch)[64], int64_t* offsets) {
+    uint32_t activeLanes = 0;
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+        const unsigned char* block = kZeroBlock;
+        if (lane < count && blockIndex < blocks[lane]) {
+            block = paddedBlock(inputs[lane], blockIndex, blocks[lane], scratch[lane]);
+            activeLanes |= 1u << lane;
+        }
+        offsets[lane] = static_cast<int64_t>(reinterpret_cast<uintptr_t>(block) - reinterpret_cast<uintptr_t>(kZeroBlock));
+    }
+    return activeLanes;
+}
+
+__attribute__((target("avx2"), always_inline))
+inline __m256i rotr256(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+__attribute__((target("avx2")))
+void hashLanesAvx2(const HashInput* inputs, size_t count, unsigned char* digests) {
+    constexpr size_t kLanes = 8;
+    uint64_t blocks[kLanes] = {};
+    uint64_t maxBlocks = 0;
+    for (size_t lane = 0; lane < count; ++lane) {
+        blocks[lane] = paddedBlockCount(inputs[lane].size);
+        maxBlocks = std::max(maxBlocks, blocks[lane]);
+    }
+
+    __m256i state[8];
+    for (int i = 0; i < 8; ++i) {
+        state[i] = _mm256_set1_epi32(static_cast<int>(kInitialState[i]));
+    }
+
+    const __m256i byteSwap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                              3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    alignas(64) unsigned char scratch[kLanes][64];
+    alignas(32) int64_t offsets[kLanes];
+    const int* base = reinterpret_cast<const int*>(kZeroBlock);
+
+    for (uint64_t blockIndex = 0; blockIndex < maxBlocks; ++blockIndex) {
+        uint32_t activeLanes = collectBlocks<kLanes>(inputs, count, blocks, blockIndex, scratch, offsets);
+        __m256i active = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(activeLanes)), laneBits), laneBits);
+
+        __m256i lowOffsets = _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets));
+        __m256i highOffsets = _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets + 4));
+        __m256i schedule[16];
+        for (int t = 0; t < 16; ++t) {
+            __m128i low = _mm256_i64gather_epi32(base + t, lowOffsets, 1);
+            __m128i high = _mm256_i64gather_epi32(base + t, highOffsets, 1);
+            schedule[t] = _mm256_shuffle_epi8(_mm256_set_m128i(high, low), byteSwap);
+        }
+
+        __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+        __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+#pragma GCC unroll 64
+        for (int t = 0; t < 64; ++t) {
+            __m256i w;
+            if (t < 16) {
+                w = schedule[t];
+            } else {
+                __m256i w15 = schedule[(t - 15) & 15];
+                __m256i w2 = schedule[(t - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr256(w15, 7), rotr256(w15, 18)), _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr256(w2, 17), rotr256(w2, 19)), _mm256_srli_epi32(w2, 10));
+                w = _mm256_add_epi32(_mm256_add_epi32(schedule[t & 15], s0), _mm256_add_epi32(schedule[(t - 7) & 15], s1));
+                schedule[t & 15] = w;
+            }
+
+            __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr256(e, 6), rotr256(e, 11)), rotr256(e, 25));
+            __m256i choose = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1),
+                                          _mm256_add_epi32(_mm256_add_epi32(choose, w),
+                                                           _mm256_set1_epi32(static_cast<int>(kRoundConstants[t]))));
+            __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr256(a, 2), rotr256(a, 13)), rotr256(a, 22));
+            __m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+            __m256i t2 = _mm256_add_epi32(sigma0, majority);
+
+            h = g; g = f; f = e;
+            e = _mm256_add_epi32(d, t1);
+            d = c; c = b; b = a;
+            a = _mm256_add_epi32(t1, t2);
+        }
+
+        __m256i updated[8] = {a, b, c, d, e, f, g, h};
+        for (int i = 0; i < 8; ++i) {
+            state[i] = _mm256_blendv_epi8(state[i], _mm256_add_epi32(state[i], updated[i]), active);
+        }
+    }
+
+    alignas(32) uint32_t lanes[8][kLanes];
+    for (int i = 0; i < 8; ++i) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[i]), state[i]);
+    }
+    for (size_t lane = 0; lane < count; ++lane) {
+        uint32_t laneState[8];
+        for (int i = 0; i < 8; ++i) {
+            laneState[i] = lanes[i][lane];
+        }
+        storeDigest(laneState, digests + lane * Sha256Policy::digestSize);
+    }
+}
+
+// GCC 12 предупреждает о неинициализированных значениях внутри _mm512_undefined_* из своих
+// же заголовков интринсиков (ложное срабатывание при -O2 -Wall, исправлено в GCC 13)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+void hashLanesAvx512(const HashInput* inputs, size_t count, unsigned char* digests) {
+    constexpr size_t kLanes = 16;
+    uint64_t blocks[kLanes] = {};
+    uint64_t maxBlocks = 0;
+    for (size_t lane = 0; lane < count; ++lane) {
+        blocks[lane] = paddedBlockCount(inputs[lane].size);
+        maxBlocks = std::max(maxBlocks, blocks[lane]);
+    }
+
+    __m512i state[8];
+    for (int i = 0; i < 8; ++i) {
+        state[i] = _mm512_set1_epi32(static_cast<int>(kInitialState[i]));
+    }
+
+    const __m512i oddBytes = _mm512_set1_epi32(static_cast<int>(0xFF00FF00u));
+    alignas(64) unsigned char scratch[kLanes][64];
+    alignas(64) int64_t offsets[kLanes];
+    const int* base = reinterpret_cast<const int*>(kZeroBlock);
+
+    for (uint64_t blockIndex = 0; blockIndex < maxBlocks; ++blockIndex) {
+        __mmask16 active = static_cast<__mmask16>(collectBlocks<kLanes>(inputs, count, blocks, blockIndex, scratch, offsets));
+
+        __m512i lowOffsets = _mm512_load_si512(offsets);
+        __m512i highOffsets = _mm512_load_si512(offsets + 8);
+        __m512i schedule[16];
+        for (int t = 0; t < 16; ++t) {
+            __m256i low = _mm512_i64gather_epi32(lowOffsets, base + t, 1);
+            __m256i high = _mm512_i64gather_epi32(highOffsets, base + t, 1);
+            __m512i word = _mm512_inserti64x4(_mm512_castsi256_si512(low), high, 1);
+            // Перестановка байтов без AVX-512BW: байты 3 и 1 из ror 8, байты 2 и 0 из rol 8
+            schedule[t] = _mm512_ternarylogic_epi32(oddBytes, _mm512_ror_epi32(word, 8), _mm512_rol_epi32(word, 8), 0xCA);
+        }
+
+        __m512i a = state[0], b = state[1], c = state[2], d = state[3];
+        __m512i e = state[4], f = state[5], g = state[6], h = state[7];
+#pragma GCC unroll 64
+        for (int t = 0; t < 64; ++t) {
+            __m512i w;
+            if (t < 16) {
+                w = schedule[t];
+            } else {
+                __m512i w15 = schedule[(t - 15) & 15];
+                __m512i w2 = schedule[(t - 2) & 15];
+                __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18),
+                                                       _mm512_srli_epi32(w15, 3), 0x96);
+                __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19),
+                                                       _mm512_srli_epi32(w2, 10), 0x96);
+                w = _mm512_add_epi32(_mm512_add_epi32(schedule[t & 15], s0), _mm512_add_epi32(schedule[(t - 7) & 15], s1));
+                schedule[t & 15] = w;
+            }
+
+            // 0x96 — a^b^c, 0xCA — a ? b : c (Ch), 0xE8 — большинство (Maj)
+            __m512i sigma1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11),
+                                                       _mm512_ror_epi32(e, 25), 0x96);
+            __m512i choose = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+            __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(h, sigma1),
+                                          _mm512_add_epi32(_mm512_add_epi32(choose, w),
+                                                           _mm512_set1_epi32(static_cast<int>(kRoundConstants[t]))));
+            __m512i sigma0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13),
+                                                       _mm512_ror_epi32(a, 22), 0x96);
+            __m512i majority = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+            __m512i t2 = _mm512_add_epi32(sigma0, majority);
+
+            h = g; g = f; f = e;
+            e = _mm512_add_epi32(d, t1);
+            d = c; c = b; b = a;
+            a = _mm512_add_epi32(t1, t2);
+        }
+
+        __m512i updated[8] = {a, b, c, d, e, f, g, h};
+        for (int i = 0; i < 8; ++i) {
+            state[i] = _mm512_mask_add_epi32(state[i], active, state[i], updated[i]);
+        }
+    }
+
+    alignas(64) uint32_t lanes[8][kLanes];
+    for (int i = 0; i < 8; ++i) {
+        _mm512_store_si512(lanes[i], state[i]);
+    }
+    for (size_t lane = 0; lane < count; ++lane) {
+        uint32_t laneState[8];
+        for (int i = 0; i < 8; ++i) {
+            laneState[i] = lanes[i][lane];
+        }
+        storeDigest(laneState, digests + lane * Sha256Policy::digestSize);
+    }
+}
+#pragma GCC diagnostic pop
+
+#endif
+
+using LaneFunction = void (*)(const HashInput*, size_t, unsigned char*);
+
+struct BatchKernel {
+    LaneFunction function;
+    size_t lanes;
+    const char* name;
+};
+
+#if defined(__x86_64__)
+bool hasShaExtensions() {
+    unsigned eax, ebx, ecx, edx;
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 29)) != 0;
+}
+#endif
+
+// Auto: AVX-512 обгоняет одиночный SHA-NI, а восемь дорожек AVX2 — нет,
+// поэтому при наличии SHA-NI без AVX-512 буферы считаются по одному через OpenSSL
+BatchKernel selectKernel(Sha256BatchKernel preferred) {
+#if defined(__x86_64__)
+    bool hasAvx512 = __builtin_cpu_supports("avx512f");
+    bool hasAvx2 = __builtin_cpu_supports("avx2");
+    if (preferred == Sha256BatchKernel::Auto) {
+        preferred = hasAvx512 ? Sha256BatchKernel::Avx512
+                  : hasAvx2 && !hasShaExtensions() ? Sha256BatchKernel::Avx2
+                  : Sha256BatchKernel::Scalar;
+    }
+    if (preferred == Sha256BatchKernel::Avx512 && hasAvx512) return {hashLanesAvx512, 16, "avx512"};
+    if (preferred == Sha256BatchKernel::Avx2 && hasAvx2) return {hashLanesAvx2, 8, "avx2"};
+#else
+    (void)preferred;
+#endif
+    return {hashScalar, 1, "scalar"};
+}
+
+} // namespace
+
+void sha256Batch(const HashInput* inputs, size_t count, unsigned char* digests, Sha256BatchKernel kernel) {
+    static const BatchKernel automatic = selectKernel(Sha256BatchKernel::Auto);
+    BatchKernel selected = kernel == Sha256BatchKernel::Auto ? automatic : selectKernel(kernel);
+
+    for (size_t first = 0; first < count; first += selected.lanes) {
+        size_t lanes = std::min(selected.lanes, count - first);
+        if (lanes == 1) {
+            // Одиночный буфер быстрее посчитать обычным путём (OpenSSL использует SHA-NI, если есть)
+            hashScalar(inputs + first, 1, digests + first * Sha256Policy::digestSize);
+        } else {
+            selected.function(inputs + first, lanes, digests + first * Sha256Policy::digestSize);
+        }
+    }
+}
+
+const char* sha256BatchKernelName() {
+    return selectKernel(Sha256BatchKernel::Auto).name;
+}
@@ -2,13 +2,17 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 #include <chrono>
+#include <unordered_map>
 #include <sqlite3.h>
 
 StatePersistenceService::StatePersistenceService(const std::string& dbPath) {
     if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
         throw std::runtime_error("Не удалось открыть БД: " + std::string(sqlite3_errmsg(db)));
     }
+    // Сборщик мусора пишет в базу через своё соединение короткими транзакциями
+    sqlite3_busy_timeout(db, 5000);
 }
 
 StatePersistenceService::~StatePersistenceService() {
@@ -23,12 +27,30 @@ void StatePersistenceService::initializeSchema() {
     // execute(drop); //DEBUG DROP ONLY, SHOULD BE DELETED
     // return;
 
+    // Освобождение страниц по частям (compact): действует только для новой базы, поэтому раньше
+    // перехода в WAL, который записывает заголовок файла; существующую переключит первый VACUUM.
+    // В WAL чтение в одном соединении не ждёт записи в другом (сборка мусора)
+    execute("PRAGMA auto_vacuum = INCREMENTAL;");
+    execute("PRAGMA journal_mode = WAL;");
+
     const std::string sql = R"SQL(
         CREATE TABLE IF NOT EXISTS tracking_files (
             file_id integer PRIMARY KEY AUTOINCREMENT, 
             file_path TEXT NOT NULL,
-            last_checksum TEXT,
-            is_missing INTEGER NOT NULL
+            group_id TEXT,
+            last_checksum BLOB,
+            checksum_algorithm TEXT,
+            is_missing INTEGER NOT NULL,
+            st_dev INTEGER,
+            st_ino INTEGER,
+            st_size INTEGER,
+            mtime_ns INTEGER,
+            ctime_ns INTEGER,
+            hash_state BLOB,
+            hash_offset INTEGER,
+            hash_anchor INTEGER,
+            quick_size INTEGER,
+            quick_sample INTEGER
         );
 
         CREATE TABLE IF NOT EXISTS file_changes (
@@ -36,14 +58,42 @@ void StatePersistenceService::initializeSchema() {
             file_id integer NOT NULL,
             timestamp TEXT NOT NULL,
             change_type TEXT NOT NULL,
-            checksum TEXT,
+            checksum BLOB,
+            checksum_algorithm TEXT,
             saved_version_id TEXT,
             user TEXT,
             additional_info TEXT,
             FOREIGN KEY (file_id) REFERENCES tracking_files(file_id)
         );
+
+        CREATE INDEX IF NOT EXISTS file_changes_file_id ON file_changes(file_id);
+        CREATE INDEX IF NOT EXISTS file_changes_saved_version ON file_changes(saved_version_id);
+
+        CREATE TABLE IF NOT EXISTS daemon_state (
+            key TEXT PRIMARY KEY,
+            value INTEGER NOT NULL
+        );
+
+        CREATE TABLE IF NOT EXISTS scrub_state (
+            id INTEGER PRIMARY KEY CHECK (id = 1),
+            cursor TEXT NOT NULL,
+            round_started INTEGER NOT NULL
+        );
     )SQL";
     execute(sql);
+
+    // Базы, созданные до появления выбора алгоритма: NULL означает sha256
+    ensureColumn("tracking_files", "checksum_algorithm", "TEXT");
+    ensureColumn("file_changes", "checksum_algorithm", "TEXT");
+    ensureColumn("tracking_files", "group_id", "TEXT");
+    for (const char* column : {"st_dev", "st_ino", "st_size", "mtime_ns", "ctime_ns"}) {
+        ensureColumn("tracking_files", column, "INTEGER");
+    }
+    ensureColumn("tracking_files", "hash_state", "BLOB");
+    ensureColumn("tracking_files", "hash_offset", "INTEGER");
+    ensureColumn("tracking_files", "hash_anchor", "INTEGER");
+    ensureColumn("tracking_files", "quick_size", "INTEGER");
+    ensureColumn("tracking_files", "quick_sample", "INTEGER");
 }
 
 void StatePersistenceService::execute(const std::string& sql) {
@@ -55,13 +105,131 @@ void StatePersistenceService::execute(const std::string& sql) {
     }
 }
 
+void StatePersistenceService::ensureColumn(const std::string& table, const std::string& column, const std::string& definition) {
+    const std::string sql = "PRAGMA table_info(" + table + ");";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка чтения схемы таблицы " + table);
+    }
+
+    bool found = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (columnText(stmt, 1) == column) {
+            found = true;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    if (!found) {
+        execute("ALTER TABLE " + table + " ADD COLUMN " + column + " " + definition + ";");
+    }
+}
+
+std::string StatePersistenceService::columnText(sqlite3_stmt* stmt, int column) {
+    const unsigned char* text = sqlite3_column_text(stmt, column);
+    return text ? reinterpret_cast<const char*>(text) : std::string();
+}
+
+void StatePersistenceService::bindDigest(sqlite3_stmt* stmt, int checksumIndex, int algorithmIndex, const Digest& digest) {
+    if (digest.empty()) {
+        sqlite3_bind_null(stmt, checksumIndex);
+    } else {
+        sqlite3_bind_blob(stmt, checksumIndex, digest.data(), digest.size, SQLITE_TRANSIENT);
+    }
+    std::string algorithm = digest.algorithmName();
+    sqlite3_bind_text(stmt, algorithmIndex, algorithm.c_str(), -1, SQLITE_TRANSIENT);
+}
+
+Digest StatePersistenceService::columnDigest(sqlite3_stmt* stmt, int checksumColumn, int algorithmColumn) {
+    std::string algorithm = columnText(stmt, algorithmColumn);
+    if (algorithm.empty()) {
+        algorithm = "sha256"; // записи до появления checksum_algorithm
+    }
+
+    switch (sqlite3_column_type(stmt, checksumColumn)) {
+        case SQLITE_BLOB:
+            return Digest::fromBytes(algorithm, sqlite3_column_blob(stmt, checksumColumn),
+                                     sqlite3_column_bytes(stmt, checksumColumn));
+        case SQLITE_TEXT:
+            // Старые базы хранили сумму шестнадцатеричной строкой
+            return Digest::fromHex(algorithm, columnText(stmt, checksumColumn));
+        default:
+            return Digest::fromBytes(algorithm, nullptr, 0);
+    }
+}
+
+void StatePersistenceService::bindFingerprint(sqlite3_stmt* stmt, int firstIndex, const FileFingerprint& fingerprint) {
+    sqlite3_bind_int64(stmt, firstIndex, static_cast<sqlite3_int64>(fingerprint.device));
+    sqlite3_bind_int64(stmt, firstIndex + 1, static_cast<sqlite3_int64>(fingerprint.inode));
+    sqlite3_bind_int64(stmt, firstIndex + 2, static_cast<sqlite3_int64>(fingerprint.size));
+    sqlite3_bind_int64(stmt, firstIndex + 3, fingerprint.mtimeNs);
+    sqlite3_bind_int64(stmt, firstIndex + 4, fingerprint.ctimeNs);
+}
+
+FileFingerprint StatePersistenceService::columnFingerprint(sqlite3_stmt* stmt, int firstColumn) {
+    FileFingerprint fingerprint;
+    fingerprint.device = static_cast<uint64_t>(sqlite3_column_int64(stmt, firstColumn));
+    fingerprint.inode = static_cast<uint64_t>(sqlite3_column_int64(stmt, firstColumn + 1));
+    fingerprint.size = static_cast<uint64_t>(sqlite3_column_int64(stmt, firstColumn + 2));
+    fingerprint.mtimeNs = sqlite3_column_int64(stmt, firstColumn + 3);
+    fingerprint.ctimeNs = sqlite3_column_int64(stmt, firstColumn + 4);
+    return fingerprint;
+}
+
+void StatePersistenceService::bindMidstate(sqlite3_stmt* stmt, int firstIndex, const HashMidstate& midstate) {
+    if (midstate.empty()) {
+        sqlite3_bind_null(stmt, firstIndex);
+        sqlite3_bind_null(stmt, firstIndex + 1);
+        sqlite3_bind_null(stmt, firstIndex + 2);
+        return;
+    }
+    sqlite3_bind_blob(stmt, firstIndex, midstate.context.data(), static_cast<int>(midstate.context.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, firstIndex + 1, static_cast<sqlite3_int64>(midstate.offset));
+    sqlite3_bind_int64(stmt, firstIndex + 2, static_cast<sqlite3_int64>(midstate.anchor));
+}
+
+HashMidstate StatePersistenceService::columnMidstate(sqlite3_stmt* stmt, int firstColumn) {
+    HashMidstate midstate;
+    const auto* data = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, firstColumn));
+    int size = sqlite3_column_bytes(stmt, firstColumn);
+    if (data == nullptr || size == 0) {
+        return midstate;
+    }
+    midstate.context.assign(data, data + size);
+    midstate.offset = static_cast<uint64_t>(sqlite3_column_int64(stmt, firstColumn + 1));
+    midstate.anchor = static_cast<uint64_t>(sqlite3_column_int64(stmt, firstColumn + 2));
+    return midstate;
+}
+
+void StatePersistenceService::bindQuickFingerprint(sqlite3_stmt* stmt, int firstIndex, const QuickFingerprint& quick) {
+    if (quick.empty()) {
+        sqlite3_bind_null(stmt, firstIndex);
+        sqlite3_bind_null(stmt, firstIndex + 1);
+        return;
+    }
+    sqlite3_bind_int64(stmt, firstIndex, static_cast<sqlite3_int64>(quick.size));
+    sqlite3_bind_int64(stmt, firstIndex + 1, static_cast<sqlite3_int64>(quick.sample));
+}
+
+QuickFingerprint StatePersistenceService::columnQuickFingerprint(sqlite3_stmt* stmt, int firstColumn) {
+    QuickFingerprint quick;
+    quick.size = static_cast<uint64_t>(sqlite3_column_int64(stmt, firstColumn));
+    quick.sample = static_cast<uint64_t>(sqlite3_column_int64(stmt, firstColumn + 1));
+    return quick;
+}
+
 void StatePersistenceService::createTrackingFile(TrackingFile& file) {
-    const std::string sql = "INSERT INTO tracking_files (file_path, last_checksum, is_missing) VALUES (?, ?, ?);";
+    const std::string sql = "INSERT INTO tracking_files (file_path, group_id, last_checksum, checksum_algorithm, is_missing, st_dev, st_ino, st_size, mtime_ns, ctime_ns, hash_state, hash_offset, hash_anchor, quick_size, quick_sample) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
     sqlite3_bind_text(stmt, 1, file.filePath.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, file.lastChecksum.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 3, file.isMissing ? 1 : 0);
+    sqlite3_bind_text(stmt, 2, file.groupId.c_str(), -1, SQLITE_TRANSIENT);
+    bindDigest(stmt, 3, 4, file.lastChecksum);
+    sqlite3_bind_int(stmt, 5, file.isMissing ? 1 : 0);
+    bindFingerprint(stmt, 6, file.fingerprint);
+    bindMidstate(stmt, 11, file.midstate);
+    bindQuickFingerprint(stmt, 14, file.quickFingerprint);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
@@ -75,13 +243,17 @@ void StatePersistenceService::createTrackingFile(TrackingFile& file) {
 }
 
 void StatePersistenceService::saveTrackingFile(const TrackingFile& file) {
-    const std::string sql = "INSERT OR REPLACE INTO tracking_files (file_id, file_path, last_checksum, is_missing) VALUES (?, ?, ?, ?);";
+    const std::string sql = "INSERT OR REPLACE INTO tracking_files (file_id, file_path, group_id, last_checksum, checksum_algorithm, is_missing, st_dev, st_ino, st_size, mtime_ns, ctime_ns, hash_state, hash_offset, hash_anchor, quick_size, quick_sample) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
     sqlite3_bind_text(stmt, 1, file.fileId.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 2, file.filePath.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, file.lastChecksum.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 4, file.isMissing ? 1 : 0);
+    sqlite3_bind_text(stmt, 3, file.groupId.c_str(), -1, SQLITE_TRANSIENT);
+    bindDigest(stmt, 4, 5, file.lastChecksum);
+    sqlite3_bind_int(stmt, 6, file.isMissing ? 1 : 0);
+    bindFingerprint(stmt, 7, file.fingerprint);
+    bindMidstate(stmt, 12, file.midstate);
+    bindQuickFingerprint(stmt, 15, file.quickFingerprint);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
@@ -92,17 +264,17 @@ void StatePersistenceService::saveTrackingFile(const TrackingFile& file) {
 
 
 void StatePersistenceService::saveFileChange(const std::string& fileId, const FileChange& change) {
-    const std::string sql = "INSERT INTO file_changes (file_id, timestamp, change_type, checksum, saved_version_id, user, additional_info) VALUES (?, ?, ?, ?, ?, ?, ?);";
+    const std::string sql = "INSERT INTO file_changes (file_id, timestamp, change_type, checksum, checksum_algorithm, saved_version_id, user, additional_info) VALUES (?, ?, ?, ?, ?, ?, ?, ?);";
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
     sqlite3_bind_text(stmt, 1, fileId.c_str(), -1, SQLITE_TRANSIENT);
     std::string ts = toIsoString(change.timestamp);
     sqlite3_bind_text(stmt, 2, ts.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 3, change.changeType.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 4, change.checksum.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 5, change.savedVersionId.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 6, change.user.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 7, change.additionalInfo.c_str(), -1, SQLITE_TRANSIENT);
+    bindDigest(stmt, 4, 5, change.checksum);
+    sqlite3_bind_text(stmt, 6, change.savedVersionId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 7, change.user.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 8, change.additionalInfo.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 }
@@ -118,14 +290,15 @@ std::chrono::system_clock::time_point StatePersistenceService::fromIsoString(con
     std::tm tm{};
     std::istringstream ss(str);
     ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
-    return std::chrono::system_clock::from_time_t(std::mktime(&tm));
+    return std::chrono::system_clock::from_time_t(timegm(&tm)); // время записано в UTC
 }
 
 // Метод loadTrackedFiles будет добавлен по запросу
 std::vector<TrackingFile> StatePersistenceService::loadTrackedFiles() {
     std::vector<TrackingFile> files;
+    std::unordered_map<sqlite3_int64, size_t> indexById;
 
-    const std::string sql = "SELECT file_id, file_path, last_checksum, is_missing FROM tracking_files;";
+    const std::string sql = "SELECT file_id, file_path, last_checksum, checksum_algorithm, is_missing, group_id, st_dev, st_ino, st_size, mtime_ns, ctime_ns, hash_state, hash_offset, hash_anchor, quick_size, quick_sample FROM tracking_files;";
     sqlite3_stmt* stmt;
     if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
         throw std::runtime_error("Ошибка подготовки запроса к tracking_files");
@@ -135,45 +308,307 @@ std::vector<TrackingFile> StatePersistenceService::loadTrackedFiles() {
         TrackingFile file;
         file.fileId = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
         file.filePath = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        file.lastChecksum = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        file.isMissing = sqlite3_column_int(stmt, 3) != 0;
-
-        // Загружаем изменения для файла
-        const std::string changesSql = "SELECT timestamp, change_type, checksum, saved_version_id, user, additional_info FROM file_changes WHERE file_id = ? ORDER BY timestamp ASC;";
-        sqlite3_stmt* changesStmt;
-        sqlite3_prepare_v2(db, changesSql.c_str(), -1, &changesStmt, nullptr);
-        sqlite3_bind_text(changesStmt, 1, file.fileId.c_str(), -1, SQLITE_TRANSIENT);
-
-        while (sqlite3_step(changesStmt) == SQLITE_ROW) {
-            FileChange change;
-            change.timestamp = fromIsoString(reinterpret_cast<const char*>(sqlite3_column_text(changesStmt, 0)));
-            change.changeType = reinterpret_cast<const char*>(sqlite3_column_text(changesStmt, 1));
-            change.checksum = reinterpret_cast<const char*>(sqlite3_column_text(changesStmt, 2));
-            change.savedVersionId = reinterpret_cast<const char*>(sqlite3_column_text(changesStmt, 3));
-            change.user = reinterpret_cast<const char*>(sqlite3_column_text(changesStmt, 4));
-            change.additionalInfo = reinterpret_cast<const char*>(sqlite3_column_text(changesStmt, 5));
-            file.history.changes.push_back(change);
+        file.lastChecksum = columnDigest(stmt, 2, 3);
+        file.isMissing = sqlite3_column_int(stmt, 4) != 0;
+        file.groupId = columnText(stmt, 5);
+        file.fingerprint = columnFingerprint(stmt, 6);
+        file.midstate = columnMidstate(stmt, 11);
+        file.quickFingerprint = columnQuickFingerprint(stmt, 14);
+        indexById[sqlite3_column_int64(stmt, 0)] = files.size();
+        files.push_back(std::move(file));
+    }
+    sqlite3_finalize(stmt);
+
+    // История всех файлов одним запросом вместо запроса на каждый файл
+    const std::string changesSql = "SELECT file_id, timestamp, change_type, checksum, checksum_algorithm, saved_version_id, user, additional_info FROM file_changes ORDER BY file_id, timestamp ASC, id ASC;";
+    sqlite3_stmt* changesStmt;
+    if (sqlite3_prepare_v2(db, changesSql.c_str(), -1, &changesStmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка подготовки запроса к file_changes");
+    }
+
+    while (sqlite3_step(changesStmt) == SQLITE_ROW) {
+        auto it = indexById.find(sqlite3_column_int64(changesStmt, 0));
+        if (it == indexById.end()) {
+            continue;
         }
 
-        sqlite3_finalize(changesStmt);
-        files.push_back(file);
+        FileChange change;
+        change.timestamp = fromIsoString(reinterpret_cast<const char*>(sqlite3_column_text(changesStmt, 1)));
+        change.changeType = reinterpret_cast<const char*>(sqlite3_column_text(changesStmt, 2));
+        change.checksum = columnDigest(changesStmt, 3, 4);
+        change.savedVersionId = columnText(changesStmt, 5);
+        change.user = columnText(changesStmt, 6);
+        change.additionalInfo = columnText(changesStmt, 7);
+        files[it->second].history.changes.push_back(std::move(change));
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_finalize(changesStmt);
     return files;
 }
 
 
-void StatePersistenceService::updateTrackingFileChecksum(const std::string& fileId, const std::string& newChecksum) {
-    const std::string sql = "UPDATE tracking_files SET last_checksum = ? WHERE file_id = ?;";
+void StatePersistenceService::updateTrackingFileChecksum(const std::string& fileId, const Digest& newChecksum,
+                                                         const FileFingerprint& fingerprint) {
+    const std::string sql = "UPDATE tracking_files SET last_checksum = ?, checksum_algorithm = ?, st_dev = ?, st_ino = ?, st_size = ?, mtime_ns = ?, ctime_ns = ? WHERE file_id = ?;";
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
-    sqlite3_bind_text(stmt, 1, newChecksum.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, fileId.c_str(), -1, SQLITE_TRANSIENT);
+    bindDigest(stmt, 1, 2, newChecksum);
+    bindFingerprint(stmt, 3, fingerprint);
+    sqlite3_bind_text(stmt, 8, fileId.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 }
 
+void StatePersistenceService::updateTrackingFileFingerprint(const std::string& fileId, const FileFingerprint& fingerprint) {
+    const std::string sql = "UPDATE tracking_files SET st_dev = ?, st_ino = ?, st_size = ?, mtime_ns = ?, ctime_ns = ? WHERE file_id = ?;";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    bindFingerprint(stmt, 1, fingerprint);
+    sqlite3_bind_text(stmt, 6, fileId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+void StatePersistenceService::updateTrackingFileMidstate(const std::string& fileId, const HashMidstate& midstate) {
+    const std::string sql = "UPDATE tracking_files SET hash_state = ?, hash_offset = ?, hash_anchor = ? WHERE file_id = ?;";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    bindMidstate(stmt, 1, midstate);
+    sqlite3_bind_text(stmt, 4, fileId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+void StatePersistenceService::updateTrackingFileQuickFingerprint(const std::string& fileId, const QuickFingerprint& quick) {
+    const std::string sql = "UPDATE tracking_files SET quick_size = ?, quick_sample = ? WHERE file_id = ?;";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    bindQuickFingerprint(stmt, 1, quick);
+    sqlite3_bind_text(stmt, 3, fileId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+uint64_t StatePersistenceService::nextVerificationRound() {
+    execute("INSERT INTO daemon_state (key, value) VALUES ('verification_round', 1) "
+            "ON CONFLICT(key) DO UPDATE SET value = value + 1;");
+
+    const std::string sql = "SELECT value FROM daemon_state WHERE key = 'verification_round';";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    uint64_t round = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        round = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return round;
+}
+
+std::vector<StoredChange> StatePersistenceService::loadChangesForRetention() {
+    const std::string sql = "SELECT c.id, c.file_id, t.group_id, c.timestamp, c.saved_version_id FROM file_changes c "
+                            "JOIN tracking_files t ON t.file_id = c.file_id ORDER BY c.file_id, c.timestamp ASC, c.id ASC;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка подготовки запроса к file_changes");
+    }
+    std::vector<StoredChange> changes;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        StoredChange change;
+        change.id = sqlite3_column_int64(stmt, 0);
+        change.fileId = columnText(stmt, 1);
+        change.groupId = columnText(stmt, 2);
+        change.timestamp = fromIsoString(columnText(stmt, 3));
+        change.versionId = columnText(stmt, 4);
+        changes.push_back(std::move(change));
+    }
+    sqlite3_finalize(stmt);
+    return changes;
+}
+
+void StatePersistenceService::deleteFileChanges(const std::vector<int64_t>& ids) {
+    const std::string sql = "DELETE FROM file_changes WHERE id = ?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка подготовки удаления из file_changes");
+    }
+    try {
+        beginTransaction();
+    } catch (...) {
+        sqlite3_finalize(stmt);
+        throw;
+    }
+    for (int64_t id : ids) {
+        sqlite3_bind_int64(stmt, 1, id);
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            sqlite3_finalize(stmt);
+            execute("ROLLBACK;");
+            throw std::runtime_error("Ошибка удаления из file_changes: " + std::string(sqlite3_errmsg(db)));
+        }
+    }
+    sqlite3_finalize(stmt);
+    commitTransaction();
+}
+
+std::unordered_set<std::string> StatePersistenceService::referencedVersions() {
+    const std::string sql = "SELECT DISTINCT saved_version_id FROM file_changes WHERE saved_version_id IS NOT NULL;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка подготовки запроса к file_changes");
+    }
+    std::unordered_set<std::string> versions;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string versionId = columnText(stmt, 0);
+        if (!versionId.empty()) {
+            versions.insert(std::move(versionId));
+        }
+    }
+    sqlite3_finalize(stmt);
+    return versions;
+}
+
+int64_t StatePersistenceService::pragmaValue(const std::string& name) {
+    const std::string sql = "PRAGMA " + name + ";";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    int64_t value = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+uint64_t StatePersistenceService::compact(uint32_t pages) {
+    int64_t freeBefore = pragmaValue("freelist_count");
+    if (freeBefore == 0) {
+        return 0;
+    }
+    if (pragmaValue("auto_vacuum") != 2) {
+        // База создана без incremental: один полный VACUUM, когда свободна заметная часть,
+        // заодно переключает её в incremental
+        if (freeBefore * 4 < pragmaValue("page_count")) {
+            return 0;
+        }
+        execute("PRAGMA auto_vacuum = INCREMENTAL;");
+        execute("VACUUM;");
+        return static_cast<uint64_t>(freeBefore);
+    }
+    execute("PRAGMA incremental_vacuum(" + std::to_string(pages) + ");");
+    return static_cast<uint64_t>(std::max<int64_t>(0, freeBefore - pragmaValue("freelist_count")));
+}
+
+std::vector<RecordedVersion> StatePersistenceService::recordedVersionsAfter(const std::string& after, size_t limit) {
+    // Сумма — из любой записи версии: содержимое у них одно
+    const std::string sql = "SELECT saved_version_id, checksum, checksum_algorithm FROM file_changes "
+                            "WHERE saved_version_id > ? GROUP BY saved_version_id ORDER BY saved_version_id LIMIT ?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка подготовки запроса к file_changes");
+    }
+    sqlite3_bind_text(stmt, 1, after.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(limit));
+    std::vector<RecordedVersion> versions;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        versions.push_back({columnText(stmt, 0), columnDigest(stmt, 1, 2)});
+    }
+    sqlite3_finalize(stmt);
+    return versions;
+}
+
+bool StatePersistenceService::isVersionReferenced(const std::string& versionId) {
+    const std::string sql = "SELECT 1 FROM file_changes WHERE saved_version_id = ? LIMIT 1;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка подготовки запроса к file_changes");
+    }
+    sqlite3_bind_text(stmt, 1, versionId.c_str(), -1, SQLITE_TRANSIENT);
+    bool referenced = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return referenced;
+}
+
+std::vector<VersionAt> StatePersistenceService::loadVersionsAt(const std::string& groupId,
+                                                               std::chrono::system_clock::time_point at) {
+    // Время хранится строкой ISO в UTC с точностью до секунды — строки сравниваются как время
+    const std::string sql = "SELECT t.file_id, t.file_path, t.last_checksum, t.checksum_algorithm, t.is_missing, "
+                            "t.st_dev, t.st_ino, t.st_size, t.mtime_ns, t.ctime_ns, c.id, c.timestamp, c.change_type, "
+                            "c.checksum, c.checksum_algorithm, c.saved_version_id, c.user, c.additional_info "
+                            "FROM tracking_files t LEFT JOIN file_changes c ON c.id = ("
+                            "SELECT id FROM file_changes WHERE file_id = t.file_id AND timestamp <= ? "
+                            "ORDER BY timestamp DESC, id DESC LIMIT 1) "
+                            "WHERE t.group_id = ? ORDER BY t.file_path;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка подготовки запроса к file_changes");
+    }
+    std::string ts = toIsoString(at);
+    sqlite3_bind_text(stmt, 1, ts.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, groupId.c_str(), -1, SQLITE_TRANSIENT);
+    std::vector<VersionAt> versions;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        VersionAt version;
+        version.fileId = columnText(stmt, 0);
+        version.filePath = columnText(stmt, 1);
+        version.lastChecksum = columnDigest(stmt, 2, 3);
+        version.isMissing = sqlite3_column_int(stmt, 4) != 0;
+        version.fingerprint = columnFingerprint(stmt, 5);
+        version.found = sqlite3_column_type(stmt, 10) != SQLITE_NULL;
+        if (version.found) {
+            version.change.timestamp = fromIsoString(columnText(stmt, 11));
+            version.change.changeType = columnText(stmt, 12);
+            version.change.checksum = columnDigest(stmt, 13, 14);
+            version.change.savedVersionId = columnText(stmt, 15);
+            version.change.user = columnText(stmt, 16);
+            version.change.additionalInfo = columnText(stmt, 17);
+        }
+        versions.push_back(std::move(version));
+    }
+    sqlite3_finalize(stmt);
+    return versions;
+}
+
+ScrubState StatePersistenceService::loadScrubState() {
+    const std::string sql = "SELECT cursor, round_started FROM scrub_state WHERE id = 1;";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    ScrubState state;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        state.cursor = columnText(stmt, 0);
+        state.roundStarted = sqlite3_column_int64(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    return state;
+}
+
+void StatePersistenceService::saveScrubState(const ScrubState& state) {
+    const std::string sql = "INSERT OR REPLACE INTO scrub_state (id, cursor, round_started) VALUES (1, ?, ?);";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Ошибка подготовки записи в scrub_state");
+    }
+    sqlite3_bind_text(stmt, 1, state.cursor.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, state.roundStarted);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Ошибка записи в scrub_state: " + std::string(sqlite3_errmsg(db)));
+    }
+}
+
+void StatePersistenceService::beginTransaction() {
+    execute("BEGIN;");
+}
+
+void StatePersistenceService::commitTransaction() {
+    execute("COMMIT;");
+}
+
+void StatePersistenceService::rollbackTransaction() {
+    execute("ROLLBACK;");
+}
+
 void StatePersistenceService::updateTrackingFileMissing(const std::string& fileId, bool isMissing) {
     const std::string sql = "UPDATE tracking_files SET is_missing = ? WHERE file_id = ?;";
     sqlite3_stmt* stmt;
@@ -182,4 +617,14 @@ void StatePersistenceService::updateTrackingFileMissing(const std::string& fileI
     sqlite3_bind_text(stmt, 2, fileId.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+}
+
+void StatePersistenceService::updateTrackingFileGroup(const std::string& fileId, const std::string& groupId) {
+    const std::string sql = "UPDATE tracking_files SET group_id = ? WHERE file_id = ?;";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    sqlite3_bind_text(stmt, 1, groupId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, fileId.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
 }
\ No newline at end of file
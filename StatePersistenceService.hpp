@@ -1,10 +1,44 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <unordered_set>
 #include <vector>
 #include <sqlite3.h>
+#include "Digest.hpp"
 #include "TrackingFile.hpp"
 
+// Запись истории для правил хранения (GarbageCollector)
+struct StoredChange {
+    int64_t id = 0;
+    std::string fileId;
+    std::string groupId;
+    std::chrono::system_clock::time_point timestamp;
+    std::string versionId;
+};
+
+// Положение фоновой проверки хранилища (VaultScrubber), переживает перезапуск
+struct ScrubState {
+    std::string cursor;           // "" — проход не начат, "v:<id>" — проверены версии до id, "c:<id>" — фрагменты
+    int64_t roundStarted = 0;     // начало последнего прохода, секунды Unix
+};
+
+// Версия из истории и записанная при сохранении сумма файла
+struct RecordedVersion {
+    std::string versionId;
+    Digest checksum;
+};
+
+// Файл группы и его версия на момент восстановления (RestoreEngine)
+struct VersionAt {
+    std::string fileId;
+    std::string filePath;
+    Digest lastChecksum;          // текущее состояние файла по базе
+    FileFingerprint fingerprint;
+    bool isMissing = false;
+    bool found = false;           // false — к этому моменту у файла не было ни одной записи истории
+    FileChange change;            // последняя запись истории не позже момента восстановления
+};
 
 class StatePersistenceService {
 public:
@@ -14,17 +48,57 @@ public:
     void createTrackingFile(TrackingFile& file);
     void saveTrackingFile(const TrackingFile& file);
     void saveFileChange(const std::string& fileId, const FileChange& change);
-    void updateTrackingFileChecksum(const std::string& fileId, const std::string& newChecksum);
+    void updateTrackingFileChecksum(const std::string& fileId, const Digest& newChecksum,
+                                    const FileFingerprint& fingerprint);
+    void updateTrackingFileFingerprint(const std::string& fileId, const FileFingerprint& fingerprint);
+    void updateTrackingFileMidstate(const std::string& fileId, const HashMidstate& midstate);
+    void updateTrackingFileQuickFingerprint(const std::string& fileId, const QuickFingerprint& quick);
     void updateTrackingFileMissing(const std::string& fileId, bool isMissing);
+    void updateTrackingFileGroup(const std::string& fileId, const std::string& groupId);
 
     std::vector<TrackingFile> loadTrackedFiles(); // Восстановление состояния
 
+    // Номер очередной полной перепроверки (растёт с каждым запуском/перезагрузкой конфигурации)
+    uint64_t nextVerificationRound();
+
+    void beginTransaction();
+    void commitTransaction();
+    void rollbackTransaction();
+
+    // История всех файлов по порядку (файл, время) с группой файла
+    std::vector<StoredChange> loadChangesForRetention();
+    // Удаляет записи истории одной транзакцией
+    void deleteFileChanges(const std::vector<int64_t>& ids);
+    // Версии, на которые ссылается история
+    std::unordered_set<std::string> referencedVersions();
+    // Возвращает базе до pages свободных страниц; возвращает, сколько освобождено
+    uint64_t compact(uint32_t pages);
+
+    // Версии из истории с идентификатором больше after, по возрастанию, не больше limit
+    std::vector<RecordedVersion> recordedVersionsAfter(const std::string& after, size_t limit);
+    bool isVersionReferenced(const std::string& versionId);
+    // Файлы группы по пути и для каждого — последняя запись истории с timestamp <= at
+    std::vector<VersionAt> loadVersionsAt(const std::string& groupId, std::chrono::system_clock::time_point at);
+    ScrubState loadScrubState();
+    void saveScrubState(const ScrubState& state);
+
     ~StatePersistenceService();
 
 private:
     std::string toIsoString(const std::chrono::system_clock::time_point& tp);
     std::chrono::system_clock::time_point fromIsoString(const std::string& str);
     void execute(const std::string& sql);
+    int64_t pragmaValue(const std::string& name);
+    void ensureColumn(const std::string& table, const std::string& column, const std::string& definition);
+    static std::string columnText(sqlite3_stmt* stmt, int column);
+    static void bindDigest(sqlite3_stmt* stmt, int checksumIndex, int algorithmIndex, const Digest& digest);
+    static Digest columnDigest(sqlite3_stmt* stmt, int checksumColumn, int algorithmColumn);
+    static void bindFingerprint(sqlite3_stmt* stmt, int firstIndex, const FileFingerprint& fingerprint);
+    static FileFingerprint columnFingerprint(sqlite3_stmt* stmt, int firstColumn);
+    static void bindMidstate(sqlite3_stmt* stmt, int firstIndex, const HashMidstate& midstate);
+    static HashMidstate columnMidstate(sqlite3_stmt* stmt, int firstColumn);
+    static void bindQuickFingerprint(sqlite3_stmt* stmt, int firstIndex, const QuickFingerprint& quick);
+    static QuickFingerprint columnQuickFingerprint(sqlite3_stmt* stmt, int firstColumn);
 
 
     sqlite3* db;
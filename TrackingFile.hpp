@@ -4,12 +4,16 @@
 #include <list>
 #include <chrono>
 #include <uuid/uuid.h>
+#include "Digest.hpp"
+#include "FileFingerprint.hpp"
+#include "HashMidstate.hpp"
+#include "QuickFingerprint.hpp"
 
 struct FileChange
 {
     std::chrono::system_clock::time_point timestamp; 
     std::string changeType;                          
-    std::string checksum;                            
+    Digest checksum;                                 
     std::string savedVersionId;                      
     std::string user;                                
     std::string additionalInfo;                      
@@ -24,13 +28,21 @@ struct TrackingFile
 {
     std::string filePath;      
     std::string fileId;        
+    std::string groupId;       
     FileHistory history;       
-    std::string lastChecksum;  
+    Digest lastChecksum;       
+    FileFingerprint fingerprint; // метаданные на момент вычисления lastChecksum
+    HashMidstate midstate;       // состояние хеша для групп с append_only
+    QuickFingerprint quickFingerprint; // быстрый слепок содержимого, соответствующего lastChecksum (quick_check)
     bool isMissing = false;    
 };
 
 
 
-bool rollbackTo(const FileChange& change);
+class VaultService;
 
-bool rollbackToVersion(const std::string& versionId);
+// Возвращают файл к версии из его истории; реализованы в RestoreEngine.cpp.
+// false — у записи нет версии или её нет в хранилище
+bool rollbackTo(const VaultService& vault, const TrackingFile& file, const FileChange& change);
+
+bool rollbackToVersion(const VaultService& vault, const TrackingFile& file, const std::string& versionId);
@@ -0,0 +1,350 @@
+// VaultCompression.cpp
+#include "VaultCompression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace {
+
+constexpr char kMagic[4] = {'F', 'V', 'Z', '1'};
+constexpr size_t kHeaderSize = 8;
+
+// Формат блока LZ4: последовательности <токен> [длина литералов] литералы <смещение u16> [длина совпадения];
+// последние 5 байт — всегда литералы, последнее совпадение начинается не ближе 12 байт к концу
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMatchFindLimit = 12;
+constexpr unsigned kHashBits = 16;
+constexpr size_t kMaxOffset = 65535;
+
+uint32_t read32(const unsigned char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint32_t hash4(uint32_t value) {
+    return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+// Дописывает длину в продолжении токена (байты 255 и остаток)
+bool putLength(unsigned char*& out, const unsigned char* end, size_t length) {
+    while (length >= 255) {
+        if (out >= end) return false;
+        *out++ = 255;
+        length -= 255;
+    }
+    if (out >= end) return false;
+    *out++ = static_cast<unsigned char>(length);
+    return true;
+}
+
+bool putSequence(unsigned char*& out, const unsigned char* end, const unsigned char* literals, size_t literalLength,
+                 size_t offset, size_t matchLength, bool last) {
+    if (out >= end) return false;
+    unsigned char* token = out++;
+    *token = static_cast<unsigned char>(std::min<size_t>(literalLength, 15) << 4);
+    if (literalLength >= 15 && !putLength(out, end, literalLength - 15)) return false;
+    if (static_cast<size_t>(end - out) < literalLength) return false;
+    std::memcpy(out, literals, literalLength);
+    out += literalLength;
+    if (last) return true;
+
+    if (end - out < 2) return false;
+    *out++ = static_cast<unsigned char>(offset);
+    *out++ = static_cast<unsigned char>(offset >> 8);
+    size_t extra = matchLength - kMinMatch;
+    *token |= static_cast<unsigned char>(std::min<size_t>(extra, 15));
+    return extra < 15 || putLength(out, end, extra - 15);
+}
+
+// Жадное сжатие с хеш-таблицей по 4 байтам; 0 — результат не помещается в capacity
+size_t lz4Compress(const unsigned char* source, size_t size, unsigned char* destination, size_t capacity,
+                   std::vector<uint32_t>& table) {
+    unsigned char* out = destination;
+    const unsigned char* end = destination + capacity;
+    size_t anchor = 0;
+
+    if (size > kMatchFindLimit) {
+        table.assign(size_t(1) << kHashBits, 0);  // позиция + 1, 0 — пусто
+        size_t matchLimit = size - kLastLiterals;
+        size_t position = 0;
+        size_t misses = 0;
+        while (position + kMatchFindLimit < size) {
+            uint32_t sequence = read32(source + position);
+            uint32_t& slot = table[hash4(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(position + 1);
+            if (candidate == 0 || position - (candidate - 1) > kMaxOffset || read32(source + candidate - 1) != sequence) {
+                // На несжимаемых участках шаг растёт
+                position += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            size_t reference = candidate - 1;
+            while (position > anchor && reference > 0 && source[position - 1] == source[reference - 1]) {
+                --position;
+                --reference;
+            }
+            size_t length = kMinMatch;
+            while (position + length < matchLimit && source[position + length] == source[reference + length]) {
+                ++length;
+            }
+            if (!putSequence(out, end, source + anchor, position - anchor, position - reference, length, false)) {
+                return 0;
+            }
+            position += length;
+            anchor = position;
+        }
+    }
+    if (!putSequence(out, end, source + anchor, size - anchor, 0, 0, true)) {
+        return 0;
+    }
+    return static_cast<size_t>(out - destination);
+}
+
+bool lz4Decompress(const unsigned char* source, size_t size, unsigned char* destination, size_t rawSize) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        unsigned token = source[in++];
+        size_t literalLength = token >> 4;
+        if (literalLength == 15) {
+            unsigned char byte;
+            do {
+                if (in >= size) return false;
+                byte = source[in++];
+                literalLength += byte;
+            } while (byte == 255);
+        }
+        if (literalLength > size - in || literalLength > rawSize - out) return false;
+        std::memcpy(destination + out, source + in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        if (in == size) {
+            break;
+        }
+
+        if (size - in < 2) return false;
+        size_t offset = source[in] | (static_cast<size_t>(source[in + 1]) << 8);
+        in += 2;
+        if (offset == 0 || offset > out) return false;
+        size_t matchLength = token & 15;
+        if (matchLength == 15) {
+            unsigned char byte;
+            do {
+                if (in >= size) return false;
+                byte = source[in++];
+                matchLength += byte;
+            } while (byte == 255);
+        }
+        matchLength += kMinMatch;
+        if (matchLength > rawSize - out) return false;
+        unsigned char* target = destination + out;
+        const unsigned char* match = target - offset;
+        if (offset >= matchLength) {
+            std::memcpy(target, match, matchLength);
+        } else {
+            // Перекрывающееся совпадение повторяет последние offset байт
+            for (size_t i = 0; i < matchLength; ++i) {
+                target[i] = match[i];
+            }
+        }
+        out += matchLength;
+    }
+    return out == rawSize;
+}
+
+void putU32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+uint32_t getU32(const unsigned char* in) {
+    return in[0] | (static_cast<uint32_t>(in[1]) << 8) | (static_cast<uint32_t>(in[2]) << 16) |
+           (static_cast<uint32_t>(in[3]) << 24);
+}
+
+} // namespace
+
+VaultCompression parseVaultCompression(const std::string& name) {
+    if (name == "none") return VaultCompression::None;
+    if (name == "lz4") return VaultCompression::Lz4;
+    if (name == "zlib") return VaultCompression::Zlib;
+    throw std::invalid_argument("Неизвестный способ сжатия: " + name);
+}
+
+VaultCompressor::VaultCompressor(VaultCompression codec, int level, Sink sink)
+    : codec(codec), level(level), sink(std::move(sink)) {
+    block.reserve(kBlockSize);
+}
+
+bool VaultCompressor::looksCompressible(const unsigned char* data, size_t size) {
+    // 16 участков по 256 байт по всему блоку
+    constexpr size_t kSamples = 16;
+    constexpr size_t kSampleSize = 256;
+    if (size < kSamples * kSampleSize) {
+        return true;
+    }
+    uint32_t histogram[256] = {};
+    size_t stride = size / kSamples;
+    for (size_t sample = 0; sample < kSamples; ++sample) {
+        const unsigned char* part = data + sample * stride;
+        for (size_t i = 0; i < kSampleSize; ++i) {
+            ++histogram[part[i]];
+        }
+    }
+    double total = kSamples * kSampleSize;
+    double entropy = 0;
+    for (uint32_t count : histogram) {
+        if (count > 0) {
+            double p = count / total;
+            entropy -= p * std::log2(p);
+        }
+    }
+    // По 4096 байтам энтропия случайных данных оценивается примерно в 7.95 бит
+    return entropy < 7.5;
+}
+
+void VaultCompressor::update(const unsigned char* data, size_t size) {
+    while (size > 0) {
+        if (block.empty() && size >= kBlockSize) {
+            // Целый блок во входных данных — без копирования
+            flushBlock(data, kBlockSize);
+            data += kBlockSize;
+            size -= kBlockSize;
+            continue;
+        }
+        size_t part = std::min(size, kBlockSize - block.size());
+        block.insert(block.end(), data, data + part);
+        data += part;
+        size -= part;
+        if (block.size() == kBlockSize) {
+            flushBlock(block.data(), block.size());
+            block.clear();
+        }
+    }
+}
+
+void VaultCompressor::finish() {
+    if (!block.empty()) {
+        flushBlock(block.data(), block.size());
+        block.clear();
+    }
+    if (!started) {
+        flushBlock(nullptr, 0);
+    }
+    unsigned char terminator[4] = {};
+    output(terminator, sizeof(terminator));
+}
+
+void VaultCompressor::flushBlock(const unsigned char* data, size_t size) {
+    if (!started) {
+        unsigned char header[kHeaderSize] = {};
+        std::memcpy(header, kMagic, sizeof(kMagic));
+        header[4] = static_cast<unsigned char>(codec);
+        output(header, sizeof(header));
+        started = true;
+    }
+    if (size == 0) {
+        return;
+    }
+
+    size_t length = 0;
+    if (codec != VaultCompression::None && looksCompressible(data, size)) {
+        if (codec == VaultCompression::Lz4) {
+            compressed.resize(size);
+            static thread_local std::vector<uint32_t> table;
+            length = lz4Compress(data, size, compressed.data(), compressed.size(), table);
+        } else {
+            uLongf capacity = compressBound(static_cast<uLong>(size));
+            compressed.resize(capacity);
+            if (compress2(compressed.data(), &capacity, data, static_cast<uLong>(size), level) == Z_OK) {
+                length = capacity;
+            }
+        }
+    } else if (codec != VaultCompression::None) {
+        ++skipped;
+    }
+
+    unsigned char lengths[8];
+    putU32(lengths, static_cast<uint32_t>(size));
+    if (length > 0 && length < size) {
+        putU32(lengths + 4, static_cast<uint32_t>(length));
+        output(lengths, sizeof(lengths));
+        output(compressed.data(), length);
+    } else {
+        putU32(lengths + 4, static_cast<uint32_t>(size));
+        output(lengths, sizeof(lengths));
+        output(data, size);
+    }
+}
+
+void VaultCompressor::output(const unsigned char* data, size_t size) {
+    sink(data, size);
+    stored += size;
+}
+
+uint64_t VaultCompressor::decompress(const std::filesystem::path& path, const Sink& sink) {
+    std::ifstream input(path, std::ios::binary);
+    return decompress(input, path.string(), sink);
+}
+
+uint64_t VaultCompressor::decompress(std::istream& input, const std::string& name, const Sink& sink) {
+    unsigned char header[kHeaderSize];
+    if (!input.read(reinterpret_cast<char*>(header), sizeof(header)) || std::memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Файл хранилища не является сжатой версией: " + name);
+    }
+    auto codec = static_cast<VaultCompression>(header[4]);
+    if (codec != VaultCompression::None && codec != VaultCompression::Lz4 && codec != VaultCompression::Zlib) {
+        throw std::runtime_error("Неизвестный способ сжатия в " + name);
+    }
+
+    std::vector<unsigned char> storedBlock;
+    std::vector<unsigned char> rawBlock;
+    uint64_t total = 0;
+    while (true) {
+        unsigned char lengths[4];
+        if (!input.read(reinterpret_cast<char*>(lengths), sizeof(lengths))) {
+            throw std::runtime_error("Сжатая версия обрывается: " + name);
+        }
+        uint32_t rawLength = getU32(lengths);
+        if (rawLength == 0) {
+            break;
+        }
+        if (!input.read(reinterpret_cast<char*>(lengths), sizeof(lengths))) {
+            throw std::runtime_error("Сжатая версия обрывается: " + name);
+        }
+        uint32_t storedLength = getU32(lengths);
+        if (rawLength > kBlockSize || storedLength > rawLength) {
+            throw std::runtime_error("Повреждена сжатая версия " + name);
+        }
+        storedBlock.resize(storedLength);
+        if (!input.read(reinterpret_cast<char*>(storedBlock.data()), storedLength)) {
+            throw std::runtime_error("Сжатая версия обрывается: " + name);
+        }
+
+        if (storedLength == rawLength) {
+            sink(storedBlock.data(), storedLength);
+        } else {
+            rawBlock.resize(rawLength);
+            bool ok = false;
+            if (codec == VaultCompression::Lz4) {
+                ok = lz4Decompress(storedBlock.data(), storedLength, rawBlock.data(), rawLength);
+            } else if (codec == VaultCompression::Zlib) {
+                uLongf length = rawLength;
+                ok = uncompress(rawBlock.data(), &length, storedBlock.data(), storedLength) == Z_OK && length == rawLength;
+            }
+            if (!ok) {
+                throw std::runtime_error("Повреждена сжатая версия " + name);
+            }
+            sink(rawBlock.data(), rawLength);
+        }
+        total += rawLength;
+    }
+    return total;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+enum class VaultCompression {
+    None,
+    Lz4,   // быстрое сжатие (формат блока LZ4)
+    Zlib   // сильнее, но медленнее (deflate)
+};
+
+// Бросает std::invalid_argument для неизвестного имени
+VaultCompression parseVaultCompression(const std::string& name);
+
+// Потоковое сжатие файла хранилища. Данные режутся на блоки kBlockSize, каждый сжимается
+// независимо; формат: "FVZ1", байт кодека, три нулевых байта, затем блоки
+// <u32 исходная длина> <u32 длина в файле> <данные> и завершающий <u32 0>.
+// Блок, который не сжался (или по оценке энтропии выглядит уже сжатым — архивы, медиа),
+// хранится как есть: длина в файле равна исходной.
+class VaultCompressor {
+public:
+    using Sink = std::function<void(const unsigned char* data, size_t size)>;
+
+    static constexpr size_t kBlockSize = 256 * 1024;
+
+    // level — уровень zlib (1–9), для LZ4 не используется
+    VaultCompressor(VaultCompression codec, int level, Sink sink);
+
+    void update(const unsigned char* data, size_t size);
+    void finish();
+
+    uint64_t storedSize() const { return stored; }
+    size_t skippedBlocks() const { return skipped; } // блоков, сохранённых без сжатия по оценке энтропии
+
+    // Распаковывает файл хранилища в sink; возвращает исходный размер
+    static uint64_t decompress(const std::filesystem::path& path, const Sink& sink);
+    // То же для кадра из потока (например, записи пакета); name — для сообщений об ошибках
+    static uint64_t decompress(std::istream& input, const std::string& name, const Sink& sink);
+
+    // Грубая оценка по выборке: данные с энтропией около 8 бит на байт сжимать бесполезно
+    static bool looksCompressible(const unsigned char* data, size_t size);
+
+private:
+    void flushBlock(const unsigned char* data, size_t size);
+    void output(const unsigned char* data, size_t size);
+
+    VaultCompression codec;
+    int level;
+    Sink sink;
+    std::vector<unsigned char> block;
+    std::vector<unsigned char> compressed;
+    uint64_t stored = 0;
+    size_t skipped = 0;
+    bool started = false;
+};
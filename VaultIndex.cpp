@@ -0,0 +1,431 @@
+// VaultIndex.cpp
+#include "VaultIndex.hpp"
+#include "ChecksumAlgorithms.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr unsigned char kIndexMagic[8] = {'F', 'V', 'X', '1', 0, 0, 0, 0};
+constexpr size_t kHeaderSize = sizeof(kIndexMagic) + 4 + 4 + 8;
+constexpr size_t kNameSize = 8;
+constexpr size_t kDirectorySize = kNameSize + 8;
+constexpr size_t kKeySize = 32;     // VaultIndex::Key
+constexpr size_t kEntrySize = kKeySize + 4;
+constexpr size_t kShardPrefix = 4;         // как в VaultLayout: имя версии не короче двух уровней
+constexpr size_t kScanBatch = 64;          // каталогов на задачу пула
+constexpr size_t kFilterBitsPerKey = 16;
+constexpr int kFilterHashes = 5;           // ложных срабатываний около 0,1 %
+
+void putU32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+void putU64(unsigned char* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+uint32_t getU32(const unsigned char* in) {
+    return uint32_t(in[0]) | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16 | uint32_t(in[3]) << 24;
+}
+
+uint64_t getU64(const unsigned char* in) {
+    return uint64_t(getU32(in)) | uint64_t(getU32(in + 4)) << 32;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+using Key = std::array<unsigned char, kKeySize>;
+
+Key indexKey(const std::string& versionId) {
+    Key key{};
+    bool hex = versionId.size() == 2 * kKeySize;
+    for (size_t i = 0; hex && i < kKeySize; ++i) {
+        int high = hexValue(versionId[2 * i]);
+        int low = hexValue(versionId[2 * i + 1]);
+        hex = high >= 0 && low >= 0;
+        key[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+    if (!hex) {
+        Sha256Policy::Context context;
+        Sha256Policy::init(context);
+        Sha256Policy::update(context, reinterpret_cast<const unsigned char*>(versionId.data()), versionId.size());
+        Sha256Policy::final(context, key.data());
+    }
+    return key;
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Каталог хранилища при открытии индекса
+struct Scan {
+    std::string name;
+    size_t slot = SIZE_MAX;           // номер в записанном индексе
+    bool holdsDirectories = false;    // корень и <ab>
+    bool holdsObjects = false;        // корень (плоская раскладка) и <ab>/<cd>
+    bool present = true;
+    bool rescanned = false;
+    int64_t mtimeNs = 0;
+    std::vector<std::string> children;
+    std::vector<Key> keys;
+};
+
+void scanDirectory(const std::filesystem::path& root, Scan& scan, int64_t recordedMtimeNs,
+                   const std::vector<std::string>& recordedChildren) {
+    std::filesystem::path directory = scan.name.empty() ? root : root / scan.name;
+    struct stat info {};
+    if (stat(directory.c_str(), &info) != 0) {
+        scan.present = false;
+        return;
+    }
+    int64_t mtimeNs = static_cast<int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec;
+    if (recordedMtimeNs != 0 && recordedMtimeNs == mtimeNs) {
+        scan.mtimeNs = mtimeNs;
+        scan.children = recordedChildren;
+        return;
+    }
+    // mtime снят до чтения: изменение по ходу чтения даст другое mtime при следующем открытии
+    scan.rescanned = true;
+    scan.mtimeNs = nowNs() - mtimeNs < VaultIndex::kRacyWindowNs ? 0 : mtimeNs;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        std::string name = it->path().filename().string();
+        if (name.empty() || name[0] == '.') {
+            continue;   // временные файлы
+        }
+        std::error_code typeError;
+        if (scan.holdsDirectories && name.size() == 2 && it->is_directory(typeError)) {
+            scan.children.push_back(name);
+        } else if (scan.holdsObjects && it->is_regular_file(typeError)) {
+            std::string id = name.substr(0, name.find('.'));
+            if (id.size() >= kShardPrefix) {
+                scan.keys.push_back(indexKey(id));
+            }
+        }
+    }
+    if (error) {
+        scan.mtimeNs = 0;   // прочитано не всё
+    }
+}
+
+void scanAll(ThreadPool& pool, const std::filesystem::path& root, std::vector<Scan>& scans,
+             const std::vector<int64_t>& recordedMtimes,
+             const std::unordered_map<std::string, std::vector<std::string>>& recordedChildren) {
+    static const std::vector<std::string> none;
+    std::vector<std::future<void>> batches;
+    for (size_t first = 0; first < scans.size(); first += kScanBatch) {
+        batches.push_back(pool.submit([&, first]() {
+            for (size_t i = first; i < std::min(first + kScanBatch, scans.size()); ++i) {
+                Scan& scan = scans[i];
+                auto children = recordedChildren.find(scan.name);
+                scanDirectory(root, scan, scan.slot == SIZE_MAX ? 0 : recordedMtimes[scan.slot],
+                              children == recordedChildren.end() ? none : children->second);
+            }
+        }));
+    }
+    for (auto& batch : batches) {
+        batch.get();
+    }
+}
+
+void writeAll(int fd, const unsigned char* data, size_t size, const std::filesystem::path& path) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Ошибка записи индекса " + path.string() + ": " + std::strerror(errno));
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+} // namespace
+
+VaultIndex::VaultIndex(const VaultLayout& layout) : layout(layout), path(layout.root() / "index" / "versions") {
+    auto started = std::chrono::steady_clock::now();
+    std::filesystem::create_directories(path.parent_path());
+    open();
+    buildFilter();
+    stats.versions = count;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+VaultIndex::~VaultIndex() {
+    unmap();
+}
+
+bool VaultIndex::mapFile(std::vector<Directory>& directories) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info {};
+    fstat(fd, &info);
+    size_t length = static_cast<size_t>(info.st_size);
+    void* address = length >= kHeaderSize ? mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    auto bytes = static_cast<const unsigned char*>(address);
+    uint64_t directoryCount = getU32(bytes + sizeof(kIndexMagic));
+    uint64_t entryCount = getU64(bytes + sizeof(kIndexMagic) + 8);
+    if (std::memcmp(bytes, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+        length != kHeaderSize + directoryCount * kDirectorySize + entryCount * kEntrySize) {
+        munmap(address, length);
+        return false;   // повреждён или другого формата — перестраивается целиком
+    }
+    directories.clear();
+    for (uint64_t i = 0; i < directoryCount; ++i) {
+        const unsigned char* item = bytes + kHeaderSize + i * kDirectorySize;
+        const char* name = reinterpret_cast<const char*>(item);
+        directories.push_back({std::string(name, strnlen(name, kNameSize)),
+                               static_cast<int64_t>(getU64(item + kNameSize))});
+    }
+    mapping = address;
+    mappingLength = length;
+    entries = bytes + kHeaderSize + directoryCount * kDirectorySize;
+    count = static_cast<size_t>(entryCount);
+    return true;
+}
+
+void VaultIndex::unmap() {
+    if (mapping) {
+        munmap(mapping, mappingLength);
+        mapping = nullptr;
+    }
+    entries = nullptr;
+    count = 0;
+}
+
+void VaultIndex::open() {
+    std::vector<Directory> recorded;
+    bool valid = mapFile(recorded);
+    std::vector<int64_t> recordedMtimes;
+    std::unordered_map<std::string, size_t> recordedSlots;
+    std::unordered_map<std::string, std::vector<std::string>> recordedChildren;
+    for (size_t i = 0; i < recorded.size(); ++i) {
+        const std::string& name = recorded[i].name;
+        recordedMtimes.push_back(recorded[i].mtimeNs);
+        recordedSlots[name] = i;
+        if (!name.empty()) {
+            size_t slash = name.rfind('/');
+            std::string parent = slash == std::string::npos ? std::string() : name.substr(0, slash);
+            recordedChildren[parent].push_back(name.substr(slash == std::string::npos ? 0 : slash + 1));
+        }
+    }
+    auto slotOf = [&](const std::string& name) {
+        auto found = recordedSlots.find(name);
+        return found == recordedSlots.end() ? SIZE_MAX : found->second;
+    };
+
+    // Корень, затем <ab>, затем <ab>/<cd>: список каталогов уровня известен, только когда
+    // прочитан (или совпал с записанным) уровень выше
+    ThreadPool pool(kScanThreads);
+    std::vector<Scan> roots(1);
+    roots[0].slot = slotOf("");
+    roots[0].holdsDirectories = true;
+    roots[0].holdsObjects = true;
+    scanAll(pool, layout.root(), roots, recordedMtimes, recordedChildren);
+
+    std::vector<Scan> tops;
+    for (const auto& child : roots[0].children) {
+        Scan scan;
+        scan.name = child;
+        scan.slot = slotOf(child);
+        scan.holdsDirectories = true;
+        tops.push_back(std::move(scan));
+    }
+    scanAll(pool, layout.root(), tops, recordedMtimes, recordedChildren);
+
+    std::vector<Scan> shards;
+    for (const auto& top : tops) {
+        for (const auto& child : top.children) {
+            Scan scan;
+            scan.name = top.name + "/" + child;
+            scan.slot = slotOf(scan.name);
+            scan.holdsObjects = true;
+            shards.push_back(std::move(scan));
+        }
+    }
+    scanAll(pool, layout.root(), shards, recordedMtimes, recordedChildren);
+
+    std::vector<Scan*> directories;
+    for (auto* level : {&roots, &tops, &shards}) {
+        for (auto& scan : *level) {
+            if (scan.present) {
+                directories.push_back(&scan);
+                stats.rescanned += scan.rescanned ? 1 : 0;
+            }
+        }
+    }
+    stats.directories = directories.size();
+    if (valid && stats.rescanned == 0 && directories.size() == recorded.size()) {
+        return;   // ничего не изменилось — записанный индекс верен как есть
+    }
+
+    // Записи неизменившихся каталогов берутся из прежнего индекса, остальные — из прочитанного
+    std::vector<uint32_t> newSlots(recorded.size(), UINT32_MAX);
+    std::vector<std::pair<Key, uint32_t>> items;
+    for (uint32_t slot = 0; slot < directories.size(); ++slot) {
+        const Scan& scan = *directories[slot];
+        if (!scan.rescanned && scan.slot != SIZE_MAX) {
+            newSlots[scan.slot] = slot;
+        }
+        for (const auto& key : scan.keys) {
+            items.emplace_back(key, slot);
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* item = entries + i * kEntrySize;
+        uint32_t slot = getU32(item + kKeySize);
+        if (slot < newSlots.size() && newSlots[slot] != UINT32_MAX) {
+            Key key;
+            std::memcpy(key.data(), item, kKeySize);
+            items.emplace_back(key, newSlots[slot]);
+        }
+    }
+    std::sort(items.begin(), items.end());
+    items.erase(std::unique(items.begin(), items.end()), items.end());
+
+    std::vector<unsigned char> data(kHeaderSize + directories.size() * kDirectorySize + items.size() * kEntrySize);
+    std::memcpy(data.data(), kIndexMagic, sizeof(kIndexMagic));
+    putU32(data.data() + sizeof(kIndexMagic), static_cast<uint32_t>(directories.size()));
+    putU64(data.data() + sizeof(kIndexMagic) + 8, items.size());
+    unsigned char* out = data.data() + kHeaderSize;
+    for (const Scan* scan : directories) {
+        std::memcpy(out, scan->name.data(), std::min(scan->name.size(), kNameSize));
+        putU64(out + kNameSize, static_cast<uint64_t>(scan->mtimeNs));
+        out += kDirectorySize;
+    }
+    for (const auto& [key, slot] : items) {
+        std::memcpy(out, key.data(), kKeySize);
+        putU32(out + kKeySize, slot);
+        out += kEntrySize;
+    }
+    unmap();
+
+    // Индекс — кеш содержимого каталогов: при ошибке записи хранилище работает с индексом в памяти
+    std::string temporary = (path.parent_path() / ".versions.tmp-XXXXXX").string();
+    int fd = mkstemp(temporary.data());
+    try {
+        if (fd < 0) {
+            throw std::runtime_error("Не удалось создать " + temporary + ": " + std::strerror(errno));
+        }
+        writeAll(fd, data.data(), data.size(), temporary);
+        if (fsync(fd) != 0) {
+            throw std::runtime_error("Ошибка записи индекса " + temporary + ": " + std::strerror(errno));
+        }
+        close(fd);
+        fd = -1;
+        std::filesystem::rename(temporary, path);
+        if (mapFile(recorded)) {
+            return;
+        }
+        throw std::runtime_error("Не удалось отобразить индекс " + path.string());
+    } catch (const std::exception& e) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(temporary.c_str());
+        }
+        std::cerr << "  ⚠ Индекс хранилища не записан: " << e.what() << std::endl;
+    }
+    memoryEntries.assign(data.end() - static_cast<std::ptrdiff_t>(items.size() * kEntrySize), data.end());
+    entries = memoryEntries.data();
+    count = items.size();
+}
+
+void VaultIndex::buildFilter() {
+    uint64_t bits = 64;
+    while (bits < count * kFilterBitsPerKey) {
+        bits <<= 1;
+    }
+    filter.assign(bits / 64, 0);
+    filterMask = bits - 1;
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* key = entries + i * kEntrySize;
+        uint64_t hash = getU64(key);
+        uint64_t step = getU64(key + 8) | 1;
+        for (int j = 0; j < kFilterHashes; ++j, hash += step) {
+            filter[(hash & filterMask) / 64] |= uint64_t(1) << (hash & 63);
+        }
+    }
+}
+
+bool VaultIndex::mayContain(const unsigned char* key) const {
+    // Ключ — SHA-256, его слова уже равномерны и годятся как хеши фильтра
+    uint64_t hash = getU64(key);
+    uint64_t step = getU64(key + 8) | 1;
+    for (int j = 0; j < kFilterHashes; ++j, hash += step) {
+        if (!(filter[(hash & filterMask) / 64] & (uint64_t(1) << (hash & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool VaultIndex::search(const unsigned char* key) const {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        int order = std::memcmp(entries + middle * kEntrySize, key, kKeySize);
+        if (order == 0) {
+            return true;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+bool VaultIndex::contains(const std::string& versionId) const {
+    Key key = indexKey(versionId);
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto changed = changes.find(key);
+        if (changed != changes.end()) {
+            return changed->second;
+        }
+    }
+    return count > 0 && mayContain(key.data()) && search(key.data());
+}
+
+void VaultIndex::add(const std::string& versionId) {
+    Key key = indexKey(versionId);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    changes[key] = true;
+}
+
+void VaultIndex::remove(const std::string& versionId) {
+    Key key = indexKey(versionId);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    changes[key] = false;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "VaultLayout.hpp"
+
+// Итог открытия индекса
+struct VaultIndexStats {
+    size_t directories = 0;       // каталогов хранилища с версиями
+    size_t rescanned = 0;         // из них перечитано: изменились с записи индекса
+    size_t versions = 0;          // файлов версий в индексе
+    double seconds = 0;
+};
+
+// Индекс файлов версий хранилища, чтобы проверка существования версии была поиском в памяти,
+// а не stat на каждый суффикс в каждой раскладке. Версии в пакетах сюда не входят — у VaultPack
+// свой индекс. Файл <vault>/index/versions (отдельный каталог — запись индекса не меняет mtime
+// корня): "FVX1", четыре нулевых байта, u32 число каталогов, u32 ноль,
+// u64 число записей; затем каталоги <8 байт имени> <i64 mtime, нс> и отсортированный массив
+// записей <32 байта ключа> <u32 номер каталога>. Ключ — SHA-256 версии в двоичном виде, для старых
+// 8-символьных идентификаторов — SHA-256 самого идентификатора.
+//
+// При открытии индекс сверяется с каталогами (корень, <ab>, <ab>/<cd>): каталог с тем же mtime,
+// что записан, не читается, изменившиеся читаются заново в пуле потоков, и индекс переписывается.
+// mtime каталога, изменённого меньше чем за kRacyWindowNs до чтения, не записывается — такой каталог
+// перечитывается при следующем открытии (mtime грубее, чем промежуток между изменениями).
+//
+// Массив отображается в память; перед двоичным поиском ключ проверяется фильтром Блума, и отсутствующая
+// версия почти всегда отсекается без обращения к массиву. То, что процесс публикует и удаляет после
+// открытия (add, remove), хранится поверх массива в памяти. На диск эти изменения не пишутся: каталоги,
+// в которых они сделаны, изменили mtime и будут перечитаны, поэтому индекс не может пережить сбой
+// с версией, имя которой до диска не дошло. Файлы, удалённые из хранилища в обход VaultService
+// при работающем демоне, индекс замечает только при следующем открытии.
+class VaultIndex {
+public:
+    static constexpr int64_t kRacyWindowNs = 2'000'000'000;
+    static constexpr size_t kScanThreads = 8;
+
+    explicit VaultIndex(const VaultLayout& layout);
+    ~VaultIndex();
+
+    VaultIndex(const VaultIndex&) = delete;
+    VaultIndex& operator=(const VaultIndex&) = delete;
+
+    bool contains(const std::string& versionId) const;
+    // Файл версии опубликован или удалён этим процессом
+    void add(const std::string& versionId);
+    void remove(const std::string& versionId);
+
+    const VaultIndexStats& openStats() const { return stats; }
+
+private:
+    using Key = std::array<unsigned char, 32>;
+
+    // Ключ — SHA-256: первые восемь байт уже равномерны
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t hash;
+            std::memcpy(&hash, key.data(), sizeof(hash));
+            return hash;
+        }
+    };
+
+    struct Directory {
+        std::string name;         // "" — корень, "ab", "ab/cd"
+        int64_t mtimeNs = 0;      // 0 — перечитать при следующем открытии
+    };
+
+    void open();
+    bool mapFile(std::vector<Directory>& directories);
+    void unmap();
+    void buildFilter();
+    bool mayContain(const unsigned char* key) const;
+    bool search(const unsigned char* key) const;
+
+    const VaultLayout& layout;
+    std::filesystem::path path;
+    void* mapping = nullptr;
+    size_t mappingLength = 0;
+    const unsigned char* entries = nullptr;
+    size_t count = 0;
+    std::vector<unsigned char> memoryEntries;   // массив, если записать индекс не удалось
+    std::vector<uint64_t> filter;
+    uint64_t filterMask = 0;                    // число битов фильтра минус один
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<Key, bool, KeyHash> changes;   // ключ → есть ли версия после add/remove
+    VaultIndexStats stats;
+};
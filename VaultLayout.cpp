@@ -0,0 +1,155 @@
+// VaultLayout.cpp
+#include "VaultLayout.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+
+constexpr size_t kShardPrefix = 4;   // два уровня по два символа
+
+// Имя файла плоской раскладки: "<id>" или "<id>.<суффикс>"; временные файлы начинаются с точки
+bool flatObject(const std::filesystem::directory_entry& entry, std::string& id) {
+    std::string name = entry.path().filename().string();
+    if (name.empty() || name[0] == '.' || !entry.is_regular_file()) {
+        return false;
+    }
+    id = name.substr(0, name.find('.'));
+    return id.size() >= kShardPrefix;
+}
+
+bool hasFlatObjects(const std::filesystem::path& directory) {
+    std::error_code error;
+    std::string id;
+    for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        if (flatObject(*it, id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+VaultLayout::VaultLayout(const std::filesystem::path& root)
+    : rootDir(root), chunkDir(root / "chunks"), flat(hasFlatObjects(root) || hasFlatObjects(root / "chunks")) {}
+
+std::filesystem::path VaultLayout::sharded(const std::filesystem::path& base, const std::string& id,
+                                           const char* suffix) const {
+    if (id.size() < kShardPrefix) {
+        return base / (id + suffix);
+    }
+    return base / id.substr(0, 2) / id.substr(2, 2) / (id + suffix);
+}
+
+std::filesystem::path VaultLayout::object(const std::string& id, const char* suffix) const {
+    return sharded(rootDir, id, suffix);
+}
+
+std::filesystem::path VaultLayout::chunk(const std::string& id, const char* suffix) const {
+    return sharded(chunkDir, id, suffix);
+}
+
+std::filesystem::path VaultLayout::find(const std::filesystem::path& base, const std::string& id,
+                                        const char* suffix) const {
+    struct stat info {};
+    if (legacy()) {
+        std::filesystem::path flatPath = base / (id + suffix);
+        if (stat(flatPath.c_str(), &info) == 0) {
+            return flatPath;
+        }
+    }
+    std::filesystem::path path = sharded(base, id, suffix);
+    if (stat(path.c_str(), &info) == 0) {
+        return path;
+    }
+    return std::filesystem::path();
+}
+
+std::filesystem::path VaultLayout::locate(const std::string& id, const char* suffix) const {
+    return find(rootDir, id, suffix);
+}
+
+std::filesystem::path VaultLayout::locateChunk(const std::string& id, const char* suffix) const {
+    return find(chunkDir, id, suffix);
+}
+
+void VaultLayout::prepare(const std::filesystem::path& path) {
+    // Обычно каталог уже есть — один mkdir с EEXIST
+    std::filesystem::path directory = path.parent_path();
+    if (mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST) {
+        return;
+    }
+    if (errno != ENOENT) {
+        throw std::runtime_error("Не удалось создать каталог " + directory.string() + ": " + std::strerror(errno));
+    }
+    std::filesystem::create_directories(directory);
+}
+
+void VaultLayout::scan(const std::filesystem::path& base, const Visitor& visit) const {
+    std::error_code error;
+    std::string id;
+    for (std::filesystem::directory_iterator top(base, error), end; !error && top != end; top.increment(error)) {
+        if (flatObject(*top, id)) {
+            visit(id, top->path());
+            continue;
+        }
+        // Подкаталоги разнесённой раскладки — по два символа (chunks и packs длиннее)
+        if (top->path().filename().string().size() != 2 || !top->is_directory()) {
+            continue;
+        }
+        std::error_code innerError;
+        for (std::filesystem::directory_iterator middle(top->path(), innerError); !innerError && middle != end;
+             middle.increment(innerError)) {
+            std::error_code leafError;
+            for (std::filesystem::directory_iterator leaf(middle->path(), leafError); !leafError && leaf != end;
+                 leaf.increment(leafError)) {
+                if (flatObject(*leaf, id)) {
+                    visit(id, leaf->path());
+                }
+            }
+        }
+    }
+}
+
+void VaultLayout::forEachObject(const Visitor& visit) const {
+    scan(rootDir, visit);
+}
+
+void VaultLayout::forEachChunk(const Visitor& visit) const {
+    scan(chunkDir, visit);
+}
+
+uint64_t VaultLayout::migrateDirectory(const std::filesystem::path& base, uint64_t moved,
+                                       const std::function<void(uint64_t moved)>& progress) {
+    std::string id;
+    // Переименованные по ходу обхода файлы readdir просто не вернёт; новые в плоском каталоге не появляются
+    for (const auto& entry : std::filesystem::directory_iterator(base)) {
+        if (!flatObject(entry, id)) {
+            continue;
+        }
+        std::string name = entry.path().filename().string();
+        std::filesystem::path target = sharded(base, id, name.c_str() + id.size());
+        prepare(target);
+        // Содержимое по одному адресу одинаково: уже записанный в разнесённый каталог файл можно заменить
+        std::filesystem::rename(entry.path(), target);
+        ++moved;
+        if (progress && moved % 10000 == 0) {
+            progress(moved);
+        }
+    }
+    return moved;
+}
+
+uint64_t VaultLayout::migrate(const std::function<void(uint64_t moved)>& progress) {
+    uint64_t moved = migrateDirectory(rootDir, 0, progress);
+    if (std::filesystem::exists(chunkDir)) {
+        moved = migrateDirectory(chunkDir, moved, progress);
+    }
+    if (progress) {
+        progress(moved);
+    }
+    flat = hasFlatObjects(rootDir) || hasFlatObjects(chunkDir);
+    return moved;
+}
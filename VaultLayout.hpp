@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+// Раскладка файлов хранилища по каталогам: версия <id> хранится как <vault>/<ab>/<cd>/<id>[суффикс],
+// фрагмент — как <vault>/chunks/<ab>/<cd>/<id>[.z], где ab и cd — первые два и следующие два символа
+// идентификатора. В одном каталоге остаётся не больше 256 подкаталогов или файлов одной четырёхсимвольной
+// группы, и поиск с созданием не деградируют на миллионах версий, как в одном плоском каталоге.
+//
+// Хранилища, созданные до этого, держат всё в <vault>/ и <vault>/chunks/ напрямую. Пока такие файлы
+// есть, поиск сначала проверяет плоский путь, потом разнесённый. migrate переносит файлы из плоского
+// каталога в разнесённый (rename) и должна идти без других процессов, открывающих хранилище:
+// путь, который locate вернул до переноса, к моменту открытия файла уже не существует.
+// Новые файлы всегда пишутся в разнесённые каталоги.
+class VaultLayout {
+public:
+    explicit VaultLayout(const std::filesystem::path& root);
+
+    const std::filesystem::path& root() const { return rootDir; }
+
+    // Путь для записи версии или фрагмента (каталоги создаёт prepare)
+    std::filesystem::path object(const std::string& id, const char* suffix = "") const;
+    std::filesystem::path chunk(const std::string& id, const char* suffix = "") const;
+    // Существующий файл версии или фрагмента; пустой путь — такого нет
+    std::filesystem::path locate(const std::string& id, const char* suffix = "") const;
+    std::filesystem::path locateChunk(const std::string& id, const char* suffix = "") const;
+
+    // Создаёт каталоги для path, полученного из object или chunk
+    static void prepare(const std::filesystem::path& path);
+
+    // Обходит файлы версий или фрагментов обеих раскладок: visit получает идентификатор
+    // (имя без суффикса) и путь; временные файлы пропускаются
+    using Visitor = std::function<void(const std::string& id, const std::filesystem::path& path)>;
+    void forEachObject(const Visitor& visit) const;
+    void forEachChunk(const Visitor& visit) const;
+
+    // В хранилище остались файлы плоской раскладки
+    bool legacy() const { return flat.load(std::memory_order_relaxed); }
+    // Переносит файлы плоской раскладки в разнесённые каталоги; progress получает число перенесённых.
+    // Возвращает, сколько файлов перенесено
+    uint64_t migrate(const std::function<void(uint64_t moved)>& progress = nullptr);
+
+private:
+    std::filesystem::path sharded(const std::filesystem::path& base, const std::string& id, const char* suffix) const;
+    std::filesystem::path find(const std::filesystem::path& base, const std::string& id, const char* suffix) const;
+    void scan(const std::filesystem::path& base, const Visitor& visit) const;
+    uint64_t migrateDirectory(const std::filesystem::path& base, uint64_t moved,
+                              const std::function<void(uint64_t moved)>& progress);
+
+    std::filesystem::path rootDir;
+    std::filesystem::path chunkDir;
+    std::atomic<bool> flat;
+};
@@ -0,0 +1,606 @@
+// VaultPack.cpp
+#include "VaultPack.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr unsigned char kSegmentMagic[8] = {'F', 'V', 'P', '1', 0, 0, 0, 0};
+constexpr unsigned char kIndexMagic[8] = {'F', 'V', 'I', '1', 0, 0, 0, 0};
+constexpr size_t kKeySize = 32;
+constexpr size_t kRecordHeaderSize = kKeySize + 4 + 4 + 8;
+constexpr size_t kIndexEntrySize = kKeySize + 8 + 8 + 4 + 4;
+
+void putU32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+void putU64(unsigned char* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+uint32_t getU32(const unsigned char* in) {
+    return uint32_t(in[0]) | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16 | uint32_t(in[3]) << 24;
+}
+
+uint64_t getU64(const unsigned char* in) {
+    return uint64_t(getU32(in)) | uint64_t(getU32(in + 4)) << 32;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// SHA-256 версии в двоичном виде; false — versionId не адрес по содержимому (старые
+// 8-символьные идентификаторы в пакеты не попадают)
+bool packKey(const std::string& versionId, std::string& key) {
+    if (versionId.size() != 2 * kKeySize) {
+        return false;
+    }
+    key.resize(kKeySize);
+    for (size_t i = 0; i < kKeySize; ++i) {
+        int high = hexValue(versionId[2 * i]);
+        int low = hexValue(versionId[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        key[i] = static_cast<char>(high << 4 | low);
+    }
+    return true;
+}
+
+std::string hexKey(const unsigned char* key) {
+    static const char digits[] = "0123456789abcdef";
+    std::string id(2 * kKeySize, '0');
+    for (size_t i = 0; i < kKeySize; ++i) {
+        id[2 * i] = digits[key[i] >> 4];
+        id[2 * i + 1] = digits[key[i] & 0xf];
+    }
+    return id;
+}
+
+void writeAll(int fd, const unsigned char* data, size_t size, uint64_t offset, const std::filesystem::path& path) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Ошибка записи пакета " + path.string() + ": " + std::strerror(errno));
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+bool readAll(int fd, unsigned char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t count = pread(fd, data, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+
+} // namespace
+
+VaultPack::VaultPack(const std::filesystem::path& vaultDir)
+    : directory(vaultDir / "packs") {
+    std::filesystem::create_directories(directory);
+    open();
+    repackThread = std::thread([this]() { repackLoop(); });
+}
+
+VaultPack::~VaultPack() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    repackWake.notify_all();
+    if (repackThread.joinable()) {
+        repackThread.join();
+    }
+    for (auto& [number, segment] : sealed) {
+        closeSegment(segment);
+    }
+    closeSegment(active);
+}
+
+std::filesystem::path VaultPack::segmentPath(uint32_t number, const char* extension) const {
+    return directory / (std::to_string(number) + extension);
+}
+
+void VaultPack::open() {
+    std::vector<uint32_t> numbers;
+    for (const auto& item : std::filesystem::directory_iterator(directory)) {
+        const std::filesystem::path& path = item.path();
+        if (path.extension() == ".pack") {
+            try {
+                numbers.push_back(static_cast<uint32_t>(std::stoul(path.stem().string())));
+            } catch (const std::exception&) {
+            }
+        } else if (path.extension() == ".tmp") {
+            std::filesystem::remove(path);   // индекс, не дописанный до сбоя
+        } else if (path.extension() == ".idx" || path.extension() == ".dead") {
+            // Остатки сегмента, удалённого переупаковкой до конца
+            if (!std::filesystem::exists(segmentPath(static_cast<uint32_t>(std::atol(path.stem().c_str())), ".pack"))) {
+                std::filesystem::remove(path);
+            }
+        }
+    }
+    std::sort(numbers.begin(), numbers.end());
+
+    for (uint32_t number : numbers) {
+        Segment segment;
+        segment.fd = ::open(segmentPath(number, ".pack").c_str(), O_RDWR | O_CLOEXEC);
+        if (segment.fd < 0) {
+            throw std::runtime_error("Не удалось открыть пакет " + segmentPath(number, ".pack").string() + ": " +
+                                     std::strerror(errno));
+        }
+        FILE* deadList = fopen(segmentPath(number, ".dead").c_str(), "rb");
+        if (deadList) {
+            char key[kKeySize];
+            while (fread(key, 1, kKeySize, deadList) == kKeySize) {
+                segment.dead.emplace(key, kKeySize);
+            }
+            fclose(deadList);
+        }
+
+        if (std::filesystem::exists(segmentPath(number, ".idx"))) {
+            struct stat info {};
+            fstat(segment.fd, &info);
+            segment.size = static_cast<uint64_t>(info.st_size);
+            mapIndex(number, segment);
+            for (size_t i = 0; i < segment.count && !segment.dead.empty(); ++i) {
+                const unsigned char* item = segment.index + sizeof(kIndexMagic) + i * kIndexEntrySize;
+                if (segment.dead.count(std::string(reinterpret_cast<const char*>(item), kKeySize))) {
+                    segment.deadBytes += kRecordHeaderSize + getU64(item + kKeySize + 8);
+                }
+            }
+            scheduleRepack(number, segment);
+            sealed.emplace(number, std::move(segment));
+            continue;
+        }
+
+        // Сегмент без индекса: открытый или закрывавшийся во время сбоя
+        std::unordered_map<std::string, Entry> entries;
+        recover(number, segment, entries);
+        if (number != numbers.back()) {
+            activeNumber = number;
+            active = std::move(segment);
+            activeEntries = std::move(entries);
+            sealActive();
+            continue;
+        }
+        activeNumber = number;
+        active = std::move(segment);
+        activeEntries = std::move(entries);
+    }
+
+    if (active.fd < 0) {
+        startSegment(numbers.empty() ? 1 : numbers.back() + 1);
+    }
+}
+
+void VaultPack::recover(uint32_t number, Segment& segment, std::unordered_map<std::string, Entry>& entries) {
+    std::filesystem::path path = segmentPath(number, ".pack");
+    struct stat info {};
+    fstat(segment.fd, &info);
+    uint64_t fileSize = static_cast<uint64_t>(info.st_size);
+
+    unsigned char header[kRecordHeaderSize];
+    uint64_t offset = sizeof(kSegmentMagic);
+    if (fileSize < sizeof(kSegmentMagic) || !readAll(segment.fd, header, sizeof(kSegmentMagic), 0) ||
+        std::memcmp(header, kSegmentMagic, sizeof(kSegmentMagic)) != 0) {
+        // Сбой при создании сегмента: заголовок пишется заново
+        writeAll(segment.fd, kSegmentMagic, sizeof(kSegmentMagic), 0, path);
+        fileSize = std::max<uint64_t>(fileSize, sizeof(kSegmentMagic));
+    }
+    while (offset + kRecordHeaderSize <= fileSize && readAll(segment.fd, header, kRecordHeaderSize, offset)) {
+        uint64_t length = getU64(header + kKeySize + 8);
+        if (length > kMaxObjectSize || offset + kRecordHeaderSize + length > fileSize) {
+            break;
+        }
+        std::string key(reinterpret_cast<const char*>(header), kKeySize);
+        Entry entry;
+        entry.offset = offset + kRecordHeaderSize;
+        entry.length = length;
+        entry.mode = getU32(header + kKeySize);
+        entry.flags = getU32(header + kKeySize + 4);
+        if (segment.dead.count(key)) {
+            segment.deadBytes += kRecordHeaderSize + length;
+        } else {
+            entries.emplace(key, entry);
+        }
+        offset = entry.offset + length;
+    }
+    if (offset < fileSize) {
+        std::cerr << "⚠ Пакет " << path.string() << ": отрезан недописанный хвост " << fileSize - offset << " байт" << std::endl;
+        if (ftruncate(segment.fd, static_cast<off_t>(offset)) != 0) {
+            throw std::runtime_error("Не удалось восстановить пакет " + path.string() + ": " + std::strerror(errno));
+        }
+    }
+    segment.size = offset;
+}
+
+void VaultPack::startSegment(uint32_t number) {
+    std::filesystem::path path = segmentPath(number, ".pack");
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Не удалось создать пакет " + path.string() + ": " + std::strerror(errno));
+    }
+    writeAll(fd, kSegmentMagic, sizeof(kSegmentMagic), 0, path);
+    activeNumber = number;
+    active = Segment();
+    active.fd = fd;
+    active.size = sizeof(kSegmentMagic);
+    activeEntries.clear();
+}
+
+void VaultPack::sealActive() {
+    std::vector<std::pair<std::string, Entry>> entries(activeEntries.begin(), activeEntries.end());
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& left, const auto& right) { return left.first < right.first; });
+    std::vector<unsigned char> index(sizeof(kIndexMagic) + entries.size() * kIndexEntrySize);
+    std::memcpy(index.data(), kIndexMagic, sizeof(kIndexMagic));
+    unsigned char* item = index.data() + sizeof(kIndexMagic);
+    for (const auto& [key, entry] : entries) {
+        std::memcpy(item, key.data(), kKeySize);
+        putU64(item + kKeySize, entry.offset);
+        putU64(item + kKeySize + 8, entry.length);
+        putU32(item + kKeySize + 16, entry.mode);
+        putU32(item + kKeySize + 20, entry.flags);
+        item += kIndexEntrySize;
+    }
+
+    // Индекс появляется только целиком: сегмент без индекса при открытии читается заново
+    std::filesystem::path finalPath = segmentPath(activeNumber, ".idx");
+    std::filesystem::path temporaryPath = segmentPath(activeNumber, ".idx.tmp");
+    int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Не удалось создать индекс пакета " + temporaryPath.string() + ": " + std::strerror(errno));
+    }
+    try {
+        writeAll(fd, index.data(), index.size(), 0, temporaryPath);
+    } catch (...) {
+        close(fd);
+        unlink(temporaryPath.c_str());
+        throw;
+    }
+    fdatasync(active.fd);
+    if (fdatasync(fd) != 0 || close(fd) != 0) {
+        unlink(temporaryPath.c_str());
+        throw std::runtime_error("Ошибка записи индекса пакета " + temporaryPath.string() + ": " + std::strerror(errno));
+    }
+    std::filesystem::rename(temporaryPath, finalPath);
+
+    Segment segment = std::move(active);
+    active = Segment();
+    mapIndex(activeNumber, segment);
+    uint32_t number = activeNumber;
+    scheduleRepack(number, segment);
+    sealed.emplace(number, std::move(segment));
+    activeEntries.clear();
+}
+
+void VaultPack::mapIndex(uint32_t number, Segment& segment) {
+    std::filesystem::path path = segmentPath(number, ".idx");
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Не удалось открыть индекс пакета " + path.string() + ": " + std::strerror(errno));
+    }
+    struct stat info {};
+    fstat(fd, &info);
+    size_t length = static_cast<size_t>(info.st_size);
+    void* address = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Не удалось отобразить индекс пакета " + path.string());
+    }
+    auto bytes = static_cast<const unsigned char*>(address);
+    if (length < sizeof(kIndexMagic) || (length - sizeof(kIndexMagic)) % kIndexEntrySize != 0 ||
+        std::memcmp(bytes, kIndexMagic, sizeof(kIndexMagic)) != 0) {
+        munmap(address, length);
+        throw std::runtime_error("Повреждён индекс пакета " + path.string());
+    }
+    segment.index = bytes;
+    segment.indexLength = length;
+    segment.count = (length - sizeof(kIndexMagic)) / kIndexEntrySize;
+}
+
+void VaultPack::closeSegment(Segment& segment) {
+    if (segment.index) {
+        munmap(const_cast<unsigned char*>(segment.index), segment.indexLength);
+        segment.index = nullptr;
+    }
+    if (segment.fd >= 0) {
+        close(segment.fd);
+        segment.fd = -1;
+    }
+}
+
+bool VaultPack::findLocked(const std::string& key, uint32_t& number, Entry& entry) const {
+    auto found = activeEntries.find(key);
+    if (found != activeEntries.end()) {
+        number = activeNumber;
+        entry = found->second;
+        return true;
+    }
+    // Новые сегменты раньше: после переупаковки живая копия записи — в более новом
+    for (auto it = sealed.rbegin(); it != sealed.rend(); ++it) {
+        const Segment& segment = it->second;
+        size_t low = 0;
+        size_t high = segment.count;
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            const unsigned char* item = segment.index + sizeof(kIndexMagic) + middle * kIndexEntrySize;
+            int order = std::memcmp(item, key.data(), kKeySize);
+            if (order == 0) {
+                if (segment.dead.count(key)) {
+                    break;
+                }
+                number = it->first;
+                entry.offset = getU64(item + kKeySize);
+                entry.length = getU64(item + kKeySize + 8);
+                entry.mode = getU32(item + kKeySize + 16);
+                entry.flags = getU32(item + kKeySize + 20);
+                return true;
+            }
+            if (order < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+    }
+    return false;
+}
+
+bool VaultPack::contains(const std::string& versionId) const {
+    std::string key;
+    if (!packKey(versionId, key)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t number;
+    Entry entry;
+    return findLocked(key, number, entry);
+}
+
+bool VaultPack::append(const std::string& versionId, const unsigned char* data, size_t size, uint32_t mode,
+                       uint32_t flags) {
+    std::string key;
+    if (!packKey(versionId, key) || size > kMaxObjectSize) {
+        throw std::invalid_argument("Версия " + versionId + " не может храниться в пакете");
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t number;
+    Entry entry;
+    if (findLocked(key, number, entry)) {
+        return false;
+    }
+    appendLocked(key, data, size, mode, flags);
+    return true;
+}
+
+void VaultPack::appendLocked(const std::string& key, const unsigned char* data, size_t size, uint32_t mode,
+                             uint32_t flags) {
+    // Удалённые ключи в .dead записаны без смещения: запись с таким ключом в том же сегменте после
+    // открытия тоже сочлась бы удалённой, поэтому возвращённая версия пишется в новый сегмент
+    if ((!activeEntries.empty() && active.size + kRecordHeaderSize + size > kSegmentSize) || active.dead.count(key)) {
+        uint32_t next = activeNumber + 1;
+        sealActive();
+        startSegment(next);
+    }
+    std::vector<unsigned char> record(kRecordHeaderSize + size);
+    std::memcpy(record.data(), key.data(), kKeySize);
+    putU32(record.data() + kKeySize, mode);
+    putU32(record.data() + kKeySize + 4, flags);
+    putU64(record.data() + kKeySize + 8, size);
+    std::memcpy(record.data() + kRecordHeaderSize, data, size);
+    writeAll(active.fd, record.data(), record.size(), active.size, segmentPath(activeNumber, ".pack"));
+
+    Entry entry;
+    entry.offset = active.size + kRecordHeaderSize;
+    entry.length = size;
+    entry.mode = mode;
+    entry.flags = flags;
+    activeEntries[key] = entry;
+    active.size += record.size();
+}
+
+bool VaultPack::read(const std::string& versionId, std::vector<unsigned char>& data, uint32_t& mode,
+                     uint32_t& flags) const {
+    std::string key;
+    if (!packKey(versionId, key)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t number;
+    Entry entry;
+    if (!findLocked(key, number, entry)) {
+        return false;
+    }
+    const Segment& segment = number == activeNumber ? active : sealed.at(number);
+    data.resize(static_cast<size_t>(entry.length));
+    if (!readAll(segment.fd, data.data(), data.size(), entry.offset)) {
+        throw std::runtime_error("Пакет " + segmentPath(number, ".pack").string() + " обрывается на версии " + versionId);
+    }
+    mode = entry.mode;
+    flags = entry.flags;
+    return true;
+}
+
+bool VaultPack::erase(const std::string& versionId) {
+    std::string key;
+    if (!packKey(versionId, key)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    bool erased = false;
+    // Запись может быть в нескольких сегментах, если переупаковка ещё не удалила старый
+    uint32_t number;
+    Entry entry;
+    while (findLocked(key, number, entry)) {
+        if (number == activeNumber) {
+            activeEntries.erase(key);
+            markDead(number, active, key, entry.length);
+        } else {
+            Segment& segment = sealed.at(number);
+            markDead(number, segment, key, entry.length);
+            scheduleRepack(number, segment);
+        }
+        erased = true;
+    }
+    return erased;
+}
+
+uint64_t VaultPack::storedLength(const std::string& versionId) const {
+    std::string key;
+    if (!packKey(versionId, key)) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t number;
+    Entry entry;
+    return findLocked(key, number, entry) ? entry.length : 0;
+}
+
+std::vector<std::pair<std::string, uint64_t>> VaultPack::versions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_set<std::string> seen;
+    std::vector<std::pair<std::string, uint64_t>> result;
+    auto add = [&](const std::string& key, uint64_t length) {
+        if (seen.insert(key).second) {
+            result.emplace_back(hexKey(reinterpret_cast<const unsigned char*>(key.data())), length);
+        }
+    };
+    for (const auto& [key, entry] : activeEntries) {
+        add(key, entry.length);
+    }
+    // Пока переупаковка не удалила старый сегмент, запись может встретиться дважды
+    for (auto it = sealed.rbegin(); it != sealed.rend(); ++it) {
+        const Segment& segment = it->second;
+        for (size_t i = 0; i < segment.count; ++i) {
+            const unsigned char* item = segment.index + sizeof(kIndexMagic) + i * kIndexEntrySize;
+            std::string key(reinterpret_cast<const char*>(item), kKeySize);
+            if (!segment.dead.count(key)) {
+                add(key, getU64(item + kKeySize + 8));
+            }
+        }
+    }
+    return result;
+}
+
+void VaultPack::markDead(uint32_t number, Segment& segment, const std::string& key, uint64_t length) {
+    std::filesystem::path path = segmentPath(number, ".dead");
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0 || write(fd, key.data(), kKeySize) != static_cast<ssize_t>(kKeySize)) {
+        int error = errno;
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("Ошибка записи " + path.string() + ": " + std::strerror(error));
+    }
+    close(fd);
+    segment.dead.insert(key);
+    segment.deadBytes += kRecordHeaderSize + length;
+}
+
+void VaultPack::scheduleRepack(uint32_t number, const Segment& segment) {
+    if (segment.deadBytes * 2 <= segment.size || repackScheduled.count(number)) {
+        return;
+    }
+    repackScheduled.insert(number);
+    repackQueue.push_back(number);
+    repackWake.notify_one();
+}
+
+void VaultPack::repackLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        repackWake.wait(lock, [this]() { return stopping || !repackQueue.empty(); });
+        if (stopping) {
+            return;
+        }
+        uint32_t number = repackQueue.front();
+        repackQueue.pop_front();
+        lock.unlock();
+        try {
+            repack(number);
+        } catch (const std::exception& e) {
+            std::cerr << "⚠ Переупаковка пакета " << number << " не удалась: " << e.what() << std::endl;
+        }
+        lock.lock();
+        repackScheduled.erase(number);
+    }
+}
+
+void VaultPack::repack(uint32_t number) {
+    // Живые записи переносятся по одной, мьютекс отпускается между ними, чтобы не задерживать сохранение
+    std::vector<std::string> keys;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Segment& segment = sealed.at(number);
+        for (size_t i = 0; i < segment.count; ++i) {
+            const unsigned char* item = segment.index + sizeof(kIndexMagic) + i * kIndexEntrySize;
+            std::string key(reinterpret_cast<const char*>(item), kKeySize);
+            if (!segment.dead.count(key)) {
+                keys.push_back(std::move(key));
+            }
+        }
+    }
+
+    uint64_t moved = 0;
+    size_t movedCount = 0;
+    std::vector<unsigned char> data;
+    for (const std::string& key : keys) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        uint32_t found;
+        Entry entry;
+        if (!findLocked(key, found, entry) || found != number) {
+            continue;   // удалена или уже есть в более новом сегменте
+        }
+        data.resize(static_cast<size_t>(entry.length));
+        if (!readAll(sealed.at(number).fd, data.data(), data.size(), entry.offset)) {
+            throw std::runtime_error("Пакет " + segmentPath(number, ".pack").string() + " обрывается");
+        }
+        appendLocked(key, data.data(), data.size(), entry.mode, entry.flags);
+        moved += kRecordHeaderSize + data.size();
+        ++movedCount;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) {
+        return;
+    }
+    // Перенесённые записи должны быть на диске раньше, чем исчезнет старый сегмент
+    fdatasync(active.fd);
+    Segment& segment = sealed.at(number);
+    uint64_t freed = segment.size - std::min(segment.size, moved);
+    closeSegment(segment);
+    sealed.erase(number);
+    std::filesystem::remove(segmentPath(number, ".idx"));
+    std::filesystem::remove(segmentPath(number, ".pack"));
+    std::filesystem::remove(segmentPath(number, ".dead"));
+    std::cout << "  ♻ Пакет " << number << " переупакован: перенесено " << movedCount << " версий, освобождено "
+              << freed / 1024 << " КБ" << std::endl;
+}
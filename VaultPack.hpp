@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Пакеты мелких версий: вместо отдельного файла (и inode) на версию содержимое дописывается
+// в сегмент <vault>/packs/<номер>.pack. Сегмент начинается с "FVP1" и четырёх нулевых байт,
+// за ними записи <32 байта SHA-256> <u32 права> <u32 флаги> <u64 длина> <данные>.
+//
+// Заполненный сегмент закрывается: рядом пишется индекс <номер>.idx — "FVI1", четыре нулевых
+// байта и отсортированный по SHA-256 массив <32 байта SHA-256> <u64 смещение данных> <u64 длина>
+// <u32 права> <u32 флаги>. Индекс отображается в память, поиск — двоичный, без системных вызовов.
+// Записи открытого сегмента индексируются в памяти; при открытии хранилища они восстанавливаются
+// чтением сегмента, недописанный или повреждённый хвост отрезается.
+//
+// Удалённые версии перечисляются в <номер>.dead (по 32 байта SHA-256). Закрытый сегмент,
+// в котором удалённых данных больше половины, переупаковывается фоновым потоком: живые записи
+// дописываются в открытый сегмент, старый сегмент удаляется.
+class VaultPack {
+public:
+    static constexpr uint32_t kCompressed = 1;                   // данные — кадр VaultCompressor
+    static constexpr uint64_t kSegmentSize = 64 * 1024 * 1024;   // байт, после которых сегмент закрывается
+    static constexpr uint64_t kMaxObjectSize = 16 * 1024 * 1024; // версия читается из пакета в память целиком
+
+    explicit VaultPack(const std::filesystem::path& vaultDir);
+    ~VaultPack();
+
+    VaultPack(const VaultPack&) = delete;
+    VaultPack& operator=(const VaultPack&) = delete;
+
+    bool contains(const std::string& versionId) const;
+    // Дописывает версию в открытый сегмент; false — она уже есть в пакетах
+    bool append(const std::string& versionId, const unsigned char* data, size_t size, uint32_t mode, uint32_t flags);
+    // Данные версии в том виде, в котором они записаны; false — версии нет в пакетах
+    bool read(const std::string& versionId, std::vector<unsigned char>& data, uint32_t& mode, uint32_t& flags) const;
+    // Помечает версию удалённой; место освобождается переупаковкой сегмента
+    bool erase(const std::string& versionId);
+    // Длина записанных данных версии; 0 — версии нет в пакетах
+    uint64_t storedLength(const std::string& versionId) const;
+    // Живые версии пакетов с длиной записанных данных (для сборщика мусора)
+    std::vector<std::pair<std::string, uint64_t>> versions() const;
+
+private:
+    struct Entry {
+        uint64_t offset = 0;      // начало данных в сегменте
+        uint64_t length = 0;
+        uint32_t mode = 0;
+        uint32_t flags = 0;
+    };
+
+    struct Segment {
+        int fd = -1;
+        uint64_t size = 0;
+        uint64_t deadBytes = 0;
+        const unsigned char* index = nullptr;   // отображённый .idx закрытого сегмента
+        size_t indexLength = 0;
+        size_t count = 0;
+        std::unordered_set<std::string> dead;   // SHA-256 в двоичном виде
+    };
+
+    std::filesystem::path segmentPath(uint32_t number, const char* extension) const;
+    void open();
+    void recover(uint32_t number, Segment& segment, std::unordered_map<std::string, Entry>& entries);
+    void startSegment(uint32_t number);
+    void sealActive();
+    void mapIndex(uint32_t number, Segment& segment);
+    void closeSegment(Segment& segment);
+    bool findLocked(const std::string& key, uint32_t& number, Entry& entry) const;
+    void appendLocked(const std::string& key, const unsigned char* data, size_t size, uint32_t mode, uint32_t flags);
+    void markDead(uint32_t number, Segment& segment, const std::string& key, uint64_t length);
+    void scheduleRepack(uint32_t number, const Segment& segment);
+    void repack(uint32_t number);
+    void repackLoop();
+
+    std::filesystem::path directory;
+    mutable std::mutex mutex;
+
+    std::map<uint32_t, Segment> sealed;                // закрытые сегменты по номеру
+    uint32_t activeNumber = 0;
+    Segment active;
+    std::unordered_map<std::string, Entry> activeEntries;
+
+    std::deque<uint32_t> repackQueue;
+    std::unordered_set<uint32_t> repackScheduled;
+    std::condition_variable repackWake;
+    bool stopping = false;
+    std::thread repackThread;
+};
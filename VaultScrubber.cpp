@@ -0,0 +1,325 @@
+// VaultScrubber.cpp
+#include "VaultScrubber.hpp"
+#include "ChecksumAlgorithms.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+constexpr size_t kBatchSize = 64;                     // объектов между сохранениями положения
+constexpr size_t kOrphanExamples = 10;                // идентификаторов в отчёте о неиспользуемых
+constexpr auto kRetryDelay = std::chrono::minutes(5); // после ошибки базы или хранилища
+constexpr const char* kVersionCursor = "v:";
+constexpr const char* kChunkCursor = "c:";
+
+bool startsWith(const std::string& text, const char* prefix) {
+    return text.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+}
+
+void printOrphans(const char* kind, const std::vector<std::string>& ids) {
+    std::cout << "  ⚠ Проверка хранилища: не используются " << kind << " (" << ids.size() << "):";
+    for (size_t i = 0; i < ids.size() && i < kOrphanExamples; ++i) {
+        std::cout << " " << ids[i];
+    }
+    std::cout << (ids.size() > kOrphanExamples ? " …" : "") << std::endl;
+}
+
+} // namespace
+
+VaultScrubber::VaultScrubber(VaultService& vault, std::string dbPath)
+    : vault(vault), dbPath(std::move(dbPath)) {
+    worker = std::thread([this]() { run(); });
+}
+
+VaultScrubber::~VaultScrubber() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void VaultScrubber::configure(const ScrubConfig& newConfig) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        config = newConfig;
+        configured = true;
+        reconfigured = true;
+    }
+    wake.notify_all();
+}
+
+void VaultScrubber::pause() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++pauses;
+    }
+    wake.notify_all();
+}
+
+void VaultScrubber::resume() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --pauses;
+    }
+    wake.notify_all();
+}
+
+bool VaultScrubber::interrupted() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stopping || pauses > 0;
+}
+
+void VaultScrubber::pace(uint64_t bytes) {
+    // Каждый блок отодвигает время следующего чтения на bytes / bytesPerSecond; простой
+    // не накапливается, поэтому после ожидания проверка не читает всплеском
+    auto now = std::chrono::steady_clock::now();
+    nextRead = std::max(nextRead, now) +
+               std::chrono::nanoseconds(bytes * 1000000000ull / roundConfig.bytesPerSecond);
+    stats.bytes += bytes;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wake.wait_until(lock, nextRead, [this]() { return stopping || pauses > 0; })) {
+        throw Interrupted();
+    }
+}
+
+void VaultScrubber::run() {
+    lowerThreadPriority();
+    std::unique_ptr<StatePersistenceService> db;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait(lock, [this]() { return stopping || (configured && config.enabled && pauses == 0); });
+        if (stopping) {
+            break;
+        }
+        reconfigured = false;
+        roundConfig = config;
+        lock.unlock();
+
+        auto resumeAt = std::chrono::steady_clock::now();
+        try {
+            if (!db) {
+                db = std::make_unique<StatePersistenceService>(dbPath);
+            }
+            ScrubState state = db->loadScrubState();
+            int64_t now = static_cast<int64_t>(std::time(nullptr));
+            int64_t due = state.roundStarted + static_cast<int64_t>(roundConfig.roundIntervalHours) * 3600;
+            if (state.cursor.empty() && due > now) {
+                resumeAt += std::chrono::seconds(due - now);
+            } else {
+                if (state.cursor.empty()) {
+                    state.roundStarted = now;
+                    state.cursor = kVersionCursor;
+                    db->saveScrubState(state);
+                    stats = ScrubStats();
+                }
+                if (scrubRound(*db, state)) {
+                    // Счётчики — с запуска демона, время — всего прохода, с перезапусками
+                    std::cout << "🔍 Проверка хранилища завершена: версий " << stats.versions << ", фрагментов "
+                              << stats.chunks << ", прочитано " << std::fixed << std::setprecision(1)
+                              << stats.bytes / (1024.0 * 1024.0) << " МБ за "
+                              << std::time(nullptr) - state.roundStarted << " с"
+                              << std::defaultfloat << "; повреждено " << stats.corrupt << ", отсутствует "
+                              << stats.missing << ", не используется версий " << stats.orphanVersions
+                              << " и фрагментов " << stats.orphanChunks << std::endl;
+                    state.cursor.clear();
+                    db->saveScrubState(state);
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "  ⚠ Ошибка проверки хранилища: " << e.what() << std::endl;
+            resumeAt += kRetryDelay;
+        }
+
+        lock.lock();
+        wake.wait_until(lock, resumeAt, [this]() { return stopping || pauses > 0 || reconfigured; });
+    }
+}
+
+bool VaultScrubber::scrubRound(StatePersistenceService& db, ScrubState& state) {
+    try {
+        if (startsWith(state.cursor, kVersionCursor) && !scrubVersions(db, state)) {
+            return false;
+        }
+        if (!scrubChunks(db, state)) {
+            return false;
+        }
+    } catch (const Interrupted&) {
+        return false;
+    }
+    return reportOrphans(db);
+}
+
+bool VaultScrubber::scrubVersions(StatePersistenceService& db, ScrubState& state) {
+    std::string after = state.cursor.substr(2);
+    for (;;) {
+        std::vector<RecordedVersion> batch = db.recordedVersionsAfter(after, kBatchSize);
+        if (batch.empty()) {
+            break;
+        }
+        for (const auto& version : batch) {
+            verifyVersion(db, version);
+        }
+        after = batch.back().versionId;
+        state.cursor = kVersionCursor + after;
+        db.saveScrubState(state);
+    }
+    state.cursor = kChunkCursor;
+    db.saveScrubState(state);
+    return true;
+}
+
+void VaultScrubber::verifyVersion(StatePersistenceService& db, const RecordedVersion& version) {
+    const std::string& versionId = version.versionId;
+    // Адрес по содержимому проверяется по SHA-256; у старых случайных идентификаторов адреса нет,
+    // их сверяют с суммой из истории (дерево Меркла потоком не считается — только чтение)
+    bool addressed = versionId.size() == 2 * Sha256Policy::digestSize;
+    bool recorded = !addressed && !version.checksum.empty() && !version.checksum.tree;
+    std::string problem;
+    // Базы дельт читаются целиком для каждой проверяемой версии и тоже укладываются в bytes_per_second
+    auto paceBase = [this](uint64_t bytes) { pace(bytes); };
+    try {
+        // Фрагменты проверяются отдельно и один раз, сколько бы версий их ни делили:
+        // у версии из фрагментов достаточно убедиться, что все они на месте
+        VaultReferences references = vault.references(versionId);
+        if (!references.chunks.empty()) {
+            for (const auto& chunkId : references.chunks) {
+                if (!vault.hasChunk(chunkId)) {
+                    problem = "нет фрагмента " + chunkId;
+                    break;
+                }
+            }
+        } else if (addressed) {
+            Sha256Policy::Context context;
+            Sha256Policy::init(context);
+            vault.readVersion(versionId, [&](const unsigned char* data, size_t size) {
+                pace(size);
+                Sha256Policy::update(context, data, size);
+            }, paceBase);
+            Digest digest(ChecksumAlgorithm::Sha256, Sha256Policy::digestSize);
+            Sha256Policy::final(context, digest.data());
+            if (digest.toHex() != versionId) {
+                problem = "SHA-256 содержимого " + digest.toHex();
+            }
+        } else if (recorded) {
+            visitChecksumAlgorithm(version.checksum.algorithm, [&](auto policy) {
+                using Policy = decltype(policy);
+                typename Policy::Context context;
+                Policy::init(context);
+                vault.readVersion(versionId, [&](const unsigned char* data, size_t size) {
+                    pace(size);
+                    Policy::update(context, data, size);
+                }, paceBase);
+                Digest digest(Policy::algorithm, Policy::digestSize);
+                Policy::final(context, digest.data());
+                if (!(digest == version.checksum)) {
+                    problem = "сумма " + version.checksum.algorithmName() + " " + digest.toHex() +
+                              " вместо записанной " + version.checksum.toHex();
+                }
+            });
+        } else {
+            vault.readVersion(versionId, [&](const unsigned char*, size_t size) { pace(size); }, paceBase);
+        }
+    } catch (const std::exception& e) {
+        problem = e.what();
+    }
+    ++stats.versions;
+    if (problem.empty()) {
+        return;
+    }
+    if (!vault.exists(versionId)) {
+        // Запись истории могли удалить правила хранения, а версию — сборка мусора
+        if (db.isVersionReferenced(versionId)) {
+            ++stats.missing;
+            std::cerr << "  ⚠ Проверка хранилища: версии " << versionId << " нет в хранилище" << std::endl;
+        }
+        return;
+    }
+    ++stats.corrupt;
+    std::cerr << "  ⚠ Проверка хранилища: версия " << versionId << " повреждена: " << problem << std::endl;
+}
+
+bool VaultScrubber::scrubChunks(StatePersistenceService& db, ScrubState& state) {
+    std::string after = state.cursor.substr(2);
+    std::vector<std::string> chunkIds = vault.listChunks();
+    std::sort(chunkIds.begin(), chunkIds.end());
+    size_t checked = 0;
+    for (auto it = std::upper_bound(chunkIds.begin(), chunkIds.end(), after); it != chunkIds.end(); ++it) {
+        verifyChunk(*it);
+        if (++checked % kBatchSize == 0) {
+            state.cursor = kChunkCursor + *it;
+            db.saveScrubState(state);
+        }
+    }
+    return true;
+}
+
+void VaultScrubber::verifyChunk(const std::string& chunkId) {
+    Sha256Policy::Context context;
+    Sha256Policy::init(context);
+    std::string problem;
+    try {
+        vault.readChunkContent(chunkId, [&](const unsigned char* data, size_t size) {
+            pace(size);
+            Sha256Policy::update(context, data, size);
+        });
+        Digest digest(ChecksumAlgorithm::Sha256, Sha256Policy::digestSize);
+        Sha256Policy::final(context, digest.data());
+        if (digest.toHex() != chunkId) {
+            problem = "SHA-256 содержимого " + digest.toHex();
+        }
+    } catch (const std::exception& e) {
+        problem = e.what();
+    }
+    // Фрагмент, удалённый сборкой мусора после составления списка, не ошибка
+    if (!problem.empty() && vault.hasChunk(chunkId)) {
+        ++stats.corrupt;
+        std::cerr << "  ⚠ Проверка хранилища: фрагмент " << chunkId << " повреждён: " << problem << std::endl;
+    }
+    ++stats.chunks;
+}
+
+bool VaultScrubber::reportOrphans(StatePersistenceService& db) {
+    // Объекты, сохранённые в последние секунды, ещё могут ждать записи в историю
+    std::unordered_set<std::string> versions;
+    std::unordered_set<std::string> chunks;
+    try {
+        if (!vault.mark(db.referencedVersions(), versions, chunks, [this]() { return !interrupted(); })) {
+            return false;
+        }
+    } catch (const std::exception& e) {
+        // Повреждённая версия уже в отчёте; без её ссылок неиспользуемые объекты не определить
+        std::cerr << "  ⚠ Проверка хранилища: неиспользуемые объекты не определены: " << e.what() << std::endl;
+        return true;
+    }
+    std::vector<std::string> orphanVersions;
+    for (auto& versionId : vault.listVersions()) {
+        if (!versions.count(versionId)) {
+            orphanVersions.push_back(std::move(versionId));
+        }
+    }
+    std::vector<std::string> orphanChunks;
+    for (auto& chunkId : vault.listChunks()) {
+        if (!chunks.count(chunkId)) {
+            orphanChunks.push_back(std::move(chunkId));
+        }
+    }
+    stats.orphanVersions = orphanVersions.size();
+    stats.orphanChunks = orphanChunks.size();
+    if (!orphanVersions.empty()) {
+        printOrphans("версии", orphanVersions);
+    }
+    if (!orphanChunks.empty()) {
+        printOrphans("фрагменты", orphanChunks);
+    }
+    return true;
+}
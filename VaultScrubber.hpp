@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ConfigLoader.hpp"
+#include "StatePersistenceService.hpp"
+#include "VaultService.hpp"
+
+// Итог прохода проверки хранилища
+struct ScrubStats {
+    uint64_t versions = 0;        // проверено версий
+    uint64_t chunks = 0;          // проверено фрагментов
+    uint64_t bytes = 0;           // прочитано байт содержимого
+    uint64_t corrupt = 0;         // содержимое не сходится с адресом или суммой либо не читается
+    uint64_t missing = 0;         // версия есть в истории, но не в хранилище
+    uint64_t orphanVersions = 0;  // в хранилище, но на них не ссылаются ни история, ни другие версии
+    uint64_t orphanChunks = 0;
+};
+
+// Фоновая проверка целостности хранилища. Проход читает версии из истории (tracking.db)
+// по возрастанию идентификатора и сверяет содержимое: адрес по содержимому — с SHA-256,
+// старые 8-символьные идентификаторы — с суммой, записанной в file_changes. Затем так же
+// проверяются фрагменты (по SHA-256 в имени), а в конце прохода сообщается о версиях
+// и фрагментах, на которые ничто не ссылается (их удалит GarbageCollector).
+//
+// Чтение ограничено ScrubConfig::bytesPerSecond. Положение прохода сохраняется в scrub_state
+// после каждого пакета, после перезапуска проверка продолжается с него; новый проход начинается
+// не раньше roundIntervalHours после начала предыдущего. Поток работает с наименьшим
+// приоритетом и своим соединением с базой; pause прерывает проверку на время первичного обхода.
+class VaultScrubber {
+public:
+    VaultScrubber(VaultService& vault, std::string dbPath);
+    ~VaultScrubber();
+
+    VaultScrubber(const VaultScrubber&) = delete;
+    VaultScrubber& operator=(const VaultScrubber&) = delete;
+
+    void configure(const ScrubConfig& config);
+    void pause();
+    void resume();
+
+private:
+    struct Interrupted {};        // остановка или пауза посреди чтения
+
+    void run();
+    // false — проход прерван
+    bool scrubRound(StatePersistenceService& db, ScrubState& state);
+    bool scrubVersions(StatePersistenceService& db, ScrubState& state);
+    bool scrubChunks(StatePersistenceService& db, ScrubState& state);
+    bool reportOrphans(StatePersistenceService& db);
+    void verifyVersion(StatePersistenceService& db, const RecordedVersion& version);
+    void verifyChunk(const std::string& chunkId);
+    // Ждёт, пока прочитанные bytes укладываются в скорость; Interrupted — пора остановиться
+    void pace(uint64_t bytes);
+    bool interrupted();
+
+    VaultService& vault;
+    std::string dbPath;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    ScrubConfig config;
+    bool configured = false;
+    bool reconfigured = false;
+    int pauses = 0;
+    bool stopping = false;
+    // Только поток проверки
+    ScrubConfig roundConfig;
+    ScrubStats stats;
+    std::chrono::steady_clock::time_point nextRead;
+    std::thread worker;
+};
@@ -1,45 +1,1349 @@
 // VaultService.cpp
 #include "VaultService.hpp"
+#include "DeltaEncoder.hpp"
+#include "FileReader.hpp"
+#include "VaultCompression.hpp"
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <random>
+#include <iterator>
 #include <sstream>
-#include <iomanip>
+#include <unordered_set>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr const char* kManifestHeader = "filevault-manifest 1";
+constexpr size_t kKernelCopyStep = 1ull << 30;   // байт за вызов copy_file_range / sendfile
+constexpr const char* kDeltaHeader = "filevault-delta 1";
+constexpr size_t kDeltaHeaderSize = 256;   // текстовый заголовок фиксированного размера, за ним операции
+
+constexpr const char* kCompressedSuffix = ".z";
+constexpr const char* kManifestSuffix = ".manifest";
+constexpr const char* kDeltaSuffix = ".delta";
+
+// Файлы хранилища, в которых может лежать версия
+constexpr const char* kVersionSuffixes[] = {"", kCompressedSuffix, kManifestSuffix, kDeltaSuffix};
+
+struct DeltaHeader {
+    std::string base;
+    uint64_t size = 0;
+    unsigned mode = 0;
+    uint32_t depth = 0;           // дельт от ключевого кадра до этой версии включительно
+    uint64_t chainBytes = 0;      // их суммарный размер
+};
+
+std::string formatDeltaHeader(const DeltaHeader& header) {
+    std::ostringstream text;
+    text << kDeltaHeader << "\n"
+         << "base " << header.base << "\n"
+         << "size " << header.size << "\n"
+         << "mode " << std::oct << header.mode << std::dec << "\n"
+         << "depth " << header.depth << "\n"
+         << "chain " << header.chainBytes << "\n";
+    std::string result = text.str();
+    if (result.size() >= kDeltaHeaderSize) {
+        throw std::logic_error("Заголовок дельты не помещается в отведённое место");
+    }
+    result.resize(kDeltaHeaderSize - 1, ' ');
+    result += '\n';
+    return result;
+}
+
+DeltaHeader readDeltaHeader(std::istream& input, const std::filesystem::path& path) {
+    std::string text(kDeltaHeaderSize, '\0');
+    std::string line;
+    std::string key;
+    DeltaHeader header;
+    if (!input.read(&text[0], static_cast<std::streamsize>(kDeltaHeaderSize))) {
+        throw std::runtime_error("Повреждена дельта версии " + path.string());
+    }
+    std::istringstream fields(text);
+    if (!std::getline(fields, line) || line != kDeltaHeader ||
+        !(fields >> key >> header.base) || key != "base" ||
+        !(fields >> key >> header.size) || key != "size" ||
+        !(fields >> key >> std::oct >> header.mode >> std::dec) || key != "mode" ||
+        !(fields >> key >> header.depth) || key != "depth" ||
+        !(fields >> key >> header.chainBytes) || key != "chain") {
+        throw std::runtime_error("Повреждена дельта версии " + path.string());
+    }
+    return header;
+}
+
+void readManifestHeader(std::istream& input, const std::filesystem::path& path, uint64_t& size, unsigned& mode) {
+    std::string header;
+    std::string key;
+    if (!std::getline(input, header) || header != kManifestHeader ||
+        !(input >> key >> size) || key != "size" ||
+        !(input >> key >> std::oct >> mode >> std::dec) || key != "mode") {
+        throw std::runtime_error("Повреждён манифест версии " + path.string());
+    }
+}
+
+// Удаляет файл и добавляет его размер к freed; false — удалить не удалось
+bool removeFile(const std::filesystem::path& path, uint64_t& freed) {
+    struct stat info {};
+    if (stat(path.c_str(), &info) != 0 || unlink(path.c_str()) != 0) {
+        return false;
+    }
+    freed += static_cast<uint64_t>(info.st_size);
+    return true;
+}
+
+// Базовая версия дельты целиком в памяти. Читается через pread, а не mmap: ошибка ввода-вывода
+// на отображённой странице пришла бы сигналом SIGBUS и завершила процесс посреди записи или восстановления.
+// baseRead получает размер каждого прочитанного блока
+std::vector<unsigned char> readBase(const std::filesystem::path& path,
+                                    const std::function<void(uint64_t bytes)>& baseRead = nullptr) {
+    std::vector<unsigned char> bytes;
+    std::error_code error;
+    uint64_t length = std::filesystem::file_size(path, error);
+    if (!error) {
+        bytes.reserve(static_cast<size_t>(length));
+    }
+    FileReader::read(path, [&](const unsigned char* data, size_t size) {
+        if (baseRead) {
+            baseRead(size);
+        }
+        bytes.insert(bytes.end(), data, data + size);
+    }, ReadStrategy::Pread);
+    return bytes;
+}
+
+// Удаляет временный файл при выходе из области видимости
+struct TemporaryGuard {
+    std::filesystem::path path;
+    ~TemporaryGuard() {
+        if (!path.empty()) {
+            unlink(path.c_str());
+        }
+    }
+};
+
+void writeAll(int fd, const unsigned char* data, size_t size, uint64_t offset, const std::filesystem::path& path) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Ошибка записи версии " + path.string() + ": " + std::strerror(errno));
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+// Временный файл с уникальным именем по шаблону (rename в пределах одной ФС)
+int createTemporary(const std::filesystem::path& pattern, std::filesystem::path& temporaryPath) {
+    std::string name = pattern.string();
+    int fd = mkostemp(name.data(), O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Не удалось создать файл " + pattern.parent_path().string() + ": " + std::strerror(errno));
+    }
+    temporaryPath = name;
+    return fd;
+}
+
+// Безымянный временный файл (O_TMPFILE) читается и публикуется по этому пути, пока открыт дескриптор
+constexpr const char* kProcFd = "/proc/self/fd/";
+
+bool anonymousTemporary(const std::filesystem::path& path) {
+    return path.native().compare(0, std::strlen(kProcFd), kProcFd) == 0;
+}
+
+// Временный файл для VaultStaging в каталоге хранилища (на той же ФС, что и объекты).
+// Без O_TMPFILE (его поддерживают не все ФС) или без /proc — файл .tmp-XXXXXX
+int createStaging(const std::filesystem::path& vaultDir, std::filesystem::path& temporaryPath) {
+    static const bool procAvailable = access(kProcFd, X_OK) == 0;
+    if (procAvailable) {
+        int fd = open(vaultDir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            temporaryPath = kProcFd + std::to_string(fd);
+            return fd;
+        }
+        if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL) {
+            throw std::runtime_error("Не удалось создать файл " + vaultDir.string() + ": " + std::strerror(errno));
+        }
+    }
+    return createTemporary(vaultDir / ".tmp-XXXXXX", temporaryPath);
+}
+
+void discardStaging(int fd, const std::filesystem::path& temporaryPath) {
+    close(fd);
+    if (!anonymousTemporary(temporaryPath)) {
+        unlink(temporaryPath.c_str());
+    }
+}
+
+// Записывает объект хранилища целиком во временный файл и передаёт его в staging
+void stageBytes(VaultStaging& staging, char kind, const std::string& id, const std::filesystem::path& vaultDir,
+                const std::filesystem::path& finalPath, const unsigned char* data, size_t size) {
+    std::filesystem::path temporaryPath;
+    int fd = createStaging(vaultDir, temporaryPath);
+    try {
+        writeAll(fd, data, size, 0, temporaryPath);
+    } catch (...) {
+        discardStaging(fd, temporaryPath);
+        throw;
+    }
+    staging.stageFile(kind, id, fd, temporaryPath, finalPath);
+}
+
+constexpr uint64_t kAnySize = UINT64_MAX;
+
+// Собирает версию потоково во временный файл рядом с destination: produce передаёт содержимое
+// в sink. Размер и SHA-256 сверяются с versionId, затем файл получает права mode
+// и переименовывается поверх destination. Возвращает размер версии.
+uint64_t assembleVersion(const std::string& versionId, uint64_t expectedSize, mode_t mode,
+                         const std::filesystem::path& destination,
+                         const std::function<void(const FileReader::Sink&)>& produce) {
+    std::filesystem::path directory = destination.has_parent_path() ? destination.parent_path() : ".";
+    TemporaryGuard guard;
+    int fd = createTemporary(directory / ("." + destination.filename().string() + ".restore-XXXXXX"), guard.path);
+    Sha256Policy::Context context;
+    Sha256Policy::init(context);
+    uint64_t size = 0;
+    try {
+        produce([&](const unsigned char* data, size_t length) {
+            Sha256Policy::update(context, data, length);
+            writeAll(fd, data, length, size, guard.path);
+            size += length;
+        });
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    Digest digest(ChecksumAlgorithm::Sha256, Sha256Policy::digestSize);
+    Sha256Policy::final(context, digest.data());
+    if ((expectedSize != kAnySize && size != expectedSize) || digest.toHex() != versionId) {
+        close(fd);
+        throw std::runtime_error("Собранная версия " + versionId + " не совпадает с её суммой");
+    }
+
+    fchmod(fd, mode & 07777);
+    if (close(fd) != 0) {
+        throw std::runtime_error("Ошибка записи " + guard.path.string() + ": " + std::strerror(errno));
+    }
+    std::filesystem::rename(guard.path, destination);
+    guard.path.clear();
+    return size;
+}
+
+// Копирует sourceFd в targetFd средствами ядра: FICLONE, затем copy_file_range, затем sendfile.
+// Userspace — ни один способ не сработал и ничего не скопировано
+VaultCopyMethod kernelCopy(int sourceFd, int targetFd, const std::filesystem::path& source) {
+    VaultCopyMethod method = VaultCopyMethod::Userspace;
+
+    if (ioctl(targetFd, FICLONE, sourceFd) == 0) {
+        method = VaultCopyMethod::Reflink;
+    } else {
+        // Копирование до конца файла: он мог вырасти после stat
+        off_t copied = 0;
+        while (true) {
+            ssize_t count = copy_file_range(sourceFd, nullptr, targetFd, nullptr, kKernelCopyStep, 0);
+            if (count > 0) {
+                copied += count;
+                method = VaultCopyMethod::CopyFileRange;
+                continue;
+            }
+            if (count == 0) {
+                method = VaultCopyMethod::CopyFileRange;
+                break;
+            }
+            if (errno == EINTR) continue;
+            if (copied > 0 || (errno != EXDEV && errno != ENOSYS && errno != EOPNOTSUPP && errno != EINVAL)) {
+                throw std::runtime_error("Ошибка копирования " + source.string() + ": " + std::strerror(errno));
+            }
+            method = VaultCopyMethod::Userspace;
+            break;
+        }
+
+        while (method == VaultCopyMethod::Userspace) {
+            ssize_t count = sendfile(targetFd, sourceFd, nullptr, kKernelCopyStep);
+            if (count > 0) {
+                copied += count;
+                continue;
+            }
+            if (count == 0) {
+                method = VaultCopyMethod::Sendfile;
+                break;
+            }
+            if (errno == EINTR) continue;
+            if (copied > 0 || (errno != ENOSYS && errno != EINVAL)) {
+                throw std::runtime_error("Ошибка копирования " + source.string() + ": " + std::strerror(errno));
+            }
+            break;
+        }
+    }
+    return method;
+}
+
+// Версия, хранящаяся целиком: копия средствами ядра во временный файл рядом с destination
+// (reflink, если он на одной ФС с хранилищем) и rename поверх destination. Возвращает размер
+uint64_t copyVersionFile(const std::filesystem::path& source, const std::filesystem::path& destination,
+                         VaultCopyMethod& method) {
+    int sourceFd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (sourceFd < 0) {
+        throw std::runtime_error("Не удалось открыть " + source.string() + ": " + std::strerror(errno));
+    }
+    struct stat info {};
+    fstat(sourceFd, &info);
+    std::filesystem::path directory = destination.has_parent_path() ? destination.parent_path() : ".";
+    TemporaryGuard guard;
+    int fd = -1;
+    uint64_t size = 0;
+    try {
+        fd = createTemporary(directory / ("." + destination.filename().string() + ".restore-XXXXXX"), guard.path);
+        method = kernelCopy(sourceFd, fd, source);
+        if (method == VaultCopyMethod::Userspace) {
+            FileReader::read(source, [&](const unsigned char* data, size_t length) {
+                writeAll(fd, data, length, size, guard.path);
+                size += length;
+            });
+        }
+    } catch (...) {
+        close(sourceFd);
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw;
+    }
+    close(sourceFd);
+    fchmod(fd, info.st_mode & 07777);
+    if (close(fd) != 0) {
+        throw std::runtime_error("Ошибка записи " + guard.path.string() + ": " + std::strerror(errno));
+    }
+    std::filesystem::rename(guard.path, destination);
+    guard.path.clear();
+    return static_cast<uint64_t>(info.st_size);
+}
+
+// Фрагмент хранится как есть или сжатым (<id>.z); возвращает его размер
+uint64_t readChunk(const VaultLayout& layout, const std::string& chunkId, const FileReader::Sink& sink) {
+    std::filesystem::path chunk = layout.locateChunk(chunkId);
+    if (!chunk.empty()) {
+        return FileReader::read(chunk, sink);
+    }
+    chunk = layout.locateChunk(chunkId, kCompressedSuffix);
+    if (!chunk.empty()) {
+        return VaultCompressor::decompress(chunk, sink);
+    }
+    throw std::runtime_error("В хранилище нет фрагмента " + chunkId);
+}
+
+Digest sha256(const unsigned char* data, size_t size) {
+    Sha256Policy::Context context;
+    Sha256Policy::init(context);
+    Sha256Policy::update(context, data, size);
+    Digest digest(ChecksumAlgorithm::Sha256, Sha256Policy::digestSize);
+    Sha256Policy::final(context, digest.data());
+    return digest;
+}
+
+} // namespace
 
 VaultService::VaultService(std::filesystem::path vaultRoot)
-    : vaultDir(vaultRoot) {
+    : vaultDir(vaultRoot), layout(vaultRoot), coldLayout(vaultRoot / "cold"), pack(vaultRoot), index(layout),
+      coldIndex(coldLayout), staging(vaultRoot, pack, index) {
     if (!std::filesystem::exists(vaultDir)) {
         std::filesystem::create_directory(vaultDir);
     }
+    std::filesystem::create_directories(vaultDir / "chunks");
+    std::filesystem::create_directories(coldLayout.root());
+}
+
+VaultService::~VaultService() {
+    try {
+        staging.sync();
+    } catch (const std::exception& e) {
+        std::cerr << "  ⚠ Не все сохранённые версии записаны в хранилище: " << e.what() << std::endl;
+    }
+}
+
+bool VaultService::isContentDigest(const Digest& digest) {
+    return !digest.empty() && digest.algorithm == ChecksumAlgorithm::Sha256 && !digest.tree;
+}
+
+bool VaultService::chunked(const VaultConfig& config, uint64_t size) {
+    return config.chunking && size >= config.chunkingMinFileSize;
 }
 
-std::string VaultService::save(const std::filesystem::path& filePath) {
-    std::random_device rd;
-    std::uniform_int_distribution<int> dist(0, 15);
-    std::ostringstream versionId;
+std::string VaultService::save(const std::filesystem::path& filePath, const Digest& contentDigest,
+                               const VaultConfig& config, const std::string& baseVersionId,
+                               const FileFingerprint& hashedFingerprint) {
+    // Отметка раньше проверки: сборка мусора не удалит найденную версию до записи ссылки на неё
+    if (isContentDigest(contentDigest)) {
+        recent.touchVersion(contentDigest.toHex());
+    }
+    if (!baseVersionId.empty()) {
+        recent.touchVersion(baseVersionId);
+    }
+    if (isContentDigest(contentDigest) && known(contentDigest.toHex())) {
+        // Такое содержимое уже сохранено — новая версия ссылается на него
+        return contentDigest.toHex();
+    }
+
+    // База, ещё не опубликованная, не читается: версия сохранится целиком
+    if (config.delta && !baseVersionId.empty() && exists(baseVersionId)) {
+        std::string versionId;
+        if (saveDelta(filePath, config, baseVersionId, versionId)) {
+            return versionId;
+        }
+    }
+
+    VaultSaveOptions options;
+    options.config = config;
+    std::error_code error;
+    options.size = std::filesystem::file_size(filePath, error);
+    std::unique_ptr<VaultWriter> writer = beginSave(options);
 
-    // Генерация случайного versionId (UUID-like)
-    for (int i = 0; i < 8; ++i) {
-        versionId << std::hex << dist(rd);
+    if (writer->canCopyDirectly()) {
+        FileFingerprint before = FileFingerprint::capture(filePath);
+        VaultCopyMethod method = writer->copyFrom(filePath);
+        if (method != VaultCopyMethod::Userspace) {
+            // contentDigest описывает копию, только если файл не менялся ни после хеширования,
+            // ни во время копирования; иначе адрес считается по самой копии
+            bool trusted = isContentDigest(contentDigest) && hashedFingerprint == before &&
+                           FileFingerprint::capture(filePath) == before && !before.cacheable().empty();
+            std::string versionId = writer->commit(filePath, trusted ? contentDigest : Digest());
+            recordCopy(method, before.size);
+            return versionId;
+        }
     }
 
-    std::filesystem::path destination = vaultDir / versionId.str();
-    std::filesystem::copy(filePath, destination, std::filesystem::copy_options::overwrite_existing);
+    // Адрес считается по тем же байтам, что попадают в копию: файл мог измениться
+    // после того, как была посчитана contentDigest
+    uint64_t offset = 0;
+    FileReader::read(filePath, [&](const unsigned char* data, size_t size) {
+        writer->write(offset, data, size);
+        offset += size;
+    });
+    std::string versionId = writer->commit(filePath);
+    recordCopy(VaultCopyMethod::Userspace, offset);
+    return versionId;
+}
+
+std::unique_ptr<VaultWriter> VaultService::beginSave(const VaultSaveOptions& options) {
+    return std::make_unique<VaultWriter>(layout, pack, index, recent, staging, options);
+}
+
+void VaultService::recordCopy(VaultCopyMethod method, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(copyStatsMutex);
+    ++copyStatistics.files[static_cast<size_t>(method)];
+    copyStatistics.bytes[static_cast<size_t>(method)] += bytes;
+}
+
+VaultCopyStats VaultService::copyStats() const {
+    std::lock_guard<std::mutex> lock(copyStatsMutex);
+    return copyStatistics;
+}
 
-    return versionId.str();
+const char* VaultService::copyMethodName(VaultCopyMethod method) {
+    switch (method) {
+        case VaultCopyMethod::Reflink:       return "reflink";
+        case VaultCopyMethod::CopyFileRange: return "copy_file_range";
+        case VaultCopyMethod::Sendfile:      return "sendfile";
+        case VaultCopyMethod::Userspace:     return "чтение и запись";
+    }
+    return "?";
+}
+
+bool VaultService::saveDelta(const std::filesystem::path& filePath, const VaultConfig& config,
+                             const std::string& baseVersionId, std::string& versionId) {
+    DeltaHeader header;
+    header.base = baseVersionId;
+    std::filesystem::path baseDelta = layout.locate(baseVersionId, kDeltaSuffix);
+    if (!baseDelta.empty()) {
+        std::ifstream input(baseDelta, std::ios::binary);
+        DeltaHeader base = readDeltaHeader(input, baseDelta);
+        header.depth = base.depth;
+        header.chainBytes = base.chainBytes;
+    }
+    ++header.depth;
+    if (header.depth >= config.deltaKeyframeInterval || header.chainBytes >= config.deltaMaxChainBytes) {
+        return false;
+    }
+
+    // Базовая версия нужна целиком в памяти; если она не хранится целиком, собирается во временный файл
+    TemporaryGuard baseGuard;
+    std::filesystem::path basePath = layout.locate(baseVersionId);
+    if (basePath.empty()) {
+        int baseFd = createTemporary(vaultDir / ".tmp-XXXXXX", baseGuard.path);
+        close(baseFd);
+        RestoreStats baseStats;
+        if (!restoreVersion(baseVersionId, baseGuard.path, baseStats)) {
+            // Без базы дельта вышла бы повреждённой: сохраняется ключевой кадр
+            return false;
+        }
+        basePath = baseGuard.path;
+    }
+    std::vector<unsigned char> base = readBase(basePath);
+
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(filePath, error);
+    if (error) {
+        return false;
+    }
+    // Дельта больше половины файла или сверх остатка цепочки — выгоднее ключевой кадр
+    uint64_t limit = std::min(fileSize / 2, config.deltaMaxChainBytes - header.chainBytes);
+
+    std::filesystem::path deltaPath;
+    int fd = createStaging(vaultDir, deltaPath);
+    uint64_t offset = kDeltaHeaderSize;
+    bool exceeded = false;
+    Sha256Policy::Context context;
+    Sha256Policy::init(context);
+    try {
+        DeltaEncoder encoder(base.data(), base.size(), [&](const unsigned char* data, size_t size) {
+            if (offset - kDeltaHeaderSize + size > limit) {
+                exceeded = true;
+            }
+            if (!exceeded) {
+                writeAll(fd, data, size, offset, deltaPath);
+                offset += size;
+            }
+        });
+        // Адрес считается по тем же байтам, что попали в дельту
+        header.size = FileReader::read(filePath, [&](const unsigned char* data, size_t size) {
+            if (exceeded) {
+                return;
+            }
+            Sha256Policy::update(context, data, size);
+            encoder.update(data, size);
+        });
+        encoder.finish();
+    } catch (...) {
+        discardStaging(fd, deltaPath);
+        throw;
+    }
+    if (exceeded) {
+        discardStaging(fd, deltaPath);
+        return false;
+    }
+
+    Digest digest(ChecksumAlgorithm::Sha256, Sha256Policy::digestSize);
+    Sha256Policy::final(context, digest.data());
+    versionId = digest.toHex();
+    recent.touchVersion(versionId);
+    if (known(versionId)) {
+        discardStaging(fd, deltaPath);
+        return true;
+    }
+
+    header.chainBytes += offset - kDeltaHeaderSize;
+    header.mode = static_cast<unsigned>(std::filesystem::status(filePath).permissions()) & 07777;
+    std::string text = formatDeltaHeader(header);
+    try {
+        writeAll(fd, reinterpret_cast<const unsigned char*>(text.data()), text.size(), 0, deltaPath);
+    } catch (...) {
+        discardStaging(fd, deltaPath);
+        throw;
+    }
+    std::filesystem::path finalPath = layout.object(versionId, kDeltaSuffix);
+    VaultLayout::prepare(finalPath);
+    staging.stageFile('v', versionId, fd, deltaPath, finalPath);
+    recordCopy(VaultCopyMethod::Userspace, header.size);
+    return true;
 }
 
 bool VaultService::restore(const std::string& versionId, const std::filesystem::path& destination) {
-    std::filesystem::path source = vaultDir / versionId;
-    if (std::filesystem::exists(source)) {
-        std::filesystem::copy(source, destination, std::filesystem::copy_options::overwrite_existing);
+    restoreStats = RestoreStats();
+    bool restored = restore(versionId, destination, restoreStats);
+    if (restored && restoreStats.deltas > 0) {
+        std::cout << "  ↺ Версия " << versionId << " собрана из ключевого кадра и " << restoreStats.deltas
+                  << " дельт за " << restoreStats.seconds * 1000 << " мс" << std::endl;
+    }
+    return restored;
+}
+
+bool VaultService::restore(const std::string& versionId, const std::filesystem::path& destination,
+                           RestoreStats& stats) const {
+    auto started = std::chrono::steady_clock::now();
+    stats = RestoreStats();
+    bool restored = restoreVersion(versionId, destination, stats);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return restored;
+}
+
+bool VaultService::restoreVersion(const std::string& versionId, const std::filesystem::path& destination,
+                                  RestoreStats& stats) const {
+    if (restorePacked(versionId, destination, stats)) {
+        return true;
+    }
+    std::filesystem::path source = layout.locate(versionId);
+    if (!source.empty()) {
+        try {
+            stats.bytes += copyVersionFile(source, destination, stats.method);
+            return true;
+        } catch (const std::exception&) {
+            // Между locate и open версию могли перенести в холодный слой
+            if (coldLayout.locate(versionId, kCompressedSuffix).empty()) {
+                throw;
+            }
+        }
+    }
+    if (!(source = layout.locate(versionId, kCompressedSuffix)).empty()) {
+        restoreCompressed(versionId, source, destination, stats);
+        return true;
+    }
+    if (!(source = layout.locate(versionId, kManifestSuffix)).empty()) {
+        restoreChunks(versionId, source, destination, stats);
+        return true;
+    }
+    if (!(source = layout.locate(versionId, kDeltaSuffix)).empty()) {
+        restoreDelta(versionId, source, destination, stats);
+        return true;
+    }
+    if (!(source = coldLayout.locate(versionId, kCompressedSuffix)).empty()) {
+        restoreCompressed(versionId, source, destination, stats);
         return true;
     }
     return false;
 }
 
+void VaultService::restoreCompressed(const std::string& versionId, const std::filesystem::path& source,
+                                     const std::filesystem::path& destination, RestoreStats& stats) const {
+    auto mode = static_cast<mode_t>(std::filesystem::status(source).permissions());
+    stats.bytes += assembleVersion(versionId, kAnySize, mode, destination, [&](const FileReader::Sink& sink) {
+        VaultCompressor::decompress(source, sink);
+    });
+}
+
+bool VaultService::restorePacked(const std::string& versionId, const std::filesystem::path& destination,
+                                 RestoreStats& stats) const {
+    std::vector<unsigned char> data;
+    uint32_t mode = 0;
+    uint32_t flags = 0;
+    if (!pack.read(versionId, data, mode, flags)) {
+        return false;
+    }
+    stats.bytes += assembleVersion(versionId, kAnySize, static_cast<mode_t>(mode), destination,
+                                   [&](const FileReader::Sink& sink) {
+        if (flags & VaultPack::kCompressed) {
+            std::istringstream input(std::string(data.begin(), data.end()));
+            VaultCompressor::decompress(input, "пакет, версия " + versionId, sink);
+        } else {
+            sink(data.data(), data.size());
+        }
+    });
+    return true;
+}
+
+void VaultService::restoreDelta(const std::string& versionId, const std::filesystem::path& delta,
+                                const std::filesystem::path& destination, RestoreStats& stats) const {
+    std::ifstream input(delta, std::ios::binary);
+    DeltaHeader header = readDeltaHeader(input, delta);
+
+    // Цепочка до ключевого кадра ограничена deltaKeyframeInterval, промежуточные версии
+    // собираются во временные файлы хранилища и удаляются сразу после применения дельты
+    TemporaryGuard baseGuard;
+    std::filesystem::path basePath = layout.locate(header.base);
+    if (basePath.empty()) {
+        int baseFd = createTemporary(vaultDir / ".tmp-XXXXXX", baseGuard.path);
+        close(baseFd);
+        if (!restoreVersion(header.base, baseGuard.path, stats)) {
+            throw std::runtime_error("В хранилище нет базовой версии " + header.base + " для " + versionId);
+        }
+        basePath = baseGuard.path;
+    }
+    std::vector<unsigned char> base = readBase(basePath);
+
+    stats.bytes += assembleVersion(versionId, header.size, static_cast<mode_t>(header.mode), destination,
+                                   [&](const FileReader::Sink& sink) {
+        DeltaEncoder::apply(base.data(), base.size(), input, sink);
+    });
+    stats.method = VaultCopyMethod::Userspace;
+    ++stats.deltas;
+}
+
+void VaultService::restoreChunks(const std::string& versionId, const std::filesystem::path& manifest,
+                                 const std::filesystem::path& destination, RestoreStats& stats) const {
+    std::ifstream input(manifest);
+    uint64_t expectedSize = 0;
+    unsigned mode = 0;
+    readManifestHeader(input, manifest, expectedSize, mode);
+
+    stats.bytes += assembleVersion(versionId, expectedSize, static_cast<mode_t>(mode), destination,
+                                   [&](const FileReader::Sink& sink) {
+        std::string chunkId;
+        uint64_t chunkSize = 0;
+        while (input >> chunkId >> chunkSize) {
+            if (readChunk(layout, chunkId, sink) != chunkSize) {
+                throw std::runtime_error("Размер фрагмента " + chunkId + " не совпадает с манифестом " + manifest.string());
+            }
+        }
+    });
+}
+
 bool VaultService::exists(const std::string& versionId) const {
-    std::filesystem::path versionPath = vaultDir / versionId;
-    return std::filesystem::exists(versionPath);
+    // Все индексы в памяти: пакетов, файлов версий и холодного слоя
+    return pack.contains(versionId) || index.contains(versionId) || coldIndex.contains(versionId);
+}
+
+bool VaultService::known(const std::string& versionId) const {
+    return exists(versionId) || staging.pending('v', versionId);
+}
+
+std::vector<std::string> VaultService::listVersions() const {
+    std::unordered_set<std::string> ids;
+    layout.forEachObject([&](const std::string& id, const std::filesystem::path&) { ids.insert(id); });
+    coldLayout.forEachObject([&](const std::string& id, const std::filesystem::path&) { ids.insert(id); });
+    for (const auto& [id, length] : pack.versions()) {
+        ids.insert(id);
+    }
+    return std::vector<std::string>(ids.begin(), ids.end());
+}
+
+std::vector<std::string> VaultService::listChunks() const {
+    std::unordered_set<std::string> ids;
+    layout.forEachChunk([&](const std::string& id, const std::filesystem::path&) { ids.insert(id); });
+    return std::vector<std::string>(ids.begin(), ids.end());
+}
+
+VaultReferences VaultService::references(const std::string& versionId) const {
+    VaultReferences references;
+    std::filesystem::path path = layout.locate(versionId, kDeltaSuffix);
+    if (!path.empty()) {
+        std::ifstream input(path, std::ios::binary);
+        DeltaHeader header = readDeltaHeader(input, path);
+        references.base = header.base;
+        references.depth = header.depth;
+    }
+    path = layout.locate(versionId, kManifestSuffix);
+    if (!path.empty()) {
+        std::ifstream input(path);
+        uint64_t size = 0;
+        unsigned mode = 0;
+        readManifestHeader(input, path, size, mode);
+        std::string chunkId;
+        uint64_t chunkSize = 0;
+        while (input >> chunkId >> chunkSize) {
+            references.chunks.push_back(chunkId);
+        }
+    }
+    return references;
+}
+
+uint64_t VaultService::storedSize(const std::string& versionId) const {
+    uint64_t length = pack.storedLength(versionId);
+    if (length > 0) {
+        return length;
+    }
+    for (const char* suffix : kVersionSuffixes) {
+        std::filesystem::path path = layout.locate(versionId, suffix);
+        struct stat info {};
+        if (!path.empty() && stat(path.c_str(), &info) == 0) {
+            return static_cast<uint64_t>(info.st_size);
+        }
+    }
+    std::filesystem::path cold = coldLayout.locate(versionId, kCompressedSuffix);
+    struct stat info {};
+    if (!cold.empty() && stat(cold.c_str(), &info) == 0) {
+        return static_cast<uint64_t>(info.st_size);
+    }
+    return 0;
+}
+
+bool VaultService::mark(const std::unordered_set<std::string>& referenced, std::unordered_set<std::string>& versions,
+                        std::unordered_set<std::string>& chunks, const std::function<bool()>& step) const {
+    std::vector<std::string> pending(referenced.begin(), referenced.end());
+    while (!pending.empty()) {
+        std::string versionId = std::move(pending.back());
+        pending.pop_back();
+        if (!versions.insert(versionId).second) {
+            continue;
+        }
+        VaultReferences found = references(versionId);
+        if (!found.base.empty()) {
+            pending.push_back(found.base);
+        }
+        chunks.insert(found.chunks.begin(), found.chunks.end());
+        if (!step()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void VaultService::readVersion(const std::string& versionId, const FileReader::Sink& sink,
+                               const std::function<void(uint64_t bytes)>& baseRead) const {
+    std::vector<unsigned char> data;
+    uint32_t mode = 0;
+    uint32_t flags = 0;
+    if (pack.read(versionId, data, mode, flags)) {
+        if (flags & VaultPack::kCompressed) {
+            std::istringstream input(std::string(data.begin(), data.end()));
+            VaultCompressor::decompress(input, "пакет, версия " + versionId, sink);
+        } else {
+            sink(data.data(), data.size());
+        }
+        return;
+    }
+    std::filesystem::path source = layout.locate(versionId);
+    if (!source.empty()) {
+        bool started = false;
+        try {
+            FileReader::read(source, [&](const unsigned char* data, size_t size) {
+                started = true;
+                sink(data, size);
+            });
+            return;
+        } catch (const std::exception&) {
+            // Файл не открылся: между locate и open версию могли перенести в холодный слой
+            if (started || coldLayout.locate(versionId, kCompressedSuffix).empty()) {
+                throw;
+            }
+        }
+    }
+    if (!(source = layout.locate(versionId, kCompressedSuffix)).empty()) {
+        VaultCompressor::decompress(source, sink);
+        return;
+    }
+    if (!(source = layout.locate(versionId, kManifestSuffix)).empty()) {
+        std::ifstream input(source);
+        uint64_t size = 0;
+        unsigned manifestMode = 0;
+        readManifestHeader(input, source, size, manifestMode);
+        std::string chunkId;
+        uint64_t chunkSize = 0;
+        while (input >> chunkId >> chunkSize) {
+            if (readChunk(layout, chunkId, sink) != chunkSize) {
+                throw std::runtime_error("Размер фрагмента " + chunkId + " не совпадает с манифестом " + source.string());
+            }
+        }
+        return;
+    }
+    if (!(source = layout.locate(versionId, kDeltaSuffix)).empty()) {
+        std::ifstream input(source, std::ios::binary);
+        DeltaHeader header = readDeltaHeader(input, source);
+        // Базу собирают тем же способом: restoreVersion сверял бы каждое звено цепочки с адресом
+        std::vector<unsigned char> base;
+        std::filesystem::path basePath = layout.locate(header.base);
+        if (!basePath.empty()) {
+            base = readBase(basePath, baseRead);
+        } else {
+            readVersion(header.base, [&](const unsigned char* data, size_t size) {
+                if (baseRead) {
+                    baseRead(size);
+                }
+                base.insert(base.end(), data, data + size);
+            }, baseRead);
+        }
+        DeltaEncoder::apply(base.data(), base.size(), input, sink);
+        return;
+    }
+    if (!(source = coldLayout.locate(versionId, kCompressedSuffix)).empty()) {
+        VaultCompressor::decompress(source, sink);
+        return;
+    }
+    throw std::runtime_error("В хранилище нет версии " + versionId);
+}
+
+uint64_t VaultService::readChunkContent(const std::string& chunkId, const FileReader::Sink& sink) const {
+    return readChunk(layout, chunkId, sink);
+}
+
+bool VaultService::hasChunk(const std::string& chunkId) const {
+    return !layout.locateChunk(chunkId).empty() || !layout.locateChunk(chunkId, kCompressedSuffix).empty();
+}
+
+bool VaultService::removeVersion(const std::string& versionId, uint64_t& freed) {
+    return recent.removeIfStale('v', versionId, [&]() {
+        uint64_t packed = pack.storedLength(versionId);
+        if (pack.erase(versionId)) {
+            freed += packed;
+        }
+        // Файл может лежать и в плоском, и в разнесённом каталоге, если миграция прервалась
+        for (const char* suffix : kVersionSuffixes) {
+            std::filesystem::path path;
+            while (!(path = layout.locate(versionId, suffix)).empty() && removeFile(path, freed)) {
+            }
+        }
+        std::filesystem::path cold = coldLayout.locate(versionId, kCompressedSuffix);
+        if (!cold.empty()) {
+            removeFile(cold, freed);
+        }
+        index.remove(versionId);
+        coldIndex.remove(versionId);
+    });
+}
+
+bool VaultService::demote(const std::string& versionId, VaultCompression compression, int level, uint64_t& moved) {
+    std::filesystem::path hot = layout.locate(versionId);
+    if (hot.empty()) {
+        return false;
+    }
+    // Сжатая копия пишется и доводится до диска до удаления горячей: после сбоя версия есть хотя бы в одном слое
+    if (coldLayout.locate(versionId, kCompressedSuffix).empty()) {
+        std::filesystem::path coldPath = coldLayout.object(versionId, kCompressedSuffix);
+        VaultLayout::prepare(coldPath);
+        TemporaryGuard guard;
+        int fd = createTemporary(coldPath.parent_path() / ".tmp-XXXXXX", guard.path);
+        try {
+            uint64_t offset = 0;
+            VaultCompressor compressor(compression, level, [&](const unsigned char* data, size_t size) {
+                writeAll(fd, data, size, offset, guard.path);
+                offset += size;
+            });
+            struct stat info {};
+            if (stat(hot.c_str(), &info) != 0) {
+                throw std::runtime_error("Не удалось открыть " + hot.string() + ": " + std::strerror(errno));
+            }
+            FileReader::read(hot, [&](const unsigned char* data, size_t size) { compressor.update(data, size); });
+            compressor.finish();
+            // Права версии восстановление берёт у сжатого файла
+            fchmod(fd, info.st_mode & 07777);
+            if (fsync(fd) != 0) {
+                throw std::runtime_error("Ошибка записи " + guard.path.string() + ": " + std::strerror(errno));
+            }
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        if (close(fd) != 0) {
+            throw std::runtime_error("Ошибка записи " + guard.path.string() + ": " + std::strerror(errno));
+        }
+        std::filesystem::rename(guard.path, coldPath);
+        guard.path.clear();
+        int directoryFd = open(coldPath.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryFd >= 0) {
+            fsync(directoryFd);
+            close(directoryFd);
+        }
+        coldIndex.add(versionId);
+    }
+    // Отмеченную версию только что сохранили или взяли базой дельты — горячая копия остаётся до следующего прохода
+    bool removed = false;
+    recent.removeIfStale('v', versionId, [&]() {
+        removed = removeFile(hot, moved);
+        if (removed) {
+            index.remove(versionId);
+        }
+    });
+    return removed;
+}
+
+bool VaultService::removeChunk(const std::string& chunkId, uint64_t& freed) {
+    return recent.removeIfStale('c', chunkId, [&]() {
+        for (const char* suffix : {"", kCompressedSuffix}) {
+            std::filesystem::path path;
+            while (!(path = layout.locateChunk(chunkId, suffix)).empty() && removeFile(path, freed)) {
+            }
+        }
+    });
+}
+
+void RecentObjects::touch(char kind, const std::string& id) {
+    std::string key = kind + id;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (!collecting && now - generationStart > kGrace) {
+        // Отметки старше поколения назад больше не нужны: ссылки на них уже в базе
+        previous.swap(current);
+        current.clear();
+        generationStart = now;
+    }
+    current.insert(std::move(key));
+}
+
+void RecentObjects::beginCollection() {
+    std::lock_guard<std::mutex> lock(mutex);
+    collecting = true;
+}
+
+void RecentObjects::endCollection() {
+    std::lock_guard<std::mutex> lock(mutex);
+    collecting = false;
+}
+
+bool RecentObjects::removeIfStale(char kind, const std::string& id, const std::function<void()>& remove) {
+    std::string key = kind + id;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (current.count(key) || previous.count(key)) {
+        return false;
+    }
+    remove();
+    return true;
+}
+
+VaultStaging::VaultStaging(const std::filesystem::path& vaultDir, VaultPack& pack, VaultIndex& index)
+    : pack(pack), index(index) {
+    rootFd = open(vaultDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        throw std::runtime_error("Не удалось открыть хранилище " + vaultDir.string() + ": " + std::strerror(errno));
+    }
+}
+
+VaultStaging::~VaultStaging() {
+    for (auto& object : objects) {
+        if (object.fd >= 0) {
+            discardStaging(object.fd, object.temporaryPath);
+        }
+    }
+    close(rootFd);
+}
+
+void VaultStaging::stageFile(char kind, const std::string& id, int fd, const std::filesystem::path& temporaryPath,
+                             const std::filesystem::path& finalPath) {
+    Object object;
+    object.key = kind + id;
+    object.fd = fd;
+    object.temporaryPath = temporaryPath;
+    object.finalPath = finalPath;
+    stage(std::move(object));
+}
+
+void VaultStaging::stagePacked(const std::string& versionId, std::vector<unsigned char> data, uint32_t mode,
+                               uint32_t flags) {
+    Object object;
+    object.key = 'v' + versionId;
+    object.packed = std::move(data);
+    object.mode = mode;
+    object.flags = flags;
+    stage(std::move(object));
+}
+
+void VaultStaging::stage(Object object) {
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        keys.insert(object.key);
+        if (object.fd >= 0) {
+            ++openFiles;
+        }
+        objects.push_back(std::move(object));
+        full = openFiles >= kMaxOpenFiles;
+    }
+    // Большая версия из фрагментов публикует их частями, не дожидаясь своего commit
+    if (full) {
+        sync();
+    }
+}
+
+bool VaultStaging::pending(char kind, const std::string& id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return keys.count(kind + id) > 0;
+}
+
+void VaultStaging::sync() {
+    std::lock_guard<std::mutex> serial(syncMutex);
+    std::vector<Object> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(objects);
+        openFiles = 0;
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    // Первый syncfs доводит до диска содержимое безымянных файлов, второй — их имена и записи
+    // пакетов. Метаданные журналируемая ФС фиксирует по порядку, поэтому манифест не окажется
+    // на диске без имён своих фрагментов, опубликованных раньше
+    std::string error;
+    size_t published = 0;
+    if (syncfs(rootFd) != 0) {
+        error = std::string("syncfs: ") + std::strerror(errno);
+    }
+    for (; error.empty() && published < batch.size(); ++published) {
+        try {
+            publish(batch[published]);
+        } catch (const std::exception& e) {
+            error = e.what();
+            break;
+        }
+    }
+    if (error.empty() && syncfs(rootFd) != 0) {
+        error = std::string("syncfs: ") + std::strerror(errno);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!error.empty()) {
+        // Неопубликованное остаётся ждать следующего sync: на него уже могли сослаться другие
+        // записи (pending), их sync без этих объектов не должен завершиться успешно
+        for (size_t i = published; i < batch.size(); ++i) {
+            if (batch[i].fd >= 0) {
+                ++openFiles;
+            }
+        }
+        objects.insert(objects.begin(), std::make_move_iterator(batch.begin() + published),
+                       std::make_move_iterator(batch.end()));
+        batch.resize(published);
+    }
+    for (const auto& object : batch) {
+        keys.erase(keys.find(object.key));
+    }
+    if (!error.empty()) {
+        throw std::runtime_error("Ошибка записи в хранилище: " + error);
+    }
+}
+
+void VaultStaging::publish(Object& object) {
+    if (object.finalPath.empty()) {
+        pack.append(object.key.substr(1), object.packed.data(), object.packed.size(), object.mode, object.flags);
+        return;
+    }
+    if (anonymousTemporary(object.temporaryPath)) {
+        // Имя занято — под ним то же содержимое (адрес по содержимому)
+        if (linkat(AT_FDCWD, object.temporaryPath.c_str(), AT_FDCWD, object.finalPath.c_str(), AT_SYMLINK_FOLLOW) != 0 &&
+            errno != EEXIST) {
+            throw std::runtime_error("Не удалось опубликовать " + object.finalPath.string() + ": " + std::strerror(errno));
+        }
+    } else {
+        std::filesystem::rename(object.temporaryPath, object.finalPath);
+    }
+    close(object.fd);
+    object.fd = -1;
+    if (object.key[0] == 'v') {
+        index.add(object.key.substr(1));
+    }
+}
+
+VaultWriter::VaultWriter(const VaultLayout& layout, const VaultPack& pack, const VaultIndex& index,
+                         RecentObjects& recent, VaultStaging& staging, const VaultSaveOptions& options)
+    : vaultDir(layout.root()), layout(layout), pack(pack), index(index), recent(recent), staging(staging), packLimit(options.config.packing ? options.config.packMaxObjectSize : 0),
+      expectedSize(options.size), hashing(options.hashContent),
+      compression(parseVaultCompression(options.config.compression)),
+      compressionLevel(options.config.compressionLevel) {
+    if (VaultService::chunked(options.config, options.size)) {
+        const VaultConfig& config = options.config;
+        chunker = std::make_unique<ContentChunker>(config.chunkMinSize, config.chunkAvgSize, config.chunkMaxSize,
+            [this](const unsigned char* data, size_t size) { storeChunk(data, size); });
+        sequential = options.ordered;
+    } else if (compression != VaultCompression::None && options.ordered) {
+        compressor = std::make_unique<VaultCompressor>(compression, compressionLevel,
+            [this](const unsigned char* data, size_t size) {
+                writeAll(fd, data, size, storedBytes, temporaryPath);
+                storedBytes += size;
+            });
+        sequential = true;
+    }
+    // Фрагментам по порядку временный файл не нужен; сжатые данные пишутся в него подряд
+    if (!sequential || compressor) {
+        fd = createStaging(vaultDir, temporaryPath);
+    }
+    Sha256Policy::init(context);
+}
+
+VaultWriter::~VaultWriter() {
+    discardTemporary();
+}
+
+void VaultWriter::discardTemporary() {
+    if (fd >= 0) {
+        discardStaging(fd, temporaryPath);
+        fd = -1;
+    }
+}
+
+void VaultWriter::write(uint64_t offset, const unsigned char* data, size_t size) {
+    if (sequential) {
+        // Фрагменты режутся и блоки сжимаются последовательно, поэтому блок целиком
+        // обрабатывается под мьютексом
+        std::lock_guard<std::mutex> lock(hashMutex);
+        if (offset != hashedBytes) {
+            throw std::logic_error("Блоки версии пришли не по порядку");
+        }
+        if (hashing) {
+            Sha256Policy::update(context, data, size);
+        }
+        if (chunker) {
+            chunker->update(data, size);
+        } else {
+            compressor->update(data, size);
+        }
+        hashedBytes += size;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(hashMutex);
+        if (hashing && offset == hashedBytes) {
+            Sha256Policy::update(context, data, size);
+            hashedBytes += size;
+        } else {
+            hashing = false;
+        }
+    }
+    writeAll(fd, data, size, offset, temporaryPath);
+}
+
+void VaultWriter::storeChunk(const unsigned char* data, size_t size) {
+    std::string id = sha256(data, size).toHex();
+    recent.touchChunk(id);
+    // Фрагмент с таким содержимым уже есть или ждёт публикации — в том числе из другой версии или файла
+    if (layout.locateChunk(id).empty() && layout.locateChunk(id, kCompressedSuffix).empty() &&
+        !staging.pending('c', id)) {
+        if (compression == VaultCompression::None) {
+            std::filesystem::path chunkPath = layout.chunk(id);
+            VaultLayout::prepare(chunkPath);
+            stageBytes(staging, 'c', id, vaultDir, chunkPath, data, size);
+        } else {
+            std::vector<unsigned char> packed;
+            VaultCompressor packer(compression, compressionLevel, [&](const unsigned char* part, size_t length) {
+                packed.insert(packed.end(), part, part + length);
+            });
+            packer.update(data, size);
+            packer.finish();
+            std::filesystem::path chunkPath = layout.chunk(id, kCompressedSuffix);
+            VaultLayout::prepare(chunkPath);
+            stageBytes(staging, 'c', id, vaultDir, chunkPath, packed.data(), packed.size());
+        }
+    }
+    chunks.push_back({id, static_cast<uint32_t>(size)});
+}
+
+bool VaultWriter::canCopyDirectly() const {
+    return !chunker && compression == VaultCompression::None && fd >= 0 && expectedSize > packLimit;
+}
+
+VaultCopyMethod VaultWriter::copyFrom(const std::filesystem::path& source) {
+    int sourceFd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (sourceFd < 0) {
+        return VaultCopyMethod::Userspace;
+    }
+    // Содержимое проходит мимо write, поэтому сумма по ходу записи недействительна
+    hashing = false;
+    VaultCopyMethod method;
+    try {
+        method = kernelCopy(sourceFd, fd, source);
+    } catch (...) {
+        close(sourceFd);
+        throw;
+    }
+    close(sourceFd);
+    return method;
+}
+
+Digest VaultWriter::contentHash() {
+    if (sequential) {
+        if (!hashing) {
+            throw std::logic_error("Не передан SHA-256 содержимого версии");
+        }
+    } else {
+        struct stat info {};
+        if (fstat(fd, &info) != 0) {
+            throw std::runtime_error("Ошибка чтения версии " + temporaryPath.string() + ": " + std::strerror(errno));
+        }
+        if (!hashing || hashedBytes != static_cast<uint64_t>(info.st_size)) {
+            // Блоки приходили не по порядку — хешируем записанный файл целиком
+            Sha256Policy::init(context);
+            FileReader::read(temporaryPath, [&](const unsigned char* data, size_t size) {
+                Sha256Policy::update(context, data, size);
+            });
+        }
+    }
+    Digest digest(ChecksumAlgorithm::Sha256, Sha256Policy::digestSize);
+    Sha256Policy::final(context, digest.data());
+    return digest;
+}
+
+bool VaultWriter::appendToPack(const std::string& versionId, mode_t mode) {
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) > packLimit) {
+        return false;
+    }
+    std::vector<unsigned char> data(static_cast<size_t>(info.st_size));
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t count = pread(fd, data.data() + done, data.size() - done, static_cast<off_t>(done));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            throw std::runtime_error("Ошибка чтения версии " + temporaryPath.string() + ": " + std::strerror(errno));
+        }
+        done += static_cast<size_t>(count);
+    }
+    staging.stagePacked(versionId, std::move(data), mode,
+                        compression != VaultCompression::None ? VaultPack::kCompressed : 0);
+    discardTemporary();
+    return true;
+}
+
+void VaultWriter::compressTemporary() {
+    // Блоки приходили не по порядку — собранный файл сжимается в новый временный
+    std::filesystem::path rawPath = temporaryPath;
+    int rawFd = fd;
+    fd = createStaging(vaultDir, temporaryPath);
+    storedBytes = 0;
+    try {
+        VaultCompressor packer(compression, compressionLevel, [&](const unsigned char* data, size_t size) {
+            writeAll(fd, data, size, storedBytes, temporaryPath);
+            storedBytes += size;
+        });
+        FileReader::read(rawPath, [&](const unsigned char* data, size_t size) {
+            packer.update(data, size);
+        });
+        packer.finish();
+    } catch (...) {
+        discardStaging(rawFd, rawPath);
+        throw;
+    }
+    discardStaging(rawFd, rawPath);
+}
+
+std::string VaultWriter::commit(const std::filesystem::path& source, const Digest& contentDigest) {
+    if (chunker && sequential) {
+        chunker->finish();
+    } else if (compressor) {
+        compressor->finish();
+    }
+    Digest digest = VaultService::isContentDigest(contentDigest) ? contentDigest : contentHash();
+    std::string versionId = digest.toHex();
+    recent.touchVersion(versionId);
+    if (pack.contains(versionId) || index.contains(versionId) || staging.pending('v', versionId)) {
+        // Содержимое уже в хранилище: незаписанные страницы временного файла отбрасываются
+        // вместе с ним, до диска они, как правило, не доходят
+        discardTemporary();
+        return versionId;
+    }
+
+    auto permissions = static_cast<mode_t>(std::filesystem::status(source).permissions());
+    if (!chunker) {
+        if (compression != VaultCompression::None && !compressor) {
+            compressTemporary();
+        }
+        if (packLimit > 0 && appendToPack(versionId, permissions & 07777)) {
+            return versionId;
+        }
+        fchmod(fd, permissions);
+        std::filesystem::path finalPath = layout.object(versionId, compression != VaultCompression::None ? kCompressedSuffix : "");
+        VaultLayout::prepare(finalPath);
+        int staged = fd;
+        fd = -1;
+        staging.stageFile('v', versionId, staged, temporaryPath, finalPath);
+        return versionId;
+    }
+
+    uint64_t size = hashedBytes;
+    if (!sequential) {
+        // Блоки приходили не по порядку — фрагменты режутся по собранному временному файлу
+        size = FileReader::read(temporaryPath, [&](const unsigned char* data, size_t length) {
+            chunker->update(data, length);
+        });
+        chunker->finish();
+        discardTemporary();
+    }
+
+    std::ostringstream manifest;
+    manifest << kManifestHeader << "\n"
+             << "size " << size << "\n"
+             << "mode " << std::oct << (permissions & 07777) << std::dec << "\n";
+    for (const auto& chunk : chunks) {
+        manifest << chunk.id << " " << chunk.size << "\n";
+    }
+    std::string text = manifest.str();
+    std::filesystem::path manifestPath = layout.object(versionId, kManifestSuffix);
+    VaultLayout::prepare(manifestPath);
+    stageBytes(staging, 'v', versionId, vaultDir, manifestPath, reinterpret_cast<const unsigned char*>(text.data()),
+               text.size());
+    return versionId;
 }
@@ -1,16 +1,337 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
+#include <vector>
 #include <filesystem>
+#include <sys/types.h>
+#include "ChecksumAlgorithms.hpp"
+#include "ConfigLoader.hpp"
+#include "ContentChunker.hpp"
+#include "Digest.hpp"
+#include "FileFingerprint.hpp"
+#include "FileReader.hpp"
+#include "VaultCompression.hpp"
+#include "VaultIndex.hpp"
+#include "VaultLayout.hpp"
+#include "VaultPack.hpp"
 
+// Параметры записи версии
+struct VaultSaveOptions {
+    VaultConfig config;           // хранение фрагментами и их размеры
+    uint64_t size = 0;            // ожидаемый размер файла: по нему выбирается хранение целиком или фрагментами
+    bool hashContent = true;      // false — SHA-256 содержимого вызывающий передаст в commit
+    bool ordered = true;          // блоки приходят по порядку смещений (false — режим дерева)
+};
+
+// Как содержимое файла попало в хранилище
+enum class VaultCopyMethod {
+    Reflink,        // FICLONE: общие с исходным файлом экстенты (btrfs, XFS), копирования нет
+    CopyFileRange,  // copy_file_range: копирование в ядре
+    Sendfile,       // sendfile: копирование в ядре без copy_file_range
+    Userspace       // чтение и запись через буферы процесса (хеширование, сжатие, фрагменты)
+};
+
+struct VaultCopyStats {
+    uint64_t files[4] = {};       // по VaultCopyMethod
+    uint64_t bytes[4] = {};
+};
+
+// Версии и фрагменты, которые запись только что сохранила или нашла уже сохранёнными (адрес
+// совпал). Ссылка на них может ещё не попасть в базу, поэтому сборка мусора их не удаляет:
+// проверка и удаление идут под той же блокировкой, что и отметка, а save отмечает объект раньше,
+// чем проверяет его наличие. Отметки помнятся не меньше kGrace, а во время сборки — все.
+class RecentObjects {
+public:
+    static constexpr std::chrono::minutes kGrace{10};
+
+    void touchVersion(const std::string& versionId) { touch('v', versionId); }
+    void touchChunk(const std::string& chunkId) { touch('c', chunkId); }
+
+    void beginCollection();
+    void endCollection();
+    // Вызывает remove, если объект не отмечен; false — объект отмечен и остаётся
+    bool removeIfStale(char kind, const std::string& id, const std::function<void()>& remove);
+
+private:
+    void touch(char kind, const std::string& id);
+
+    std::mutex mutex;
+    std::unordered_set<std::string> current;
+    std::unordered_set<std::string> previous;   // предыдущее поколение отметок
+    std::chrono::steady_clock::time_point generationStart = std::chrono::steady_clock::now();
+    bool collecting = false;
+};
+
+// Записанные, но ещё не опубликованные объекты хранилища. Файл версии или фрагмента пишется
+// в безымянный временный файл (O_TMPFILE) и получает имя (linkat) только в sync: иначе после
+// сбоя под адресом мог бы остаться файл без содержимого, и сохранение приняло бы его за уже
+// сохранённую версию. sync — групповая фиксация: syncfs, публикация накопленного в порядке
+// записи (фрагменты раньше своих манифестов), снова syncfs. После сбоя неопубликованные
+// объекты исчезают вместе с безымянными файлами. Мелкие версии ждут публикации в памяти
+// и дописываются в пакет там же. Ожидающий объект считается сохранённым (pending):
+// одинаковое содержимое не записывается дважды. Опубликованные файлы версий заносятся в VaultIndex.
+class VaultStaging {
+public:
+    static constexpr size_t kMaxOpenFiles = 256;   // больше открытых файлов не копится — sync сразу
+
+    VaultStaging(const std::filesystem::path& vaultDir, VaultPack& pack, VaultIndex& index);
+    ~VaultStaging();
+
+    VaultStaging(const VaultStaging&) = delete;
+    VaultStaging& operator=(const VaultStaging&) = delete;
+
+    // kind — 'v' версия, 'c' фрагмент; fd переходит во владение VaultStaging
+    void stageFile(char kind, const std::string& id, int fd, const std::filesystem::path& temporaryPath,
+                   const std::filesystem::path& finalPath);
+    void stagePacked(const std::string& versionId, std::vector<unsigned char> data, uint32_t mode, uint32_t flags);
+    bool pending(char kind, const std::string& id) const;
+    // Публикует всё, что записано до вызова; после возврата оно переживёт сбой.
+    // Одновременные вызовы выполняются по очереди
+    void sync();
+
+private:
+    struct Object {
+        std::string key;                        // kind + id
+        int fd = -1;
+        std::filesystem::path temporaryPath;
+        std::filesystem::path finalPath;        // пусто — версия для пакета
+        std::vector<unsigned char> packed;
+        uint32_t mode = 0;
+        uint32_t flags = 0;
+    };
+
+    void stage(Object object);
+    void publish(Object& object);
+
+    VaultPack& pack;
+    VaultIndex& index;
+    int rootFd = -1;                            // каталог хранилища для syncfs
+    mutable std::mutex mutex;
+    std::vector<Object> objects;
+    size_t openFiles = 0;
+    std::unordered_multiset<std::string> keys;  // ожидающие, в том числе в идущем sync
+    std::mutex syncMutex;
+};
+
+// Версия, записываемая по частям (например, одновременно с хешированием файла).
+// До commit данные лежат во временном файле хранилища; без commit он удаляется.
+// commit передаёт файлы версии и её фрагменты в VaultStaging: видны они станут после sync.
+// Блоки, приходящие по порядку смещений, сразу хешируются SHA-256 для адреса версии;
+// при записи не по порядку (режим дерева) сумма считается в commit по временному файлу.
+// При хранении фрагментами блоки, идущие по порядку, сразу режутся на фрагменты без
+// временного файла; блоки не по порядку собираются во временном файле и режутся в commit.
+// Сжатие устроено так же: по порядку — сразу во временный файл, иначе — в commit.
+// Мелкая версия (VaultConfig::packing) в commit читается из временного файла для пакета.
+class VaultWriter {
+public:
+    VaultWriter(const VaultLayout& layout, const VaultPack& pack, const VaultIndex& index, RecentObjects& recent,
+                VaultStaging& staging, const VaultSaveOptions& options);
+    ~VaultWriter();
+
+    VaultWriter(const VaultWriter&) = delete;
+    VaultWriter& operator=(const VaultWriter&) = delete;
+
+    // Можно вызывать из нескольких потоков одновременно (pwrite)
+    void write(uint64_t offset, const unsigned char* data, size_t size);
+
+    // Переносит версию в хранилище с правами доступа source и возвращает её versionId
+    // (SHA-256 содержимого). Если такое содержимое уже есть, временный файл просто удаляется.
+    // contentDigest — SHA-256 содержимого, если он уже известен вызывающему.
+    std::string commit(const std::filesystem::path& source, const Digest& contentDigest = Digest());
+
+    // Версия хранится целиком без сжатия и не в пакете — её можно скопировать средствами ядра
+    bool canCopyDirectly() const;
+    // Копирует source во временный файл без участия буферов процесса: FICLONE, затем
+    // copy_file_range, затем sendfile. Userspace — ни один способ не сработал, ничего не
+    // скопировано и данные нужно передать через write. SHA-256 копии в этом случае считается
+    // в commit по временному файлу, если вызывающий не передаст проверенную сумму.
+    VaultCopyMethod copyFrom(const std::filesystem::path& source);
+
+private:
+    struct ChunkRef {
+        std::string id;           // SHA-256 фрагмента
+        uint32_t size;
+    };
+
+    Digest contentHash();
+    void storeChunk(const unsigned char* data, size_t size);
+    void compressTemporary();
+    // Передаёт временный файл на дописывание в пакет, если он не больше packLimit
+    bool appendToPack(const std::string& versionId, mode_t mode);
+    void discardTemporary();
+
+    int fd = -1;
+    std::filesystem::path vaultDir;
+    const VaultLayout& layout;
+    const VaultPack& pack;
+    const VaultIndex& index;
+    RecentObjects& recent;
+    VaultStaging& staging;
+    uint64_t packLimit = 0;       // версии не больше стольких байт в хранилище идут в пакет; 0 — не паковать
+    uint64_t expectedSize;
+    std::filesystem::path temporaryPath;
+
+    std::mutex hashMutex;
+    bool hashing;                 // содержимое хешируется по ходу записи
+    Sha256Policy::Context context;
+    uint64_t hashedBytes = 0;
+
+    std::unique_ptr<ContentChunker> chunker; // непусто — версия хранится фрагментами
+    std::vector<ChunkRef> chunks;
+    VaultCompression compression;
+    int compressionLevel;
+    std::unique_ptr<VaultCompressor> compressor; // сжатие версии по ходу записи
+    uint64_t storedBytes = 0;     // записано во временный файл сжатых данных
+    bool sequential = false;      // блоки режутся на фрагменты или сжимаются по ходу записи
+                                  // (только по порядку смещений)
+};
+
+// Последнее восстановление версии
+struct RestoreStats {
+    size_t deltas = 0;            // применено дельт после ключевого кадра
+    uint64_t bytes = 0;           // записано байт (с промежуточными версиями цепочки)
+    double seconds = 0;
+    // Версия целиком копируется средствами ядра; собранная из пакета, сжатия, фрагментов
+    // или дельт пишется через буферы процесса (Userspace)
+    VaultCopyMethod method = VaultCopyMethod::Userspace;
+};
+
+// Ссылки версии на другие объекты хранилища
+struct VaultReferences {
+    std::string base;                   // базовая версия дельты
+    uint32_t depth = 0;                 // дельт от ключевого кадра до версии включительно
+    std::vector<std::string> chunks;    // фрагменты манифеста
+};
+
+// Хранилище версий с адресацией по содержимому: versionId — SHA-256 файла в шестнадцатеричном
+// виде, одинаковое содержимое хранится один раз. Версии, сохранённые до этого, имеют
+// случайные 8-символьные идентификаторы и по-прежнему находятся по имени.
+//
+// Версия хранится либо целиком (<vault>/<versionId>), либо фрагментами: манифест
+// <vault>/<versionId>.manifest перечисляет фрагменты <vault>/chunks/<sha256>, общие для всех
+// версий. Небольшая правка большого файла добавляет в хранилище только изменившиеся фрагменты.
+// При сжатии (VaultConfig::compression) версии и фрагменты хранятся как <имя>.z (VaultCompressor).
+// Мелкие версии целиком (VaultConfig::packing) дописываются в сегменты-пакеты (VaultPack)
+// и ищутся по отображённому в память индексу, без отдельного файла на версию.
+// Пути выше указаны без разнесения: на диске файлы лежат в подкаталогах <ab>/<cd>/ по первым
+// символам имени (VaultLayout).
+//
+// Холодный слой (VaultConfig::hotVersions): версия целиком без сжатия, ставшая старой, переносится
+// в <vault>/cold/<ab>/<cd>/<versionId>.z (demote) — каталог может быть точкой монтирования или
+// ссылкой на другое устройство. Восстановление и чтение находят версию в любом слое; пока перенос
+// не закончен, версия есть в обоих, и после сбоя горячая копия удаляется следующим переносом.
+//
+// В режиме дельт новая версия хранится как <vault>/<versionId>.delta — операции копирования
+// из предыдущей версии и вставки новых данных (DeltaEncoder). Не реже чем через
+// deltaKeyframeInterval версий или deltaMaxChainBytes байт дельт версия сохраняется целиком
+// (ключевой кадр), так что восстановление применяет ограниченную цепочку дельт.
+//
+// save и VaultWriter::commit возвращают адрес версии, как только она записана; в хранилище
+// она появляется и переживает сбой после sync (VaultStaging). Ссылку на версию в базу
+// записывают после sync — это делает VaultWriteQueue или первичный обход.
 class VaultService {
 public:
     VaultService(std::filesystem::path vaultRoot);
+    // Публикует то, что ещё ждёт sync
+    ~VaultService();
 
-    std::string save(const std::filesystem::path& filePath); // returns versionId
+    // contentDigest — известная сумма файла; если это SHA-256 и такое содержимое уже
+    // сохранено, файл не читается. baseVersionId — предыдущая версия файла для режима дельт.
+    // hashedFingerprint — слепок файла, снятый до вычисления contentDigest: если файл
+    // с тех пор не менялся, копия, сделанная средствами ядра, повторно не хешируется.
+    std::string save(const std::filesystem::path& filePath, const Digest& contentDigest = Digest(),
+                     const VaultConfig& config = VaultConfig(),
+                     const std::string& baseVersionId = std::string(),
+                     const FileFingerprint& hashedFingerprint = FileFingerprint()); // returns versionId
+    std::unique_ptr<VaultWriter> beginSave(const VaultSaveOptions& options = VaultSaveOptions());
+    // Учёт способа копирования для copyStats (save учитывает себя сам)
+    void recordCopy(VaultCopyMethod method, uint64_t bytes);
+    VaultCopyStats copyStats() const;
+    static const char* copyMethodName(VaultCopyMethod method);
+    // Версия из фрагментов или дельт собирается потоково во временный файл рядом с destination,
+    // сверяется с SHA-256 и переименовывается поверх destination; время — в lastRestoreStats
     bool restore(const std::string& versionId, const std::filesystem::path& destination);
+    // То же без вывода и lastRestoreStats; можно вызывать из нескольких потоков (RestoreEngine)
+    bool restore(const std::string& versionId, const std::filesystem::path& destination, RestoreStats& stats) const;
     bool exists(const std::string& versionId) const;
+    // Сохранённое до вызова попадает в хранилище и на диск (VaultStaging::sync). До этого
+    // версию нельзя ни восстановить, ни записывать ссылку на неё в базу
+    void sync() { staging.sync(); }
+
+    // Остались файлы плоской раскладки (хранилище создано до разнесения по каталогам);
+    // переносит их course_work --migrate-vault при остановленном демоне
+    bool legacyLayout() const { return layout.legacy(); }
+    // Как открывался индекс файлов версий: сколько каталогов пришлось перечитать
+    const VaultIndexStats& indexStats() const { return index.openStats(); }
+
+    const RestoreStats& lastRestoreStats() const { return restoreStats; }
+
+    // Сборка мусора (GarbageCollector). Между beginCollection и endCollection отметки
+    // RecentObjects не забываются; removeVersion и removeChunk не трогают отмеченные объекты
+    // и возвращают false, освобождённые байты добавляются к freed.
+    void beginCollection() { recent.beginCollection(); }
+    void endCollection() { recent.endCollection(); }
+    std::vector<std::string> listVersions() const;
+    std::vector<std::string> listChunks() const;
+    VaultReferences references(const std::string& versionId) const;
+    // Размер версии в хранилище; для фрагментов — объём манифеста, общие фрагменты не учитываются
+    uint64_t storedSize(const std::string& versionId) const;
+    bool removeVersion(const std::string& versionId, uint64_t& freed);
+    bool removeChunk(const std::string& chunkId, uint64_t& freed);
+    // Переносит версию, хранящуюся целиком без сжатия, в холодный слой со сжатием compression;
+    // moved — байт, освобождённых в горячем слое. false — версия хранится иначе или отмечена RecentObjects
+    bool demote(const std::string& versionId, VaultCompression compression, int level, uint64_t& moved);
+    // Добавляет к versions и chunks версии и их зависимости (базы дельт, фрагменты манифестов);
+    // step вызывается после каждой версии, false — прервать (тогда и результат false)
+    bool mark(const std::unordered_set<std::string>& referenced, std::unordered_set<std::string>& versions,
+              std::unordered_set<std::string>& chunks, const std::function<bool()>& step) const;
+
+    // Содержимое версии или фрагмента в sink без сверки с адресом (проверка — VaultScrubber).
+    // Версию дельтой собирают из базы в памяти. Нет объекта или повреждена
+    // его структура — runtime_error. baseRead получает размер каждого блока, прочитанного
+    // для сборки баз по всей цепочке дельт (в sink эти байты не попадают)
+    void readVersion(const std::string& versionId, const FileReader::Sink& sink,
+                     const std::function<void(uint64_t bytes)>& baseRead = nullptr) const;
+    uint64_t readChunkContent(const std::string& chunkId, const FileReader::Sink& sink) const;
+    bool hasChunk(const std::string& chunkId) const;
+
+    // Сумма пригодна как адрес версии (SHA-256 всего файла, не дерево)
+    static bool isContentDigest(const Digest& digest);
+    // Версия такого размера хранится фрагментами
+    static bool chunked(const VaultConfig& config, uint64_t size);
 
 private:
+    // Дельта не сохраняется, если пора ставить ключевой кадр или она вышла не меньше половины файла
+    bool saveDelta(const std::filesystem::path& filePath, const VaultConfig& config,
+                   const std::string& baseVersionId, std::string& versionId);
+    // Есть в хранилище или ждёт публикации
+    bool known(const std::string& versionId) const;
+    bool restoreVersion(const std::string& versionId, const std::filesystem::path& destination,
+                        RestoreStats& stats) const;
+    void restoreCompressed(const std::string& versionId, const std::filesystem::path& source,
+                           const std::filesystem::path& destination, RestoreStats& stats) const;
+    bool restorePacked(const std::string& versionId, const std::filesystem::path& destination,
+                       RestoreStats& stats) const;
+    void restoreChunks(const std::string& versionId, const std::filesystem::path& manifest,
+                       const std::filesystem::path& destination, RestoreStats& stats) const;
+    void restoreDelta(const std::string& versionId, const std::filesystem::path& delta,
+                      const std::filesystem::path& destination, RestoreStats& stats) const;
+
     std::filesystem::path vaultDir;
-};
\ No newline at end of file
+    VaultLayout layout;
+    VaultLayout coldLayout;       // <vault>/cold: только <versionId>.z
+    VaultPack pack;
+    VaultIndex index;
+    VaultIndex coldIndex;
+    RecentObjects recent;
+    VaultStaging staging;
+    RestoreStats restoreStats;
+    mutable std::mutex copyStatsMutex;
+    VaultCopyStats copyStatistics;
+};
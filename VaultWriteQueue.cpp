@@ -0,0 +1,77 @@
+// VaultWriteQueue.cpp
+#include "VaultWriteQueue.hpp"
+#include <utility>
+
+VaultWriteQueue::VaultWriteQueue(VaultService& vault, size_t threads)
+    : vault(vault), copiers(threads) {
+    committer = std::thread([this]() { commitLoop(); });
+}
+
+VaultWriteQueue::~VaultWriteQueue() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this]() { return copying == 0 && written.empty() && !committing; });
+        stopping = true;
+    }
+    wake.notify_all();
+    committer.join();
+}
+
+void VaultWriteQueue::submit(VaultWriteRequest request, Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++copying;
+    }
+    copiers.submit([this, request = std::move(request), callback = std::move(callback)]() mutable {
+        Written item;
+        item.callback = std::move(callback);
+        try {
+            item.result.versionId = vault.save(request.path, request.contentDigest, request.config,
+                                               request.baseVersionId, request.hashedFingerprint);
+        } catch (...) {
+            item.result.error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            written.push_back(std::move(item));
+            --copying;
+        }
+        wake.notify_all();
+    });
+}
+
+void VaultWriteQueue::commitLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || !written.empty(); });
+        if (written.empty()) {
+            break;
+        }
+        std::vector<Written> batch;
+        batch.swap(written);
+        committing = true;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            vault.sync();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        size_t group = 0;
+        for (const auto& item : batch) {
+            group += item.result.error ? 0 : 1;
+        }
+        for (auto& item : batch) {
+            if (!item.result.error) {
+                item.result.error = error;
+                item.result.group = group;
+            }
+            item.callback(std::move(item.result));
+        }
+
+        lock.lock();
+        committing = false;
+        wake.notify_all();
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ConfigLoader.hpp"
+#include "Digest.hpp"
+#include "FileFingerprint.hpp"
+#include "ThreadPool.hpp"
+#include "VaultService.hpp"
+
+// Аргументы VaultService::save
+struct VaultWriteRequest {
+    std::filesystem::path path;
+    Digest contentDigest;
+    VaultConfig config;
+    std::string baseVersionId;
+    FileFingerprint hashedFingerprint;
+};
+
+struct VaultWriteResult {
+    std::string versionId;
+    size_t group = 0;             // версий, зафиксированных тем же sync
+    std::exception_ptr error;     // непусто — версия не сохранена
+};
+
+// Отложенная запись в хранилище. submit сразу возвращается: копирование (VaultService::save)
+// идёт в собственном пуле, а callback вызывается из потока фиксации после VaultService::sync,
+// когда версия уже в хранилище и переживёт сбой. Всё, что скопировано к началу фиксации,
+// фиксируется одним sync (групповая фиксация): серия изменений многих файлов стоит пары
+// syncfs на группу, а не на файл; пока идёт sync, копируется и копится следующая группа.
+// Версии одного файла отправляются по одной — следующая после callback предыдущей,
+// иначе дельта ссылалась бы на ещё не записанную базу.
+class VaultWriteQueue {
+public:
+    using Callback = std::function<void(VaultWriteResult)>;
+
+    static constexpr size_t kDefaultThreads = 2;
+
+    explicit VaultWriteQueue(VaultService& vault, size_t threads = kDefaultThreads);
+    // Дожидается записи и фиксации всего отправленного
+    ~VaultWriteQueue();
+
+    VaultWriteQueue(const VaultWriteQueue&) = delete;
+    VaultWriteQueue& operator=(const VaultWriteQueue&) = delete;
+
+    void submit(VaultWriteRequest request, Callback callback);
+
+private:
+    struct Written {
+        VaultWriteResult result;
+        Callback callback;
+    };
+
+    void commitLoop();
+
+    VaultService& vault;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Written> written;  // скопировано, ждёт sync
+    size_t copying = 0;
+    bool committing = false;
+    bool stopping = false;
+    std::thread committer;
+    ThreadPool copiers;
+};
@@ -0,0 +1,280 @@
+// Xxh3.cpp — переносимая реализация XXH3-64 (seed = 0, стандартный секрет), совместимая с xxHash 0.8
+#include "ChecksumAlgorithms.hpp"
+#include <cstring>
+
+namespace {
+
+constexpr uint8_t kSecret[192] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+constexpr uint32_t kPrime32_1 = 0x9E3779B1U;
+constexpr uint32_t kPrime32_2 = 0x85EBCA77U;
+constexpr uint32_t kPrime32_3 = 0xC2B2AE3DU;
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+constexpr uint64_t kPrimeMx1 = 0x165667919E3779F9ULL;
+constexpr uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+constexpr size_t kStripeLength = 64;
+constexpr size_t kSecretConsumeRate = 8;
+constexpr size_t kSecretLimit = sizeof(kSecret) - kStripeLength;
+constexpr size_t kStripesPerBlock = kSecretLimit / kSecretConsumeRate;
+constexpr size_t kMidSizeMax = 240;
+constexpr size_t kMidSizeStartOffset = 3;
+constexpr size_t kMidSizeLastOffset = 17;
+constexpr size_t kSecretSizeMin = 136;
+constexpr size_t kLastAccumulatorStart = 7;
+constexpr size_t kMergeAccumulatorsStart = 11;
+constexpr size_t kBufferSize = sizeof(Xxh3Policy::Context::buffer);
+constexpr size_t kBufferStripes = kBufferSize / kStripeLength;
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t multiplyFold(uint64_t lhs, uint64_t rhs) {
+    unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+inline uint64_t xxh64Avalanche(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= kPrime64_2;
+    hash ^= hash >> 29;
+    hash *= kPrime64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+inline uint64_t avalanche(uint64_t hash) {
+    hash ^= hash >> 37;
+    hash *= kPrimeMx1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+inline uint64_t rrmxmx(uint64_t hash, uint64_t length) {
+    hash ^= rotateLeft(hash, 49) ^ rotateLeft(hash, 24);
+    hash *= kPrimeMx2;
+    hash ^= (hash >> 35) + length;
+    hash *= kPrimeMx2;
+    return hash ^ (hash >> 28);
+}
+
+inline uint64_t mix16(const uint8_t* input, const uint8_t* secret) {
+    return multiplyFold(read64(input) ^ read64(secret), read64(input + 8) ^ read64(secret + 8));
+}
+
+uint64_t hashShort(const uint8_t* input, size_t length) {
+    if (length > 8) {
+        uint64_t low = read64(input) ^ (read64(kSecret + 24) ^ read64(kSecret + 32));
+        uint64_t high = read64(input + length - 8) ^ (read64(kSecret + 40) ^ read64(kSecret + 48));
+        uint64_t accumulator = length + __builtin_bswap64(low) + high + multiplyFold(low, high);
+        return avalanche(accumulator);
+    }
+    if (length >= 4) {
+        uint64_t combined = read32(input + length - 4) + (static_cast<uint64_t>(read32(input)) << 32);
+        uint64_t keyed = combined ^ (read64(kSecret + 8) ^ read64(kSecret + 16));
+        return rrmxmx(keyed, length);
+    }
+    if (length > 0) {
+        uint32_t combined = static_cast<uint32_t>(input[0]) << 16 |
+                            static_cast<uint32_t>(input[length >> 1]) << 24 |
+                            static_cast<uint32_t>(input[length - 1]) |
+                            static_cast<uint32_t>(length) << 8;
+        uint64_t keyed = static_cast<uint64_t>(combined) ^ (read32(kSecret) ^ read32(kSecret + 4));
+        return xxh64Avalanche(keyed);
+    }
+    return xxh64Avalanche(read64(kSecret + 56) ^ read64(kSecret + 64));
+}
+
+uint64_t hashMedium(const uint8_t* input, size_t length) {
+    uint64_t accumulator = length * kPrime64_1;
+    if (length > 32) {
+        if (length > 64) {
+            if (length > 96) {
+                accumulator += mix16(input + 48, kSecret + 96);
+                accumulator += mix16(input + length - 64, kSecret + 112);
+            }
+            accumulator += mix16(input + 32, kSecret + 64);
+            accumulator += mix16(input + length - 48, kSecret + 80);
+        }
+        accumulator += mix16(input + 16, kSecret + 32);
+        accumulator += mix16(input + length - 32, kSecret + 48);
+    }
+    accumulator += mix16(input, kSecret);
+    accumulator += mix16(input + length - 16, kSecret + 16);
+    return avalanche(accumulator);
+}
+
+uint64_t hashMidSize(const uint8_t* input, size_t length) {
+    uint64_t accumulator = length * kPrime64_1;
+    size_t rounds = length / 16;
+    for (size_t i = 0; i < 8; ++i) {
+        accumulator += mix16(input + 16 * i, kSecret + 16 * i);
+    }
+    uint64_t accumulatorEnd = mix16(input + length - 16, kSecret + kSecretSizeMin - kMidSizeLastOffset);
+    accumulator = avalanche(accumulator);
+    for (size_t i = 8; i < rounds; ++i) {
+        accumulatorEnd += mix16(input + 16 * i, kSecret + 16 * (i - 8) + kMidSizeStartOffset);
+    }
+    return avalanche(accumulator + accumulatorEnd);
+}
+
+uint64_t hashUpTo240(const uint8_t* input, size_t length) {
+    if (length <= 16) return hashShort(input, length);
+    if (length <= 128) return hashMedium(input, length);
+    return hashMidSize(input, length);
+}
+
+inline void accumulateStripe(uint64_t* accumulators, const uint8_t* input, const uint8_t* secret) {
+    for (size_t i = 0; i < 8; ++i) {
+        uint64_t value = read64(input + 8 * i);
+        uint64_t key = value ^ read64(secret + 8 * i);
+        accumulators[i ^ 1] += value;
+        accumulators[i] += static_cast<uint64_t>(static_cast<uint32_t>(key)) * (key >> 32);
+    }
+}
+
+inline void accumulate(uint64_t* accumulators, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+    for (size_t stripe = 0; stripe < stripes; ++stripe) {
+        accumulateStripe(accumulators, input + stripe * kStripeLength, secret + stripe * kSecretConsumeRate);
+    }
+}
+
+inline void scramble(uint64_t* accumulators, const uint8_t* secret) {
+    for (size_t i = 0; i < 8; ++i) {
+        uint64_t value = accumulators[i];
+        value ^= value >> 47;
+        value ^= read64(secret + 8 * i);
+        value *= kPrime32_1;
+        accumulators[i] = value;
+    }
+}
+
+// Поглощает полосы с учётом границ блоков (после каждого полного блока — scramble).
+void consumeStripes(uint64_t* accumulators, uint64_t& stripesSoFar, const uint8_t* input, size_t stripes) {
+    if (kStripesPerBlock - stripesSoFar <= stripes) {
+        size_t stripesToEndOfBlock = kStripesPerBlock - stripesSoFar;
+        size_t stripesAfterBlock = stripes - stripesToEndOfBlock;
+        accumulate(accumulators, input, kSecret + stripesSoFar * kSecretConsumeRate, stripesToEndOfBlock);
+        scramble(accumulators, kSecret + kSecretLimit);
+        accumulate(accumulators, input + stripesToEndOfBlock * kStripeLength, kSecret, stripesAfterBlock);
+        stripesSoFar = stripesAfterBlock;
+    } else {
+        accumulate(accumulators, input, kSecret + stripesSoFar * kSecretConsumeRate, stripes);
+        stripesSoFar += stripes;
+    }
+}
+
+uint64_t mergeAccumulators(const uint64_t* accumulators, uint64_t start) {
+    uint64_t result = start;
+    for (size_t i = 0; i < 4; ++i) {
+        const uint8_t* secret = kSecret + kMergeAccumulatorsStart + 16 * i;
+        result += multiplyFold(accumulators[2 * i] ^ read64(secret), accumulators[2 * i + 1] ^ read64(secret + 8));
+    }
+    return avalanche(result);
+}
+
+} // namespace
+
+void Xxh3Policy::init(Context& context) {
+    const uint64_t initial[8] = {kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+                                 kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1};
+    std::memcpy(context.accumulators, initial, sizeof(initial));
+    std::memset(context.buffer, 0, sizeof(context.buffer));
+    context.bufferedSize = 0;
+    context.stripesSoFar = 0;
+    context.totalLength = 0;
+}
+
+void Xxh3Policy::update(Context& context, const unsigned char* data, size_t size) {
+    const uint8_t* end = data + size;
+    context.totalLength += size;
+
+    if (size <= kBufferSize - context.bufferedSize) {
+        std::memcpy(context.buffer + context.bufferedSize, data, size);
+        context.bufferedSize += static_cast<uint32_t>(size);
+        return;
+    }
+
+    // Буфер поглощается только когда за ним гарантированно есть ещё данные:
+    // последняя полоса всегда обрабатывается в final.
+    if (context.bufferedSize > 0) {
+        size_t loadSize = kBufferSize - context.bufferedSize;
+        std::memcpy(context.buffer + context.bufferedSize, data, loadSize);
+        data += loadSize;
+        consumeStripes(context.accumulators, context.stripesSoFar, context.buffer, kBufferStripes);
+        context.bufferedSize = 0;
+    }
+
+    if (static_cast<size_t>(end - data) > kBufferSize) {
+        const uint8_t* limit = end - kBufferSize;
+        do {
+            consumeStripes(context.accumulators, context.stripesSoFar, data, kBufferStripes);
+            data += kBufferSize;
+        } while (data < limit);
+        std::memcpy(context.buffer + kBufferSize - kStripeLength, data - kStripeLength, kStripeLength);
+    }
+
+    std::memcpy(context.buffer, data, end - data);
+    context.bufferedSize = static_cast<uint32_t>(end - data);
+}
+
+void Xxh3Policy::final(Context& context, unsigned char* digest) {
+    uint64_t hash;
+    if (context.totalLength > kMidSizeMax) {
+        uint64_t accumulators[8];
+        std::memcpy(accumulators, context.accumulators, sizeof(accumulators));
+        uint64_t stripesSoFar = context.stripesSoFar;
+        uint8_t lastStripe[kStripeLength];
+        const uint8_t* lastStripePointer;
+
+        if (context.bufferedSize >= kStripeLength) {
+            size_t stripes = (context.bufferedSize - 1) / kStripeLength;
+            consumeStripes(accumulators, stripesSoFar, context.buffer, stripes);
+            lastStripePointer = context.buffer + context.bufferedSize - kStripeLength;
+        } else {
+            size_t catchupSize = kStripeLength - context.bufferedSize;
+            std::memcpy(lastStripe, context.buffer + kBufferSize - catchupSize, catchupSize);
+            std::memcpy(lastStripe + catchupSize, context.buffer, context.bufferedSize);
+            lastStripePointer = lastStripe;
+        }
+
+        accumulateStripe(accumulators, lastStripePointer, kSecret + kSecretLimit - kLastAccumulatorStart);
+        hash = mergeAccumulators(accumulators, context.totalLength * kPrime64_1);
+    } else {
+        hash = hashUpTo240(context.buffer, static_cast<size_t>(context.totalLength));
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        digest[i] = static_cast<unsigned char>(hash >> (56 - 8 * i));
+    }
+}
@@ -0,0 +1,33 @@
+// BenchDirectory.hpp
+// Рабочий каталог бенчмарка: подкаталог name в каталоге из переменной окружения variable
+// (по умолчанию во временном каталоге). Остатки прерванного запуска удаляются при создании,
+// сам подкаталог — по завершении.
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+
+class BenchDirectory {
+public:
+    BenchDirectory(const char* variable, const char* name) {
+        const char* value = std::getenv(variable);
+        // Удаляется только свой подкаталог: переменная может указывать на каталог с чужими файлами
+        root = (value ? std::filesystem::path(value) : std::filesystem::temp_directory_path()) / name;
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+    }
+
+    ~BenchDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(root, error);
+    }
+
+    BenchDirectory(const BenchDirectory&) = delete;
+    BenchDirectory& operator=(const BenchDirectory&) = delete;
+
+    const std::filesystem::path& path() const { return root; }
+
+private:
+    std::filesystem::path root;
+};
@@ -0,0 +1,187 @@
+// ChecksumServiceBenchmark.cpp
+// Пропускная способность ChecksumService по размеру файла (1 КиБ — 4 ГиБ), алгоритму,
+// способу чтения (FileReader) и состоянию страничного кэша:
+//   ChecksumService/<алгоритм>/<размер>/<warm|cold>  — ChecksumService::compute (стратегия Auto)
+//   ReadStrategy/<стратегия>/<размер>/<warm|cold>     — FileReader::read с xxh3 в качестве приёмника
+// cold — перед каждой итерацией страницы файла выбрасываются из кэша (posix_fadvise DONTNEED).
+//
+// Файлы создаются при первом использовании в подкаталоге checksum_bench каталога $CHECKSUM_BENCH_DIR
+// (по умолчанию временного) и удаляются по завершении вместе с подкаталогом. CHECKSUM_BENCH_MAX_MB ограничивает размер файлов
+// (по умолчанию 4096). Результаты для сравнения между версиями:
+//   bin/benchmarks --benchmark_filter='^(ChecksumService|ReadStrategy)/' --benchmark_out=checksum.json --benchmark_out_format=json
+#include <benchmark/benchmark.h>
+#include "../ChecksumService.hpp"
+#include "../FileReader.hpp"
+#include "BenchDirectory.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kKiB = 1024;
+constexpr uint64_t kMiB = 1024 * kKiB;
+constexpr uint64_t kGiB = 1024 * kMiB;
+
+const uint64_t kSizes[] = {kKiB, 16 * kKiB, 256 * kKiB, 4 * kMiB, 64 * kMiB, kGiB, 4 * kGiB};
+
+std::string sizeName(uint64_t size) {
+    if (size >= kGiB) return std::to_string(size / kGiB) + "GiB";
+    if (size >= kMiB) return std::to_string(size / kMiB) + "MiB";
+    return std::to_string(size / kKiB) + "KiB";
+}
+
+uint64_t maxSize() {
+    const char* value = std::getenv("CHECKSUM_BENCH_MAX_MB");
+    return value ? std::strtoull(value, nullptr, 10) * kMiB : 4 * kGiB;
+}
+
+// Каталог с тестовыми файлами; удаляется при выходе из программы
+class DataDirectory {
+public:
+    // Файл из псевдослучайных байт заданного размера
+    const std::filesystem::path& file(uint64_t size) {
+        std::filesystem::path path = root.path() / ("data-" + sizeName(size));
+        auto inserted = files.emplace(size, path);
+        if (inserted.second) {
+            write(path, size);
+        }
+        return inserted.first->second;
+    }
+
+private:
+    static void write(const std::filesystem::path& path, uint64_t size) {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Не удалось создать " + path.string() + ": " + std::strerror(errno));
+        }
+        std::mt19937_64 random(size);
+        std::vector<uint64_t> block(kMiB / sizeof(uint64_t));
+        for (uint64_t offset = 0; offset < size;) {
+            for (auto& word : block) {
+                word = random();
+            }
+            size_t length = static_cast<size_t>(std::min<uint64_t>(kMiB, size - offset));
+            if (::write(fd, block.data(), length) != static_cast<ssize_t>(length)) {
+                close(fd);
+                throw std::runtime_error("Ошибка записи " + path.string());
+            }
+            offset += length;
+        }
+        // Грязные страницы нельзя выбросить из кэша, поэтому данные сразу сбрасываются на диск
+        fdatasync(fd);
+        close(fd);
+    }
+
+    BenchDirectory root{"CHECKSUM_BENCH_DIR", "checksum_bench"};
+    std::map<uint64_t, std::filesystem::path> files;
+};
+
+DataDirectory& dataDirectory() {
+    static DataDirectory directory;
+    return directory;
+}
+
+void dropCache(const std::filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+// Для холодного кэша страницы файла выбрасываются перед каждой итерацией (вне замера)
+void prepare(benchmark::State& state, const std::filesystem::path& path, bool cold) {
+    if (cold) {
+        state.PauseTiming();
+        dropCache(path);
+        state.ResumeTiming();
+    }
+}
+
+// Для тёплого кэша файл читается один раз до замеров
+void warmUp(const std::filesystem::path& path, bool cold) {
+    if (!cold) {
+        FileReader::read(path, [](const unsigned char*, size_t) {});
+    }
+}
+
+void BM_ChecksumService(benchmark::State& state, std::string algorithmName, uint64_t size, bool cold) {
+    const std::filesystem::path& path = dataDirectory().file(size);
+    warmUp(path, cold);
+    for (auto _ : state) {
+        prepare(state, path, cold);
+        Digest digest = ChecksumService::compute(path, algorithmName);
+        benchmark::DoNotOptimize(digest.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+}
+
+void BM_ReadStrategy(benchmark::State& state, ReadStrategy strategy, uint64_t size, bool cold) {
+    const std::filesystem::path& path = dataDirectory().file(size);
+    warmUp(path, cold);
+    for (auto _ : state) {
+        prepare(state, path, cold);
+        Xxh3Policy::Context context;
+        Xxh3Policy::init(context);
+        FileReader::read(path, [&](const unsigned char* data, size_t length) {
+            Xxh3Policy::update(context, data, length);
+        }, strategy);
+        unsigned char digest[Xxh3Policy::digestSize];
+        Xxh3Policy::final(context, digest);
+        benchmark::DoNotOptimize(digest);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+}
+
+void configure(benchmark::internal::Benchmark* benchmark, uint64_t size) {
+    benchmark->UseRealTime()->Unit(size >= 64 * kMiB ? benchmark::kMillisecond : benchmark::kMicrosecond);
+}
+
+// Регистрация при загрузке программы, как это делает BENCHMARK
+const bool registered = [] {
+    const char* algorithms[] = {"sha256", "blake3", "xxh3", "crc32c", "sha256-tree", "blake3-tree"};
+    const std::pair<const char*, ReadStrategy> strategies[] = {
+        {"SingleRead", ReadStrategy::SingleRead},
+        {"Pread", ReadStrategy::Pread},
+        {"Mmap", ReadStrategy::Mmap},
+    };
+    uint64_t limit = maxSize();
+
+    for (uint64_t size : kSizes) {
+        if (size > limit) {
+            continue;
+        }
+        for (bool cold : {false, true}) {
+            std::string suffix = "/" + sizeName(size) + (cold ? "/cold" : "/warm");
+            for (const char* algorithm : algorithms) {
+                // Дерево имеет смысл начиная с нескольких листов
+                bool tree = std::string(algorithm).find("-tree") != std::string::npos;
+                if (tree && size < 2 * ChecksumService::kTreeChunkSize) {
+                    continue;
+                }
+                std::string name = std::string("ChecksumService/") + algorithm + suffix;
+                configure(benchmark::RegisterBenchmark(name.c_str(), BM_ChecksumService, algorithm, size, cold), size);
+            }
+            for (const auto& strategy : strategies) {
+                // SingleRead читает файл одним вызовом только в пределах буфера FileReader
+                if (strategy.second == ReadStrategy::SingleRead && size >= FileReader::kBufferSize) {
+                    continue;
+                }
+                std::string name = std::string("ReadStrategy/") + strategy.first + suffix;
+                configure(benchmark::RegisterBenchmark(name.c_str(), BM_ReadStrategy, strategy.second, size, cold), size);
+            }
+        }
+    }
+    return true;
+}();
+
+} // namespace
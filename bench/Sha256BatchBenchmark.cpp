@@ -0,0 +1,104 @@
+// Sha256BatchBenchmark.cpp
+// Пропускная способность пакетного SHA-256 на маленьких файлах (файлов в секунду):
+// по одному буферу (как раньше) против многобуферных ядер AVX2/AVX-512, и то же на полном
+// первичном обходе каталога с маленькими файлами через ScanEngine.
+// Файлы обхода — в подкаталоге sha256_batch_bench каталога $CHECKSUM_BENCH_DIR (по умолчанию
+// временного), удаляются по завершении.
+#include <benchmark/benchmark.h>
+#include "../ChecksumAlgorithms.hpp"
+#include "../ScanEngine.hpp"
+#include "BenchDirectory.hpp"
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t kFileCount = 4096;
+
+std::vector<std::vector<unsigned char>> makeBuffers(size_t size) {
+    std::mt19937 random(42);
+    std::vector<std::vector<unsigned char>> buffers(kFileCount, std::vector<unsigned char>(size));
+    for (auto& buffer : buffers) {
+        for (auto& byte : buffer) {
+            byte = static_cast<unsigned char>(random());
+        }
+    }
+    return buffers;
+}
+
+void BM_Sha256Buffers(benchmark::State& state) {
+    auto kernel = static_cast<Sha256BatchKernel>(state.range(0));
+    auto buffers = makeBuffers(static_cast<size_t>(state.range(1)));
+    std::vector<HashInput> inputs;
+    for (const auto& buffer : buffers) {
+        inputs.push_back({buffer.data(), buffer.size()});
+    }
+    std::vector<unsigned char> digests(inputs.size() * Sha256Policy::digestSize);
+
+    for (auto _ : state) {
+        sha256Batch(inputs.data(), inputs.size(), digests.data(), kernel);
+        benchmark::DoNotOptimize(digests.data());
+    }
+    state.counters["files/s"] = benchmark::Counter(static_cast<double>(kFileCount), benchmark::Counter::kIsIterationInvariantRate);
+    state.SetBytesProcessed(state.iterations() * kFileCount * state.range(1));
+}
+
+// Ядро x размер файла
+BENCHMARK(BM_Sha256Buffers)
+    ->ArgNames({"kernel", "size"})
+    ->ArgsProduct({{static_cast<long>(Sha256BatchKernel::Scalar), static_cast<long>(Sha256BatchKernel::Avx2),
+                    static_cast<long>(Sha256BatchKernel::Avx512)},
+                   {256, 1024, 4096}});
+
+// Каталог с kFileCount файлами до 4 КиБ
+class SmallFileTree {
+public:
+    SmallFileTree() {
+        std::mt19937 random(7);
+        for (size_t i = 0; i < kFileCount; ++i) {
+            std::ofstream file(root.path() / ("f" + std::to_string(i)), std::ios::binary | std::ios::trunc);
+            std::string content(random() % 4096, '\0');
+            for (auto& byte : content) {
+                byte = static_cast<char>(random());
+            }
+            file << content;
+        }
+    }
+
+    const std::filesystem::path& directory() const { return root.path(); }
+
+private:
+    BenchDirectory root{"CHECKSUM_BENCH_DIR", "sha256_batch_bench"};
+};
+
+const std::filesystem::path& smallFileTree() {
+    static SmallFileTree tree;
+    return tree.directory();
+}
+
+void BM_ScanSmallFiles(benchmark::State& state) {
+    ScanConfig config;
+    config.batchSmallFiles = state.range(0) != 0;
+    config.ioUring = state.range(1) != 0;
+    ScanEngine engine(config);
+
+    std::vector<ScanRequest> requests;
+    for (const auto& entry : std::filesystem::directory_iterator(smallFileTree())) {
+        ScanRequest request;
+        request.path = entry.path();
+        request.checksum.enabled = true;
+        request.checksum.algorithm = "sha256";
+        requests.push_back(request);
+    }
+
+    for (auto _ : state) {
+        auto results = engine.hash(requests);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.counters["files/s"] = benchmark::Counter(static_cast<double>(requests.size()), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK(BM_ScanSmallFiles)->ArgNames({"batch", "io_uring"})->ArgsProduct({{0, 1}, {0, 1}})->UseRealTime();
+
+} // namespace
@@ -0,0 +1,240 @@
+// VaultLayoutBenchmark.cpp
+// Задержка поиска и записи версии в зависимости от числа версий в хранилище и раскладки каталогов:
+//   VaultLayout/exists/<hit|miss>/<flat|fanout>/<версий>  — VaultService::exists
+//   VaultLayout/create/<flat|fanout>/<версий>            — файл версии 4 КиБ: безымянный временный файл
+//                                                           и linkat под именем версии, как в VaultStaging
+//   VaultLayout/save/fanout/<версий>                      — VaultService::save той же версии целиком
+//                                                           (публикация и syncfs — раз в kMaxOpenFiles версий)
+//   VaultLayout/index/<full|incremental>/<версий>         — открытие VaultIndex: без файла индекса (чтение
+//                                                           всех каталогов) и с индексом, которому каталоги
+//                                                           соответствуют (только stat каталогов)
+// flat — хранилище плоской раскладки до миграции (для него exists сначала проверяет плоский путь),
+// fanout — разнесённая раскладка (VaultLayout). save только для fanout: в плоский каталог
+// VaultService новые версии больше не пишет.
+//
+// Хранилища заполняются пустыми файлами с именами случайных SHA-256: на поиск и создание записи
+// каталога содержимое не влияет. VAULT_BENCH_VERSIONS — размеры через запятую (по умолчанию
+// 10000,1000000); для 10 млн версий нужно около 10 млн свободных inode на каждую раскладку и
+// несколько минут на заполнение:
+//   VAULT_BENCH_VERSIONS=10000000 bin/benchmarks --benchmark_filter='^VaultLayout/'
+// Каталог — подкаталог vault_layout_bench в $VAULT_BENCH_DIR (по умолчанию во временном каталоге),
+// удаляется по завершении.
+#include <benchmark/benchmark.h>
+#include "../VaultLayout.hpp"
+#include "../VaultIndex.hpp"
+#include "../VaultService.hpp"
+#include "BenchDirectory.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t kSampleIds = 4096;      // идентификаторы, по которым ищутся существующие версии
+constexpr size_t kVersionSize = 4096;
+
+std::vector<uint64_t> versionCounts() {
+    const char* value = std::getenv("VAULT_BENCH_VERSIONS");
+    std::istringstream list(value ? value : "10000,1000000");
+    std::vector<uint64_t> counts;
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        counts.push_back(std::strtoull(item.c_str(), nullptr, 10));
+    }
+    return counts;
+}
+
+std::string countName(uint64_t count) {
+    if (count % 1000000 == 0) return std::to_string(count / 1000000) + "M";
+    if (count % 1000 == 0) return std::to_string(count / 1000) + "K";
+    return std::to_string(count);
+}
+
+std::string randomId(std::mt19937_64& random) {
+    static const char digits[] = "0123456789abcdef";
+    std::string id(64, '0');
+    for (size_t i = 0; i < id.size(); i += 16) {
+        uint64_t word = random();
+        for (size_t j = 0; j < 16; ++j) {
+            id[i + j] = digits[(word >> (4 * j)) & 0xf];
+        }
+    }
+    return id;
+}
+
+void touch(const std::filesystem::path& path) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Не удалось создать " + path.string() + ": " + std::strerror(errno));
+    }
+    close(fd);
+}
+
+// Заполненное хранилище одной раскладки
+struct Vault {
+    std::filesystem::path root;
+    std::vector<std::string> present;    // выборка сохранённых идентификаторов
+    std::unique_ptr<VaultService> service;
+};
+
+class VaultDirectory {
+public:
+    Vault& vault(bool flat, uint64_t count) {
+        auto key = std::make_pair(flat, count);
+        auto found = vaults.find(key);
+        if (found != vaults.end()) {
+            return *found->second;
+        }
+        auto vault = std::make_unique<Vault>();
+        vault->root = base.path() / ((flat ? "flat-" : "fanout-") + countName(count));
+        std::filesystem::create_directories(vault->root / "chunks");
+        VaultLayout layout(vault->root);
+        std::mt19937_64 random(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string id = randomId(random);
+            std::filesystem::path path = flat ? vault->root / id : layout.object(id);
+            if (!flat) {
+                VaultLayout::prepare(path);
+            }
+            touch(path);
+            if (vault->present.size() < kSampleIds) {
+                vault->present.push_back(id);
+            }
+        }
+        vault->service = std::make_unique<VaultService>(vault->root);
+        return *vaults.emplace(key, std::move(vault)).first->second;
+    }
+
+    const std::filesystem::path& directory() const { return base.path(); }
+
+private:
+    // Хранилища разрушаются раньше, чем удаляется каталог
+    BenchDirectory base{"VAULT_BENCH_DIR", "vault_layout_bench"};
+    std::map<std::pair<bool, uint64_t>, std::unique_ptr<Vault>> vaults;
+};
+
+VaultDirectory& vaultDirectory() {
+    static VaultDirectory directory;
+    return directory;
+}
+
+void BM_Exists(benchmark::State& state, bool flat, uint64_t count, bool hit) {
+    Vault& vault = vaultDirectory().vault(flat, count);
+    std::mt19937_64 random(42);
+    std::vector<std::string> missing;
+    for (size_t i = 0; i < kSampleIds; ++i) {
+        missing.push_back(randomId(random));
+    }
+    const std::vector<std::string>& ids = hit ? vault.present : missing;
+    size_t next = 0;
+    for (auto _ : state) {
+        bool found = vault.service->exists(ids[next++ % ids.size()]);
+        benchmark::DoNotOptimize(found);
+    }
+}
+
+void BM_Create(benchmark::State& state, bool flat, uint64_t count) {
+    Vault& vault = vaultDirectory().vault(flat, count);
+    VaultLayout layout(vault.root);
+    std::vector<unsigned char> data(kVersionSize, 0x5a);
+    // Google Benchmark запускает функцию несколько раз, подбирая число итераций: каждый запуск
+    // берёт новые идентификаторы, иначе linkat упрётся в версии прошлого запуска
+    static uint64_t runs = 0;
+    std::mt19937_64 random(count + (++runs << 32));
+    for (auto _ : state) {
+        std::string id = randomId(random);
+        int fd = open(vault.root.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if (fd < 0 || write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+            throw std::runtime_error("Ошибка записи " + vault.root.string() + ": " + std::strerror(errno));
+        }
+        std::filesystem::path target = flat ? vault.root / id : layout.object(id);
+        if (!flat) {
+            VaultLayout::prepare(target);
+        }
+        std::string temporary = "/proc/self/fd/" + std::to_string(fd);
+        if (linkat(AT_FDCWD, temporary.c_str(), AT_FDCWD, target.c_str(), AT_SYMLINK_FOLLOW) != 0) {
+            throw std::runtime_error("Ошибка записи " + target.string() + ": " + std::strerror(errno));
+        }
+        close(fd);
+    }
+}
+
+void BM_Save(benchmark::State& state, uint64_t count) {
+    Vault& vault = vaultDirectory().vault(false, count);
+    std::filesystem::path source = vaultDirectory().directory() / "source";
+    std::vector<unsigned char> data(kVersionSize, 0x5a);
+    uint64_t serial = 0;
+    for (auto _ : state) {
+        // Каждая итерация сохраняет новое содержимое
+        state.PauseTiming();
+        ++serial;
+        std::memcpy(data.data(), &serial, sizeof(serial));
+        int fd = open(source.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0 || write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+            throw std::runtime_error("Ошибка записи " + source.string());
+        }
+        close(fd);
+        state.ResumeTiming();
+        std::string versionId = vault.service->save(source);
+        benchmark::DoNotOptimize(versionId.data());
+    }
+}
+
+void BM_OpenIndex(benchmark::State& state, uint64_t count, bool incremental) {
+    Vault& vault = vaultDirectory().vault(false, count);
+    VaultLayout layout(vault.root);
+    std::filesystem::path indexFile = vault.root / "index" / "versions";
+    if (incremental) {
+        // Каталоги, изменённые меньше kRacyWindowNs назад, индекс перечитывал бы каждый раз
+        std::this_thread::sleep_for(std::chrono::nanoseconds(VaultIndex::kRacyWindowNs));
+        VaultIndex warmup(layout);
+    }
+    for (auto _ : state) {
+        if (!incremental) {
+            state.PauseTiming();
+            std::filesystem::remove(indexFile);
+            state.ResumeTiming();
+        }
+        VaultIndex index(layout);
+        benchmark::DoNotOptimize(index.openStats().versions);
+    }
+}
+
+// Регистрация при загрузке программы, как это делает BENCHMARK
+const bool registered = [] {
+    for (uint64_t count : versionCounts()) {
+        for (bool flat : {true, false}) {
+            std::string suffix = std::string(flat ? "/flat/" : "/fanout/") + countName(count);
+            for (bool hit : {true, false}) {
+                std::string name = std::string("VaultLayout/exists/") + (hit ? "hit" : "miss") + suffix;
+                benchmark::RegisterBenchmark(name.c_str(), BM_Exists, flat, count, hit)->UseRealTime()
+                    ->Unit(benchmark::kMicrosecond);
+            }
+            std::string name = "VaultLayout/create" + suffix;
+            benchmark::RegisterBenchmark(name.c_str(), BM_Create, flat, count)->UseRealTime()
+                ->Unit(benchmark::kMicrosecond);
+        }
+        for (bool incremental : {false, true}) {
+            std::string name = std::string("VaultLayout/index/") + (incremental ? "incremental/" : "full/") +
+                               countName(count);
+            benchmark::RegisterBenchmark(name.c_str(), BM_OpenIndex, count, incremental)->UseRealTime()
+                ->Unit(benchmark::kMillisecond);
+        }
+        std::string name = "VaultLayout/save/fanout/" + countName(count);
+        benchmark::RegisterBenchmark(name.c_str(), BM_Save, count)->UseRealTime()->Unit(benchmark::kMicrosecond);
+    }
+    return true;
+}();
+
+} // namespace
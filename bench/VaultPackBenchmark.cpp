@@ -0,0 +1,56 @@
+// VaultPackBenchmark.cpp
+// Возвращение удалённой версии в пакет: сборка мусора удалила версию, файл вернулся к тому же
+// содержимому, и версия дописывается снова:
+//   VaultPack/reappend  — append, erase, снова append той же версии и повторное открытие
+//                         пакетов (восстановление открытого сегмента чтением); если после открытия
+//                         версия не находится или не читается, замер помечается ошибкой
+// Каталог — $VAULT_BENCH_DIR (по умолчанию во временном каталоге), его подкаталог vault_pack_bench
+// удаляется по завершении.
+#include <benchmark/benchmark.h>
+#include "../VaultPack.hpp"
+#include "BenchDirectory.hpp"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kVersionSize = 4096;
+
+std::string versionName(uint64_t serial) {
+    static const char digits[] = "0123456789abcdef";
+    std::string id(64, '0');
+    for (size_t i = 0; i < 16; ++i) {
+        id[i] = digits[(serial >> (4 * i)) & 0xf];
+    }
+    return id;
+}
+
+void BM_Reappend(benchmark::State& state) {
+    BenchDirectory directory("VAULT_BENCH_DIR", "vault_pack_bench");
+    auto pack = std::make_unique<VaultPack>(directory.path());
+    std::vector<unsigned char> data(kVersionSize, 0x5a);
+    std::vector<unsigned char> stored;
+    uint64_t serial = 0;
+    for (auto _ : state) {
+        std::string versionId = versionName(++serial);
+        std::memcpy(data.data(), &serial, sizeof(serial));
+        pack->append(versionId, data.data(), data.size(), 0644, 0);
+        pack->erase(versionId);
+        pack->append(versionId, data.data(), data.size(), 0644, 0);
+        pack.reset();
+        pack = std::make_unique<VaultPack>(directory.path());
+
+        uint32_t mode = 0;
+        uint32_t flags = 0;
+        if (!pack->contains(versionId) || !pack->read(versionId, stored, mode, flags) || stored != data) {
+            state.SkipWithError(("версия " + versionId + " потеряна после повторного открытия пакетов").c_str());
+            break;
+        }
+    }
+}
+
+BENCHMARK(BM_Reappend)->Name("VaultPack/reappend")->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,116 @@
+// VaultWriteQueueBenchmark.cpp
+// Серия изменений: сколько стоит надёжно (до переживающей сбой записи) сохранить N файлов по 16 КиБ:
+//   VaultWrite/sync/<файлов>   — VaultService::save и sync после каждого файла, по очереди:
+//                                так пришлось бы фиксировать каждую версию без групповой фиксации
+//   VaultWrite/queue/<файлов>  — все файлы сразу в VaultWriteQueue, итерация заканчивается
+//                                последним callback; sync общий для всех скопированных к его началу
+// Каждая итерация пишет новое содержимое, чтобы версии не совпадали с сохранёнными.
+// Каталог — подкаталог vault_write_bench в $VAULT_BENCH_DIR (по умолчанию во временном каталоге),
+// удаляется по завершении;
+// на tmpfs syncfs ничего не стоит — для осмысленного сравнения нужен каталог на диске.
+#include <benchmark/benchmark.h>
+#include "../VaultService.hpp"
+#include "../VaultWriteQueue.hpp"
+#include "BenchDirectory.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t kFileSize = 16 * 1024;
+
+class BurstDirectory {
+public:
+    BurstDirectory() {
+        std::filesystem::create_directories(base.path() / "files");
+        vault = std::make_unique<VaultService>(base.path() / "vault");
+    }
+
+    // Переписывает files первых файлов новым содержимым
+    std::vector<std::filesystem::path> rewrite(size_t files) {
+        std::vector<std::filesystem::path> paths;
+        std::vector<unsigned char> data(kFileSize, 0x5a);
+        for (size_t i = 0; i < files; ++i) {
+            ++serial;
+            std::memcpy(data.data(), &serial, sizeof(serial));
+            std::filesystem::path path = base.path() / "files" / std::to_string(i);
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0 || write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+                throw std::runtime_error("Ошибка записи " + path.string());
+            }
+            close(fd);
+            paths.push_back(std::move(path));
+        }
+        return paths;
+    }
+
+    VaultService& service() { return *vault; }
+
+private:
+    // Хранилище разрушается раньше, чем удаляется каталог
+    BenchDirectory base{"VAULT_BENCH_DIR", "vault_write_bench"};
+    std::unique_ptr<VaultService> vault;
+    uint64_t serial = 0;
+};
+
+BurstDirectory& burstDirectory() {
+    static BurstDirectory directory;
+    return directory;
+}
+
+void BM_Sync(benchmark::State& state) {
+    BurstDirectory& directory = burstDirectory();
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<std::filesystem::path> paths = directory.rewrite(static_cast<size_t>(state.range(0)));
+        state.ResumeTiming();
+        for (const auto& path : paths) {
+            std::string versionId = directory.service().save(path);
+            directory.service().sync();
+            benchmark::DoNotOptimize(versionId.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_Queue(benchmark::State& state) {
+    BurstDirectory& directory = burstDirectory();
+    VaultWriteQueue queue(directory.service());
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<std::filesystem::path> paths = directory.rewrite(static_cast<size_t>(state.range(0)));
+        state.ResumeTiming();
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining = paths.size();
+        for (const auto& path : paths) {
+            VaultWriteRequest request;
+            request.path = path;
+            queue.submit(std::move(request), [&](VaultWriteResult result) {
+                if (result.error) {
+                    std::rethrow_exception(result.error);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--remaining == 0) {
+                    done.notify_one();
+                }
+            });
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return remaining == 0; });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_Sync)->Name("VaultWrite/sync")->Arg(16)->Arg(256)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Queue)->Name("VaultWrite/queue")->Arg(16)->Arg(256)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <algorithm>
 #include "ConfigLoader.hpp"
 #include "VaultService.hpp"
 #include "ChecksumService.hpp"
@@ -9,37 +11,128 @@
 #include "TrackingFile.hpp"
 #include "StatePersistenceService.hpp"
 #include "InotifyWatcher.hpp"
+#include "ScanEngine.hpp"
+#include "GarbageCollector.hpp"
+#include "VaultScrubber.hpp"
+#include "VaultWriteQueue.hpp"
+#include "RestoreEngine.hpp"
 #include <fcntl.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <csignal>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// Файл, найденный при обходе путей группы
+struct ScannedFile {
+    std::filesystem::path path;
+    const MonitoringGroup* group;
+};
+
+// Отслеживаемый файл; состояние меняется только в потоке InotifyWatcher
+struct WatchedFile {
+    std::string path;
+    std::string fileId;
+    ChecksumConfig checksumConfig;
+    VaultConfig vaultConfig;
+    std::string lastVersionId; // база для следующей дельты
+    Digest lastChecksum;
+    HashMidstate midstate;
+    QuickFingerprint quickFingerprint;
+    std::chrono::steady_clock::time_point lastFullHash; // последний полный хеш (quick_check)
+    std::chrono::steady_clock::time_point lastScheduledHash; // последний плановый пересчёт по таймеру
+    bool hashing = false; // хеш уже считается в пуле
+    bool pending = false; // за время хеширования пришли новые изменения
+};
+
+// Как часто таймер ищет файлы с просроченным полным хешем (quick_check_full_interval_s)
+constexpr std::chrono::seconds kFullHashSweepPeriod{60};
+
+// Полная перепроверка раз в paranoidRounds запусков, для каждого файла в свой запуск
+bool isParanoidRound(const TrackingFile& file, const ChecksumConfig& config, uint64_t verificationRound) {
+    return config.paranoidRounds > 0 &&
+           std::strtoull(file.fileId.c_str(), nullptr, 10) % config.paranoidRounds ==
+               verificationRound % config.paranoidRounds;
+}
 
 void processFile(const std::filesystem::path& filePath,
+                 const MonitoringGroup& group,
                  InitializationService& initializer,
                  ChecksumService& checksum,
                  VaultService& vault,
                  StatePersistenceService& dbService,
-                 std::vector<TrackingFile>& trackedFilesFromDb,
-                 std::vector<TrackingFile>& trackedFilesOut) {
+                 std::unordered_map<std::string, TrackingFile>& trackedFilesFromDb,
+                 std::vector<TrackingFile>& trackedFilesOut,
+                 uint64_t verificationRound,
+                 const ScanResult* prehashed) {
     try {
-        auto it = std::find_if(trackedFilesFromDb.begin(), trackedFilesFromDb.end(),
-                               [&](const TrackingFile& file) {
-                                   return file.filePath == filePath;
-                               });
+        if (prehashed && !prehashed->ok()) {
+            throw std::runtime_error(prehashed->error);
+        }
+        auto it = trackedFilesFromDb.find(filePath.string());
 
         if (it == trackedFilesFromDb.end()) {
             // Новый файл — инициализируем и сохраняем
-            TrackingFile tf = initializer.initialize(filePath.string());
-            trackedFilesOut.push_back(tf);
+            TrackingFile tf = initializer.initialize(filePath.string(), group, prehashed);
+            tf.groupId = group.id;
             dbService.createTrackingFile(tf);
+            trackedFilesOut.push_back(tf);
             std::cout << "  → Инициализирован новый файл: " << filePath << std::endl;
         } else {
             // Файл уже есть — проверим хеш
-            TrackingFile file = *it;  // Копия, чтобы можно было модифицировать
-            std::string currentChecksum = checksum.compute(file.filePath);
+            TrackingFile file = it->second;  // Копия, чтобы можно было модифицировать
+            FileFingerprint fingerprint = prehashed ? prehashed->fingerprint : FileFingerprint::capture(file.filePath);
+            std::string groupAlgorithm = ChecksumService::algorithmFor(group.checksum, fingerprint.size);
+
+            bool paranoid = isParanoidRound(file, group.checksum, verificationRound);
+            bool statUnchanged = fingerprint == file.fingerprint;
+
+            Digest currentChecksum;
+            if (prehashed ? prehashed->skipped
+                          : statUnchanged && group.checksum.trustStat && !paranoid &&
+                                file.lastChecksum.algorithmName() == groupAlgorithm) {
+                // Метаданные не менялись с момента последнего хеширования — файл не читаем
+                currentChecksum = file.lastChecksum;
+            } else {
+                // Сравниваем тем же алгоритмом, которым была посчитана сохранённая сумма
+                if (prehashed) {
+                    currentChecksum = prehashed->digest;
+                } else {
+                    ChecksumRequest request;
+                    request.path = file.filePath;
+                    request.algorithmName = file.lastChecksum.algorithmName();
+                    request.size = fingerprint.size;
+                    request.appending = group.checksum.appendOnly;
+                    // Полная перепроверка не должна доверять сохранённому состоянию хеша
+                    if (request.appending && !paranoid) {
+                        request.midstate = file.midstate;
+                    }
+                    ChecksumResult result = checksum.submit(std::move(request)).get();
+                    currentChecksum = result.digest;
+                    if (group.checksum.appendOnly) {
+                        file.midstate = std::move(result.midstate);
+                        dbService.updateTrackingFileMidstate(file.fileId, file.midstate);
+                    }
+                }
+                if (currentChecksum == file.lastChecksum) {
+                    if (!statUnchanged) {
+                        file.fingerprint = fingerprint.cacheable();
+                        dbService.updateTrackingFileFingerprint(file.fileId, file.fingerprint);
+                    }
+                } else if (statUnchanged) {
+                    std::cerr << "  ⚠ Содержимое изменилось без изменения метаданных: " << filePath << std::endl;
+                }
+            }
+
+            if (currentChecksum != file.lastChecksum && !file.quickFingerprint.empty()) {
+                // Быстрый слепок описывает содержимое, которого в файле уже нет
+                file.quickFingerprint = QuickFingerprint{};
+                dbService.updateTrackingFileQuickFingerprint(file.fileId, file.quickFingerprint);
+            }
 
             // Проверка: существует ли резерв с совпадающим хешем
             bool hasBackup = false;
@@ -54,16 +147,38 @@ void processFile(const std::filesystem::path& filePath,
                 std::cout << "  ⚠ Резервная копия отсутствует, создаём заново..." << std::endl;
                 
                 FileChange change = FileChange();
-                std::string restoredId = vault.save(file.filePath); // Сохраняем с тем же ID
+                ChecksumRequest request;
+                request.algorithmName = groupAlgorithm;
+                SavedVersion saved = initializer.saveWithChecksum(file.filePath, std::move(request), group.vault);
+                std::string restoredId = saved.versionId;
                 change.savedVersionId = restoredId;
                 change.changeType = "Restore of reserve copy";
-                change.checksum = checksum.compute(file.filePath);
+                change.checksum = saved.checksum;
                 change.timestamp = std::chrono::system_clock::now();
                 dbService.saveFileChange(file.fileId, change);
+                file.history.changes.push_back(change);
 
                 std::cout << "  ✔ Резервная копия восстановлена: " << restoredId << std::endl;
             }
 
+            if (file.lastChecksum.algorithmName() != groupAlgorithm) {
+                // Алгоритм группы изменился — переводим опорную сумму на новый алгоритм
+                ChecksumRequest request;
+                request.path = file.filePath;
+                request.algorithmName = groupAlgorithm;
+                request.size = fingerprint.size;
+                file.lastChecksum = checksum.submit(std::move(request)).get().digest;
+                file.fingerprint = fingerprint.cacheable();
+                dbService.updateTrackingFileChecksum(file.fileId, file.lastChecksum, file.fingerprint);
+                std::cout << "  → Алгоритм контрольной суммы изменён на " << groupAlgorithm
+                          << ": " << file.lastChecksum.toHex() << std::endl;
+            }
+
+            if (file.groupId != group.id) {
+                file.groupId = group.id;
+                dbService.updateTrackingFileGroup(file.fileId, file.groupId);
+            }
+
             trackedFilesOut.push_back(file);
         }
     } catch (const std::exception& ex) {
@@ -72,14 +187,10 @@ void processFile(const std::filesystem::path& filePath,
 }
 
 
-void processDirectory(const std::filesystem::path& dirPath,
-                      InitializationService& initializer,
-                      ChecksumService& checksum,
-                      VaultService& vault,
-                      StatePersistenceService& dbService,
-                      std::vector<TrackingFile>& trackedFilesFromDb,
-                      std::vector<TrackingFile>& trackedFilesOut,
-                      bool recursive) {
+void collectDirectory(const std::filesystem::path& dirPath,
+                      const MonitoringGroup& group,
+                      bool recursive,
+                      std::vector<ScannedFile>& filesOut) {
     if (!std::filesystem::exists(dirPath) || !std::filesystem::is_directory(dirPath)) {
         std::cerr << "Путь не является директорией: " << dirPath << std::endl;
         return;
@@ -89,13 +200,13 @@ void processDirectory(const std::filesystem::path& dirPath,
         if (recursive) {
             for (const auto& entry : std::filesystem::recursive_directory_iterator(dirPath)) {
                 if (std::filesystem::is_regular_file(entry)) {
-                    processFile(entry.path(), initializer, checksum, vault, dbService, trackedFilesFromDb, trackedFilesOut);
+                    filesOut.push_back({entry.path(), &group});
                 }
             }
         } else {
             for (const auto& entry : std::filesystem::directory_iterator(dirPath)) {
                 if (std::filesystem::is_regular_file(entry)) {
-                    processFile(entry.path(), initializer, checksum, vault, dbService, trackedFilesFromDb, trackedFilesOut);
+                    filesOut.push_back({entry.path(), &group});
                 }
             }
         }
@@ -104,7 +215,43 @@ void processDirectory(const std::filesystem::path& dirPath,
     }
 }
 
+// Запрос на пакетное хеширование; false — файл хешируется в processFile: группы с append_only
+// и большие новые файлы (хеш и копия в хранилище за одно чтение)
+bool planScan(const ScannedFile& scanned,
+              const std::unordered_map<std::string, TrackingFile>& trackedFilesFromDb,
+              uint64_t verificationRound,
+              ScanRequest& request) {
+    const ChecksumConfig& config = scanned.group->checksum;
+    if (config.appendOnly) {
+        return false;
+    }
+    auto it = trackedFilesFromDb.find(scanned.path.string());
+    if (it == trackedFilesFromDb.end()) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(scanned.path, error);
+        if (!error && size >= InitializationService::kFusedSaveMinSize) {
+            return false;
+        }
+    }
+
+    request.path = scanned.path;
+    request.checksum = config;
+    if (it == trackedFilesFromDb.end()) {
+        return true;
+    }
+    const TrackingFile& file = it->second;
+    request.algorithmName = file.lastChecksum.algorithmName();
+    if (config.trustStat && !isParanoidRound(file, config, verificationRound) &&
+        request.algorithmName == ChecksumService::algorithmFor(config, file.fingerprint.size)) {
+        request.expected = file.fingerprint;
+    }
+    return true;
+}
+
 std::vector<TrackingFile> loadAndProcessConfiguration(const std::string& configPath,
+                                                      std::vector<MonitoringGroup>& groupsOut,
+                                                      GcConfig& gcConfigOut,
+                                                      ScrubConfig& scrubConfigOut,
                                                       InitializationService& initializer,
                                                       ChecksumService& checksum,
                                                       VaultService& vault,
@@ -116,26 +263,97 @@ std::vector<TrackingFile> loadAndProcessConfiguration(const std::string& configP
 
     const auto& groups = loader.getMonitoringGroups();
     std::cout << "Загружено групп: " << groups.size() << std::endl;
-
-    std::vector<TrackingFile> trackedFilesFromDb = dbService.loadTrackedFiles();
+    groupsOut = groups;
+    gcConfigOut = loader.getGcConfig();
+    scrubConfigOut = loader.getScrubConfig();
+
+    std::unordered_map<std::string, TrackingFile> trackedFilesFromDb;
+    for (auto& file : dbService.loadTrackedFiles()) {
+        std::string path = file.filePath;
+        trackedFilesFromDb.emplace(std::move(path), std::move(file));
+    }
     std::vector<TrackingFile> trackedFiles;
+    uint64_t verificationRound = dbService.nextVerificationRound();
 
-    for (const auto& group : groups) {
+    // Сначала обходим все группы, затем читаем и хешируем найденные файлы одним пакетом
+    std::vector<ScannedFile> scannedFiles;
+    for (const auto& group : groupsOut) {
         std::cout << "Группа ID: " << group.id << "\nОписание: " << group.description << std::endl;
 
         for (const auto& path : group.paths) {
             if (std::filesystem::is_regular_file(path.path)) {
-                processFile(path.path, initializer, checksum, vault, dbService, trackedFilesFromDb, trackedFiles);
+                scannedFiles.push_back({path.path, &group});
             }
             else if (std::filesystem::is_directory(path.path)) {
                 std::cout << "  → Инициализация директории: " << path.path << std::endl;
-                processDirectory(path.path, initializer, checksum, vault, dbService, trackedFilesFromDb, trackedFiles, path.recursive);
+                collectDirectory(path.path, group, path.recursive, scannedFiles);
             }
         }
 
         std::cout << "-------------------------------" << std::endl;
     }
 
+    std::vector<ScanRequest> requests;
+    std::vector<long> requestIndex(scannedFiles.size(), -1);
+    for (size_t i = 0; i < scannedFiles.size(); ++i) {
+        ScanRequest request;
+        if (planScan(scannedFiles[i], trackedFilesFromDb, verificationRound, request)) {
+            requestIndex[i] = static_cast<long>(requests.size());
+            requests.push_back(std::move(request));
+        }
+    }
+
+    ScanEngine scanEngine(loader.getScanConfig());
+    std::vector<ScanResult> prehashed = scanEngine.hash(requests);
+    const ScanStats& stats = scanEngine.lastStats();
+    std::cout << "Первичное хеширование: " << stats.files << " файлов, "
+              << std::fixed << std::setprecision(1) << stats.bytes / (1024.0 * 1024.0) << " МБ за "
+              << std::setprecision(2) << stats.seconds << " с — "
+              << std::setprecision(1) << stats.megabytesPerSecond() << " МБ/с ("
+              << (stats.ioUring ? "io_uring" : "pread") << ", глубина очереди " << stats.queueDepth << ")"
+              << std::defaultfloat << std::endl;
+
+    // Все изменения первичного обхода фиксируются одной транзакцией, а сохранённые версии —
+    // одной групповой фиксацией хранилища перед ней: база не ссылается на незаписанные версии
+    dbService.beginTransaction();
+    try {
+        for (size_t i = 0; i < scannedFiles.size(); ++i) {
+            const ScanResult* result = requestIndex[i] >= 0 ? &prehashed[requestIndex[i]] : nullptr;
+            processFile(scannedFiles[i].path, *scannedFiles[i].group, initializer, checksum, vault, dbService,
+                        trackedFilesFromDb, trackedFiles, verificationRound, result);
+        }
+        vault.sync();
+    } catch (...) {
+        // Обработанное до ошибки фиксируется, только если его версии дошли до диска; sync повторяет
+        // публикацию того, что не удалось опубликовать, и без неё база откатывается
+        try {
+            vault.sync();
+        } catch (...) {
+            dbService.rollbackTransaction();
+            throw;
+        }
+        dbService.commitTransaction();
+        throw;
+    }
+    dbService.commitTransaction();
+
+    // Счётчики накапливаются с запуска демона
+    VaultCopyStats copies = vault.copyStats();
+    std::string copySummary;
+    for (VaultCopyMethod method : {VaultCopyMethod::Reflink, VaultCopyMethod::CopyFileRange,
+                                   VaultCopyMethod::Sendfile, VaultCopyMethod::Userspace}) {
+        size_t index = static_cast<size_t>(method);
+        if (copies.files[index] > 0) {
+            std::ostringstream line;
+            line << " " << VaultService::copyMethodName(method) << " — " << copies.files[index] << " файлов, "
+                 << std::fixed << std::setprecision(1) << copies.bytes[index] / (1024.0 * 1024.0) << " МБ;";
+            copySummary += line.str();
+        }
+    }
+    if (!copySummary.empty()) {
+        std::cout << "Копирование в хранилище:" << copySummary << std::endl;
+    }
+
     return trackedFiles;
 }
 
@@ -146,7 +364,172 @@ void signalHandler(int) {
 }
 
 
-int main() {
+// Блокировка каталога демона: пакеты хранилища может открывать на запись только один процесс.
+// Держится до выхода процесса; -1 — каталог занят
+int lockDaemon() {
+    int fd = open("daemon.lock", O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// course_work --migrate-vault: перенос хранилища с плоской раскладкой в разнесённые каталоги.
+// Выполняется в текущем процессе без демонизации и только при остановленном демоне: файл, найденный
+// демоном по плоскому пути, мог бы переехать до того, как демон его откроет
+int migrateVault() {
+    if (lockDaemon() < 0) {
+        std::cerr << "Демон работает: остановите его перед переносом хранилища" << std::endl;
+        return 1;
+    }
+    VaultLayout layout(".filevault");
+    if (!layout.legacy()) {
+        std::cout << "Хранилище уже разнесено по каталогам" << std::endl;
+        return 0;
+    }
+    auto started = std::chrono::steady_clock::now();
+    uint64_t moved = layout.migrate([](uint64_t count) {
+        std::cout << "\r  → Перенесено файлов: " << count << std::flush;
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "\n✔ Хранилище разнесено по каталогам: " << moved << " файлов за " << std::fixed
+              << std::setprecision(1) << seconds << " с" << std::endl;
+    return 0;
+}
+
+std::string localTime(std::chrono::system_clock::time_point time) {
+    std::time_t t = std::chrono::system_clock::to_time_t(time);
+    std::ostringstream text;
+    text << std::put_time(std::localtime(&t), "%F %T");
+    return text.str();
+}
+
+// course_work --restore <группа> --at <время> [--subtree <путь>] [--dry-run] [--threads N]:
+// восстановление группы на момент времени. Выполняется в текущем процессе при остановленном демоне
+int restoreGroup(const std::vector<std::string>& args) {
+    std::string groupId;
+    std::string at;
+    std::filesystem::path subtree;
+    bool dryRun = false;
+    size_t threads = RestoreEngine::kDefaultThreads;
+    for (size_t i = 0; i < args.size(); ++i) {
+        bool hasValue = i + 1 < args.size();
+        if (args[i] == "--restore" && hasValue) {
+            groupId = args[++i];
+        } else if (args[i] == "--at" && hasValue) {
+            at = args[++i];
+        } else if (args[i] == "--subtree" && hasValue) {
+            subtree = args[++i];
+        } else if (args[i] == "--threads" && hasValue) {
+            threads = static_cast<size_t>(std::stoul(args[++i]));
+        } else if (args[i] == "--dry-run") {
+            dryRun = true;
+        } else {
+            throw std::invalid_argument("неизвестный параметр " + args[i]);
+        }
+    }
+    if (groupId.empty() || at.empty()) {
+        throw std::invalid_argument("нужны --restore <группа> и --at <время>");
+    }
+    auto time = RestoreEngine::parseTime(at);
+
+    if (lockDaemon() < 0) {
+        std::cerr << "Демон работает: остановите его перед восстановлением" << std::endl;
+        return 1;
+    }
+    VaultService vault(".filevault");
+    StatePersistenceService db("tracking.db");
+    RestoreEngine engine(vault, db);
+    RestorePlan plan = engine.plan(groupId, time, subtree);
+    if (plan.items.empty()) {
+        std::cerr << "В группе " << groupId << " нет отслеживаемых файлов"
+                  << (subtree.empty() ? "" : " в " + subtree.string()) << std::endl;
+        return 1;
+    }
+
+    std::cout << "Группа " << groupId << " на " << localTime(plan.at) << ":" << std::endl;
+    if (dryRun) {
+        for (const auto& item : plan.items) {
+            switch (item.action) {
+                case RestoreAction::Restore:
+                    std::cout << "  ↺ " << item.path.string() << " ← " << item.versionId << " ("
+                              << localTime(item.timestamp) << ")" << std::endl;
+                    break;
+                case RestoreAction::Unchanged:
+                    std::cout << "  = " << item.path.string() << " не изменился" << std::endl;
+                    break;
+                case RestoreAction::NotTracked:
+                    std::cout << "  · " << item.path.string() << " ещё не отслеживался, не трогается" << std::endl;
+                    break;
+                case RestoreAction::NoVersion:
+                    std::cout << "  ⚠ " << item.path.string() << ": версии " << item.versionId
+                              << " нет в хранилище" << std::endl;
+                    break;
+            }
+        }
+    }
+    std::cout << "Восстановить: " << plan.count(RestoreAction::Restore) << ", без изменений: "
+              << plan.count(RestoreAction::Unchanged) << ", ещё не отслеживались: "
+              << plan.count(RestoreAction::NotTracked) << ", нет версии: " << plan.count(RestoreAction::NoVersion)
+              << std::endl;
+    if (dryRun) {
+        return 0;
+    }
+
+    RestoreReport report = engine.run(plan, threads, [](size_t done, size_t total) {
+        std::cout << "\r  → Восстановлено файлов: " << done << " из " << total << std::flush;
+    });
+    double megabytes = report.bytes / (1024.0 * 1024.0);
+    double seconds = std::max(report.seconds, 1e-9);
+    std::cout << "\n✔ Восстановлено " << report.restored << " файлов, " << std::fixed << std::setprecision(1)
+              << megabytes << " МБ за " << report.seconds << " с (" << megabytes / seconds << " МБ/с, "
+              << std::setprecision(0) << report.restored / seconds << " файлов/с)" << std::endl;
+    std::cout << "  Время на файл: p50 " << std::setprecision(2) << report.p50Ms << " мс, p99 " << report.p99Ms
+              << " мс, макс. " << report.maxMs << " мс" << std::defaultfloat << std::endl;
+    std::cout << "  Копирование:";
+    for (auto method : {VaultCopyMethod::Reflink, VaultCopyMethod::CopyFileRange, VaultCopyMethod::Sendfile,
+                        VaultCopyMethod::Userspace}) {
+        std::cout << " " << VaultService::copyMethodName(method) << " "
+                  << report.methods[static_cast<size_t>(method)];
+    }
+    std::cout << std::endl;
+    if (report.failed > 0) {
+        std::cerr << "⚠ Не восстановлено файлов: " << report.failed << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        if (std::string(argv[1]) == "--migrate-vault") {
+            try {
+                return migrateVault();
+            } catch (const std::exception& e) {
+                std::cerr << "\nОшибка переноса хранилища: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        if (std::string(argv[1]) == "--restore") {
+            try {
+                return restoreGroup(std::vector<std::string>(argv + 1, argv + argc));
+            } catch (const std::exception& e) {
+                std::cerr << "\nОшибка восстановления: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        std::cerr << "Использование: " << argv[0] << " [--migrate-vault]\n"
+                  << "       " << argv[0]
+                  << " --restore <группа> --at <время> [--subtree <путь>] [--dry-run] [--threads N]" << std::endl;
+        return 1;
+    }
+
+    // Второй демон в том же каталоге писал бы в те же пакеты хранилища
+    if (lockDaemon() < 0) {
+        std::cerr << "Демон уже запущен в этом каталоге" << std::endl;
+        return 1;
+    }
 
         pid_t pid = fork();
     if (pid < 0) {
@@ -184,49 +567,200 @@ int main() {
     const std::string configPath = "config.json";
 
     VaultService vault(".filevault");
+    if (vault.legacyLayout()) {
+        std::cout << "⚠ В хранилище остались файлы плоской раскладки; перенести их в разнесённые каталоги: "
+                  << "course_work --migrate-vault (при остановленном демоне)" << std::endl;
+    }
+    const VaultIndexStats& indexStats = vault.indexStats();
+    std::cout << "✔ Индекс хранилища: версий " << indexStats.versions << ", перечитано каталогов "
+              << indexStats.rescanned << " из " << indexStats.directories << " за " << std::fixed
+              << std::setprecision(2) << indexStats.seconds << " с" << std::defaultfloat << std::endl;
     ChecksumService checksum;
     InitializationService initializer(vault, checksum);
     StatePersistenceService dbService("tracking.db");
     dbService.initializeSchema();
+    GarbageCollector collector(vault, "tracking.db");
+    VaultScrubber scrubber(vault, "tracking.db");
 
     InotifyWatcher watcher;
+    // Копирование в хранилище и fsync — вне потока наблюдения; разрушается раньше watcher,
+    // которому передаёт результаты
+    VaultWriteQueue writeQueue(vault);
+    std::vector<MonitoringGroup> groups;
+    GcConfig gcConfig;
+    ScrubConfig scrubConfig;
     std::vector<TrackingFile> trackedFiles;
 
+    // Хеш считается в пуле ChecksumService, а результат применяется в потоке наблюдения:
+    // медленный файл не задерживает обработку событий остальных файлов
+    std::function<void(const std::shared_ptr<WatchedFile>&, ChecksumPriority)> rehashWatchedFile;
+    // Файлы текущей конфигурации: по ним таймер ищет просроченный полный хеш (quick_check)
+    std::vector<std::shared_ptr<WatchedFile>> watchedFiles;
+
+    auto finishRehash = [&](const std::shared_ptr<WatchedFile>& file) {
+        file->hashing = false;
+        if (file->pending) {
+            file->pending = false;
+            file->hashing = true;
+            rehashWatchedFile(file, ChecksumPriority::High);
+        }
+    };
+
+    // Версия записана на диск: теперь на неё можно сослаться в базе
+    auto applySaved = [&](const std::shared_ptr<WatchedFile>& file, FileChange& change,
+                          const FileFingerprint& fingerprint, const VaultWriteResult& written) {
+        try {
+            if (written.error) {
+                std::rethrow_exception(written.error);
+            }
+            change.savedVersionId = written.versionId;
+            file->lastVersionId = change.savedVersionId;
+
+            dbService.saveFileChange(file->fileId, change);
+            dbService.updateTrackingFileChecksum(file->fileId, change.checksum, fingerprint.cacheable());
+            file->lastChecksum = change.checksum;
+
+            std::cout << "  ✔ Резервная копия сохранена и хеш обновлён: " << file->path << " "
+                      << change.checksum.algorithmName() << ":" << change.checksum.toHex()
+                      << " (записана на диск в группе из " << written.group << ")" << std::endl;
+        } catch (const std::exception& ex) {
+            std::cerr << "  ⚠ Ошибка сохранения резервной копии " << file->path << ": " << ex.what() << std::endl;
+        }
+        finishRehash(file);
+    };
+
+    auto applyRehash = [&](const std::shared_ptr<WatchedFile>& file, const FileFingerprint& fingerprint,
+                           const QuickFingerprint& quick, ChecksumResult& result) {
+        bool saving = false;
+        try {
+            if (result.error) {
+                std::rethrow_exception(result.error);
+            }
+            if (file->checksumConfig.appendOnly) {
+                file->midstate = std::move(result.midstate);
+                dbService.updateTrackingFileMidstate(file->fileId, file->midstate);
+                if (!result.resumed) {
+                    std::cout << "  → Файл изменён не только дописыванием, хеш пересчитан полностью: " << file->path << std::endl;
+                }
+            }
+
+            const Digest& newChecksum = result.digest;
+            if (newChecksum != file->lastChecksum) {
+                // Файл остаётся занятым (hashing) до записи версии: следующая версия файла
+                // сохраняется после неё и может взять её базой дельты
+                FileChange change;
+                change.timestamp = std::chrono::system_clock::now();
+                change.checksum = newChecksum;
+                VaultWriteRequest write{file->path, newChecksum, file->vaultConfig, file->lastVersionId, fingerprint};
+                writeQueue.submit(std::move(write), [&, file, change, fingerprint](VaultWriteResult written) mutable {
+                    watcher.post([&, file, change, fingerprint, written = std::move(written)]() mutable {
+                        applySaved(file, change, fingerprint, written);
+                    });
+                });
+                saving = true;
+            } else {
+                dbService.updateTrackingFileFingerprint(file->fileId, fingerprint.cacheable());
+                std::cout << "  ↪ Хеш не изменился: " << file->path << std::endl;
+            }
+            file->lastFullHash = std::chrono::steady_clock::now();
+            if (file->checksumConfig.quickCheck && quick != file->quickFingerprint) {
+                file->quickFingerprint = quick;
+                dbService.updateTrackingFileQuickFingerprint(file->fileId, file->quickFingerprint);
+            }
+        } catch (const std::exception& ex) {
+            std::cerr << "  ⚠ Ошибка обновления контрольной суммы " << file->path << ": " << ex.what() << std::endl;
+        }
+        if (!saving) {
+            finishRehash(file);
+        }
+    };
+
+    rehashWatchedFile = [&](const std::shared_ptr<WatchedFile>& file, ChecksumPriority priority) {
+        try {
+            // Смена режима (обычный/дерево) возможна только при изменении размера файла
+            FileFingerprint fingerprint = FileFingerprint::capture(file->path);
+
+            // Быстрый слепок снимается до полного хеша: если файл изменится между ними,
+            // слепок не совпадёт при следующем событии и файл будет перечитан
+            QuickFingerprint quick;
+            if (file->checksumConfig.quickCheck) {
+                quick = checksum.computeQuick(file->path, fingerprint.size);
+                auto now = std::chrono::steady_clock::now();
+                bool fullHashDue = file->checksumConfig.quickCheckFullInterval > 0 &&
+                    now - file->lastFullHash >= std::chrono::seconds(file->checksumConfig.quickCheckFullInterval);
+                if (quick == file->quickFingerprint && !fullHashDue) {
+                    // Слепок метаданных не обновляем: при запуске файл будет перепроверен полностью
+                    std::cout << "  ↪ Быстрый слепок не изменился, полный хеш пропущен: " << file->path << std::endl;
+                    finishRehash(file);
+                    return;
+                }
+            }
+
+            ChecksumRequest request;
+            request.path = file->path;
+            request.algorithmName = ChecksumService::algorithmFor(file->checksumConfig, fingerprint.size);
+            request.priority = priority;
+            request.size = fingerprint.size;
+            // Для дописываемых файлов хешируются только новые байты
+            request.appending = file->checksumConfig.appendOnly;
+            request.midstate = file->midstate;
+
+            ChecksumService::Callback onHashed = [&, file, fingerprint, quick](ChecksumResult result) {
+                watcher.post([&, file, fingerprint, quick, result = std::move(result)]() mutable {
+                    applyRehash(file, fingerprint, quick, result);
+                });
+            };
+            if (!checksum.trySubmit(request, onHashed)) {
+                ChecksumQueueStats stats = checksum.queueStats();
+                std::cout << "  ⏳ Очередь хеширования заполнена (" << stats.queuedTotal() << " задач, "
+                          << stats.inFlightBytes / (1024 * 1024) << " МБ в работе), ожидание..." << std::endl;
+                checksum.submit(std::move(request), std::move(onHashed));
+            }
+        } catch (const std::exception& ex) {
+            std::cerr << "  ⚠ Ошибка обновления контрольной суммы " << file->path << ": " << ex.what() << std::endl;
+            finishRehash(file);
+        }
+    };
+
     auto setupFileWatchers = [&](std::vector<TrackingFile>& files) {
-        for (auto& file : files) {
-            std::string path = file.filePath;
-            std::string fileId = file.fileId;
-            std::string lastChecksum = file.lastChecksum;
+        for (auto& tracked : files) {
+            auto file = std::make_shared<WatchedFile>();
+            file->path = tracked.filePath;
+            file->fileId = tracked.fileId;
+            file->lastChecksum = tracked.lastChecksum;
+            file->midstate = tracked.midstate;
+            file->quickFingerprint = tracked.quickFingerprint;
+            if (!tracked.history.changes.empty()) {
+                file->lastVersionId = tracked.history.changes.back().savedVersionId;
+            }
+            file->lastFullHash = std::chrono::steady_clock::now();
 
-            watcher.addWatch(path, [&, path, fileId, lastChecksum](uint32_t mask) mutable {
-                std::cout << "📝 Изменение файла: " << path << std::endl;
+            for (const auto& group : groups) {
+                if (group.id == tracked.groupId) {
+                    file->checksumConfig = group.checksum;
+                    file->vaultConfig = group.vault;
+                    break;
+                }
+            }
+
+            watchedFiles.push_back(file);
+            watcher.addWatch(file->path, [&, file](uint32_t mask) {
+                std::cout << "📝 Изменение файла: " << file->path << std::endl;
 
                 if (mask & IN_MODIFY) {
-                    std::cout << "  → Файл модифицирован. Пересчитываем хеш..." << std::endl;
-                    try {
-                        std::string newChecksum = checksum.compute(path);
-                        if (newChecksum != lastChecksum) {
-                            FileChange change;
-                            change.timestamp = std::chrono::system_clock::now();
-                            change.checksum = newChecksum;
-                            change.savedVersionId = vault.save(path);
-
-                            dbService.saveFileChange(fileId, change);
-                            dbService.updateTrackingFileChecksum(fileId, newChecksum);
-                            lastChecksum = newChecksum;
-
-                            std::cout << "  ✔ Резервная копия сохранена и хеш обновлён." << std::endl;
-                        } else {
-                            std::cout << "  ↪ Хеш не изменился" << std::endl;
-                        }
-                    } catch (const std::exception& ex) {
-                        std::cerr << "  ⚠ Ошибка обновления контрольной суммы: " << ex.what() << std::endl;
+                    if (file->hashing) {
+                        // Серия записей схлопывается в один повторный пересчёт
+                        file->pending = true;
+                    } else {
+                        std::cout << "  → Файл модифицирован. Пересчитываем хеш..." << std::endl;
+                        file->hashing = true;
+                        rehashWatchedFile(file, ChecksumPriority::High);
                     }
                 }
 
                 if (mask & IN_DELETE) {
                     std::cout << "  ⚠ Файл был удалён" << std::endl;
-                    dbService.updateTrackingFileMissing(fileId, true);
+                    dbService.updateTrackingFileMissing(file->fileId, true);
                 }
             });
         }
@@ -235,13 +769,21 @@ int main() {
 
     std::function<void()> reloadConfiguration = [&]() {
         std::cout << "\n🔄 Перезагрузка конфигурации..." << std::endl;
+        // Сборка мусора и проверка хранилища не мешают первичному обходу;
+        // сборка мусора к тому же не видит его незафиксированную транзакцию
+        collector.pause();
+        scrubber.pause();
         try {
             // Удаляем все текущие наблюдения
             watcher.clearWatches();
+            watchedFiles.clear();
 
             // Перезагружаем конфигурацию и отслеживаемые файлы
-            trackedFiles = loadAndProcessConfiguration(configPath, initializer, checksum, vault, dbService);
+            trackedFiles = loadAndProcessConfiguration(configPath, groups, gcConfig, scrubConfig, initializer,
+                                                       checksum, vault, dbService);
             setupFileWatchers(trackedFiles);
+            collector.configure(groups, gcConfig);
+            scrubber.configure(scrubConfig);
 
             // Добавляем наблюдение за изменением конфигурации
             watcher.addWatch(configPath, [&](uint32_t mask) {
@@ -254,11 +796,31 @@ int main() {
         } catch (const std::exception& ex) {
             std::cerr << "  ⚠ Ошибка при обновлении конфигурации: " << ex.what() << std::endl;
         }
+        collector.resume();
+        scrubber.resume();
     };
 
     // Инициализация
     reloadConfiguration();
     // setupFileWatchers();
+    // Правка на месте вне выборочных блоков не меняет быстрый слепок: если за ней не последует
+    // новое IN_MODIFY, полный хеш по quick_check_full_interval_s запускает этот таймер
+    watcher.setTimer(kFullHashSweepPeriod, [&]() {
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& file : watchedFiles) {
+            const ChecksumConfig& config = file->checksumConfig;
+            // Неудачная попытка (например, файл удалён) повторяется не раньше следующего интервала
+            auto last = std::max(file->lastFullHash, file->lastScheduledHash);
+            if (!config.quickCheck || config.quickCheckFullInterval == 0 || file->hashing ||
+                now - last < std::chrono::seconds(config.quickCheckFullInterval)) {
+                continue;
+            }
+            std::cout << "⏱ Плановый полный хеш (quick_check_full_interval_s): " << file->path << std::endl;
+            file->lastScheduledHash = now;
+            file->hashing = true;
+            rehashWatchedFile(file, ChecksumPriority::Low);
+        }
+    });
     watcher.start();
 
     std::cout << "Нажмите Enter для выхода..." << std::endl;